@@ -1,4 +1,4 @@
-// gcc -O3 -I src/include -L src/lib -o main allTogether.c -lmingw32 -lSDL2main -lSDL2 -lSDL2_ttf -lSDL2_image -lSDL2_mixer
+// gcc -O3 -I src/include -L src/lib -o main 2D_Physics.c fixedTimestep.c poissonDisk.c geometryBatch.c arcTessellator.c -lmingw32 -lSDL2main -lSDL2 -lSDL2_ttf -lSDL2_image -lSDL2_mixer
 
 
 #include <SDL2/SDL.h>
@@ -11,12 +11,22 @@
 #include <time.h>
 #include <math.h>
 
+#include "fixedTimestep.h"
+#include "poissonDisk.h"
+#include "geometryBatch.h"
+
 #define SCREEN_WIDTH 1392 // Screen dimension constants
 #define SCREEN_HEIGHT 744 // the size of the screen
 #define NUM_RAYS 2 // Number of points on the circle
 
 #define MAX_BALLS 1000
 
+#define PHYSICS_HZ 60 // fixed physics steps per second
+#define PHYSICS_SUBSTEPS 1 // integration passes per physics step
+#define CIRCLE_MAX_ERROR 0.35f // pixels a circle's polygon may fall short of the true edge
+#define SHADOW_LENGTH 10000 // how far past a circle its shadow reaches
+#define LOG_SHADOW_CACHE 0 // 1 prints how many frames drew each cached shadow mesh before it was rebuilt
+
 
 typedef struct {
     float startX, startY, endX, endY;
@@ -35,7 +45,8 @@ typedef struct {
 
 typedef struct {
     Vector2 position;        // Position
-    Vector2 velocity;      // Velocity
+    Vector2 previous;      // Position before the last physics step (for interpolation)
+    Vector2 velocity;      // Velocity in pixels per second
     float mass; // mass
     float radius;      // Radius
     Color colour;
@@ -43,6 +54,11 @@ typedef struct {
 
 Circle circles[MAX_BALLS]; // Declare the array
 int DYNAMIC_CIRCLES = 10;
+GeometryBatch circleBatch; // circles of one draw layer, drawn in one call
+GeometryBatch shadowBatch; // the fixed test circle's shadow, kept from frame to frame while the light stays put
+unsigned shadowKey = 0; // hash of the light and test circle shadowBatch was built for
+bool shadowsBuilt = false;
+int shadowReuses = 0; // frames shadowBatch was drawn again since it was built, for LOG_SHADOW_CACHE
 
 
 const Color colors[] = {
@@ -307,6 +323,13 @@ float mag(Vector2 vel) {
 }
 
 
+// Mixes a float into a running hash, for noticing when anything in a list of positions changed
+unsigned hashFloat(unsigned hash, float value) {
+    unsigned bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return hash ^ (bits + 0x9e3779b9u + (hash << 6) + (hash >> 2));
+}
+
 // Set the magnitude of a vector
 Vector2 setMagnitude(Vector2 v, float newMag) {
     // Calculate the current magnitude of the vector
@@ -367,49 +390,36 @@ bool checkOverlap(Circle* b1, Circle* b2){
     return dist <= (b1->radius + b2->radius);
 }
 
-// circle functions:
-void DrawFilledCircle(SDL_Renderer* renderer, int centerX, int centerY, float radius) {
-    // Loop through the vertical positions (y-coordinates) of the circle from the top to the bottom
-    for (int y = -radius; y <= radius; y++) {
-        // Calculate the horizontal distance (half-width) at this y-level using the circle equation
-        int dx = (int)sqrt(radius * radius - y * y);  // Could use a faster square root approximation
-
-        // Draw a horizontal line across the diameter of the circle at the current y-level
-        SDL_RenderDrawLine(renderer, centerX - dx, centerY + y, centerX + dx, centerY + y);
-    }
-}
-
 void InitializeCircles() {
     srand(time(NULL)); // Seed random number generator
 
+    // Random radius (10 to 90) with circles kept away from the screen edges. The Poisson-disk
+    // fill never overlaps, so there is no retry loop; a random subset of it is used.
+    PoissonDiskParams params = {50, 50, SCREEN_WIDTH - 50, SCREEN_HEIGHT - 50, 10, 90, 0, 0, rand()};
+    int capacity = maxDiskCount(&params);
+    DiskSample* samples = malloc(sizeof(DiskSample) * capacity);
+    int placed = samples != NULL ? poissonDiskFill(&params, samples, capacity) : 0;
+    shuffleDiskSamples(samples, placed, params.seed);
+    if (DYNAMIC_CIRCLES > placed) DYNAMIC_CIRCLES = placed;
+
     for (int i = 0; i < DYNAMIC_CIRCLES; i++) {
-        int randColor = rand() % 15;
-        // Random position within screen bounds (adjust based on your screen size)
-        circles[i].position.x = rand() % (SCREEN_WIDTH - 100) + 50; // Keep circles away from edges
-        circles[i].position.y = rand() % (SCREEN_HEIGHT - 100) + 50;
+        circles[i].position.x = samples[i].x;
+        circles[i].position.y = samples[i].y;
 
-        // Random velocity components (from -5 to 5, but non-zero)
-        circles[i].velocity.x = (rand() % 5) - 2; // -5 to 5
-        circles[i].velocity.y = (rand() % 5) - 2;
+        circles[i].previous = circles[i].position;
 
-        // Random radius (10 to 50)
-        circles[i].radius = rand() % 81 + 10; // 10 to 50
+        // Random velocity components (from -2 to 2 pixels per 60Hz tick)
+        circles[i].velocity.x = ((rand() % 5) - 2) * 60.0f;
+        circles[i].velocity.y = ((rand() % 5) - 2) * 60.0f;
 
-        // Mass proportional to radius (scaling factor: 1.5 for example)
-        circles[i].mass = circles[i].radius * 1.5;
+        circles[i].radius = samples[i].r;
 
         // Mass proportional to radius (scaling factor: 1.5 for example)
+        circles[i].mass = circles[i].radius * 1.5;
 
-        for (int j = 0; j < i; j++)
-        {
-            if (checkOverlap(&circles[i], &circles[j]))
-            {
-                i--; 
-                break; 
-            }
-        }
-        
+        circles[i].colour = colors[rand() % (sizeof(colors) / sizeof(colors[0]))]; // every entry is opaque
     }
+    free(samples);
 }
 
 void correctPositions() {
@@ -435,6 +445,45 @@ void correctPositions() {
     }
 }
 
+// Advances every circle by one fixed step of dt seconds and bounces it off the screen edges
+void stepCircles(float dt, int substeps) {
+    float subDt = dt / substeps;
+
+    for (int i = 0; i < DYNAMIC_CIRCLES; i++) {
+        circles[i].previous = circles[i].position;
+
+        for (int s = 0; s < substeps; s++) {
+            // Update position based on velocity
+            circles[i].position.x += circles[i].velocity.x * subDt;
+            circles[i].position.y += circles[i].velocity.y * subDt;
+
+            // Handle boundaries
+            // right
+            if (circles[i].position.x >= SCREEN_WIDTH - circles[i].radius) {
+                circles[i].velocity.x *= -1;
+                circles[i].position.x = SCREEN_WIDTH - circles[i].radius;
+            }
+            // left
+            else if (circles[i].position.x <= circles[i].radius)
+            {
+                circles[i].velocity.x *= -1;
+                circles[i].position.x = circles[i].radius;
+            }
+            // bottom
+            else if (circles[i].position.y >= SCREEN_HEIGHT - circles[i].radius) {
+                circles[i].velocity.y *= -1;
+                circles[i].position.y = SCREEN_HEIGHT - circles[i].radius;
+            }
+            // top
+            else if (circles[i].position.y <= circles[i].radius)
+            {
+                circles[i].velocity.y *= -1;
+                circles[i].position.y = circles[i].radius;
+            }
+        }
+    }
+}
+
 void updateMouseVelocity(float* mouseVX, float* mouseVY, float deltaTime , int currentMouseX, int currentMouseY) {
 
     // Calculate the velocity
@@ -622,182 +671,6 @@ void DrawLightFromOutline(SDL_Renderer* renderer, SDL_Point rayEndpoints[], SDL_
     SDL_RenderGeometry(renderer, NULL, vertices, NUM_RAYS * 2, indices, (NUM_RAYS - 1) * 3);
 }
 
-// Helper function to convert degrees to radians
-double deg_to_rad(double degrees) {
-    return degrees * M_PI / 180.0;
-}
-
-// Helper function to calculate angle between two points
-double get_angle(int x1, int y1, int x2, int y2) {
-    return atan2(y2 - y1, x2 - x1) * 180.0 / M_PI;
-}
-
-void drawThickerLine(SDL_Renderer* renderer, 
-                     int x1, int y1, int x2, int y2, int thickness) {
-    // Calculate the vector of the original line
-    float dx = x2 - x1;
-    float dy = y2 - y1;
-
-    // Normalize the perpendicular vector
-    float length = sqrtf(dx * dx + dy * dy);
-    float perp_dx = -dy / length;
-    float perp_dy = dx / length;
-
-    // Scale the perpendicular vector by half the desired thickness
-    float offset = thickness / 2.0;
-
-    // Compute offset points
-    int offset_x1 = x1 + (int)(perp_dx * offset);
-    int offset_y1 = y1 + (int)(perp_dy * offset);
-    int offset_x2 = x2 + (int)(perp_dx * offset);
-    int offset_y2 = y2 + (int)(perp_dy * offset);
-
-    int offset_neg_x1 = x1 - (int)(perp_dx * offset);
-    int offset_neg_y1 = y1 - (int)(perp_dy * offset);
-    int offset_neg_x2 = x2 - (int)(perp_dx * offset);
-    int offset_neg_y2 = y2 - (int)(perp_dy * offset);
-
-    // Draw the original line and the offset lines
-    SDL_RenderDrawLine(renderer, x1, y1, x2, y2);
-    SDL_RenderDrawLine(renderer, offset_x1, offset_y1, offset_x2, offset_y2);
-    SDL_RenderDrawLine(renderer, offset_neg_x1, offset_neg_y1, offset_neg_x2, offset_neg_y2);
-}
-
-
-void drawShadow(SDL_Renderer* renderer, int center_x, int center_y, int end_x, int end_y, int start_x, int start_y, int radius, int intersectionOfLineRayX1, int intersectionOfLineRayY1, int intersectionOfLineRayX2, int intersectionOfLineRayY2, int endXRay1, int endYRay1, int endXRay2, int endYRay2) {
-    
-    
-    // Calculate start and end angles
-    double start_angle = get_angle(center_x, center_y, start_x, start_y);
-    double end_angle = get_angle(center_x, center_y, end_x, end_y);
-    
-    // Ensure end angle is greater than start angle
-    if (end_angle < start_angle) end_angle += 360; 
-
-
-    // Number of segments to draw (more segments = smoother arc)
-    #define segments 100
-    double angle_step = (end_angle - start_angle) / segments;
-
-    Vector2 arcPoints[segments + 1]; 
-
-    // Variables to store the previous point
-    int prev_x = 0;
-    int prev_y = 0;
-
-    float adjustedRadius = radius + 1; 
-
-    for (int i = 0; i <= segments; i++) {
-        double angle = deg_to_rad(start_angle + (i * angle_step));
-        int x = center_x + (int)(adjustedRadius * cos(angle));
-        int y = center_y + (int)(adjustedRadius * sin(angle));
-
-
-        arcPoints[i].x = x;
-        arcPoints[i].y = y;
-
-        // Store current point as previous
-        prev_x = x;
-        prev_y = y;
-    }
-
-
-  // Calculate other points to draw the lines from (0.90 length)
-    int dx_TangentPointToLine = intersectionOfLineRayX1 - start_x;
-    int dy_TangentPointToLine = intersectionOfLineRayY1 - start_y;
-
-    float newEndTangentPointToLine_x = start_x + dx_TangentPointToLine * 0.90;
-    float newEndTangentPointToLine_Y = start_y + dy_TangentPointToLine * 0.90;
-
-    // Calculate other points to draw the lines from (0.95 length)
-    float newEndTangentPointToLine_95_x = start_x + dx_TangentPointToLine * 0.95;
-    float newEndTangentPointToLine_95_Y = start_y + dy_TangentPointToLine * 0.95;
-
-    // Calculate other points to draw the lines from (0.90 length)
-    int dx_CenterOfCircleToLine = intersectionOfLineRayX1 - end_x;
-    int dy_CenterOfCircleToLine = intersectionOfLineRayY1 - end_y;
-
-    float CenterOfCircleToLine_x = end_x + dx_CenterOfCircleToLine * 0.90;
-    float CenterOfCircleToLine_y = end_y + dy_CenterOfCircleToLine * 0.90;
-
-    // Calculate other points to draw the lines from (0.95 length)
-    float CenterOfCircleToLine_95_x = end_x + dx_CenterOfCircleToLine * 0.95;
-    float CenterOfCircleToLine_95_y = end_y + dy_CenterOfCircleToLine * 0.95;
-
-    for (int i = 0; i < segments; i++) {
-        // Original line
-        SDL_RenderDrawLine(renderer, intersectionOfLineRayX1, intersectionOfLineRayY1, arcPoints[i].x, arcPoints[i].y); 
-
-        // 0.90 scaled tangent point
-        SDL_RenderDrawLine(renderer, newEndTangentPointToLine_x, newEndTangentPointToLine_Y, arcPoints[i].x, arcPoints[i].y); 
-
-        // 0.90 scaled center perpendicular line point
-        SDL_RenderDrawLine(renderer, CenterOfCircleToLine_x, CenterOfCircleToLine_y, arcPoints[i].x, arcPoints[i].y); 
-
-        // 0.95 scaled tangent point
-        SDL_RenderDrawLine(renderer, newEndTangentPointToLine_95_x, newEndTangentPointToLine_95_Y, arcPoints[i].x, arcPoints[i].y); 
-
-        // 0.95 scaled center perpendicular line point
-        SDL_RenderDrawLine(renderer, CenterOfCircleToLine_95_x, CenterOfCircleToLine_95_y, arcPoints[i].x, arcPoints[i].y); 
-    }
-
-
-    drawThickerLine(renderer, 
-                    intersectionOfLineRayX1, intersectionOfLineRayY1, 
-                    intersectionOfLineRayX2, intersectionOfLineRayY2, 
-                    5);
-
-
-    // Vertices for a square
-    SDL_Vertex vertices[4] = {
-        {{intersectionOfLineRayX1, intersectionOfLineRayY1},     {0, 0, 0, 255}},    // Top left
-        {{intersectionOfLineRayX2, intersectionOfLineRayY2},   {0, 0, 0, 255}},    // Top right
-        {{endXRay1, endYRay1}, {0, 0, 0, 255}},    // Bottom right
-        {{endXRay2, endYRay2},   {0, 0, 0, 255}}     // Bottom left
-    };
-
-
-
-    // Indices to make two triangles
-    int indices[6] = {
-        0, 2, 1,  // First triangle: left-high to right-high to left-low
-        1, 2, 3   // Second triangle: left-low to right-high to right-low
-    };
-
-    // Draw the square (made of two triangles)
-    SDL_RenderGeometry(renderer, NULL, vertices, 4, indices, 6);
-
-
-}
-
-
-// Function to draw a perpendicular line
-void DrawPerpendicularLine(SDL_Renderer *renderer, int x1, int y1, int x2, int y2, int px, int py, int length, int *perp_x1, int *perp_y1, int *perp_x2, int *perp_y2) {
-    // Calculate slope of the original line
-    double dx = x2 - x1;
-    double dy = y2 - y1;
-    double original_slope = dy / dx;
-
-    // Calculate perpendicular slope
-    double perpendicular_slope = -1 / original_slope;
-
-    // Determine the endpoints of the perpendicular line
-    double angle = atan(perpendicular_slope);
-    int x_offset = length * cos(angle);
-    int y_offset = length * sin(angle);
-
-    // Perpendicular line endpoints
-    *perp_x1 = px - x_offset;
-    *perp_y1 = py - y_offset;
-    *perp_x2 = px + x_offset;
-    *perp_y2 = py + y_offset;
-
-    // Draw the perpendicular line
-    // SDL_RenderDrawLine(renderer, *perp_x1, *perp_y1, *perp_x2, *perp_y2);
-}
-
-
-
 // main function
 int main(int argc, char* args[]) {
     
@@ -826,8 +699,6 @@ int main(int argc, char* args[]) {
             Circle testCircle;
             testCircle.position.x = 800; testCircle.position.y = 400; testCircle.radius = 40; 
 
-            Vector2 tangentPoint1, tangentPoint2;
-
             
             SDL_Point rayStartPoints[NUM_RAYS]; 
             SDL_Point rayEndPoints[NUM_RAYS]; 
@@ -835,6 +706,12 @@ int main(int argc, char* args[]) {
 
 
             InitializeCircles();
+            initGeometryBatch(&circleBatch, CIRCLE_MAX_ERROR);
+            initGeometryBatch(&shadowBatch, CIRCLE_MAX_ERROR);
+            SDL_SetRenderDrawBlendMode(gRenderer, SDL_BLENDMODE_BLEND); // for the shadows' fading fringes
+
+            FixedTimestep step;
+            initFixedTimestep(&step, 1.0 / PHYSICS_HZ, PHYSICS_SUBSTEPS);
 
             while (!quit) {
                 while (SDL_PollEvent(&event) != 0) {
@@ -897,134 +774,55 @@ int main(int argc, char* args[]) {
 
 
  
-                // step 1
-                Vector2 lightToObstacleVector;
-                lightToObstacleVector.x = testCircle.position.x - lightCircle.position.x;
-                lightToObstacleVector.y = testCircle.position.y - lightCircle.position.y;
-                
-                
-                float distLightToObstacle = mag(lightToObstacleVector) - lightCircle.radius;    
-                 
-                // step 3
-                float theta = asin(testCircle.radius / distLightToObstacle); 
-
-                float phi = atan2(lightToObstacleVector.y, lightToObstacleVector.x); // Correct usage
-
-                // step 5
-
-                float directionOfRay1 = phi - theta;
-                float directionOfRay2 = phi + theta;
-
-
-                // step 6
-
-                // this calculates the rays
-                float startX = lightCircle.position.x + lightCircle.radius * cos(phi);
-                float startY = lightCircle.position.y + lightCircle.radius * sin(phi);
-                
-                // step 7
-
-                float endXRay1 = startX + 10000 * cos(directionOfRay1);
-                float endYRay1 = startY + 10000 * sin(directionOfRay1);
-
-                float endXRay2 = startX + 10000 * cos(directionOfRay2);
-                float endYRay2 = startY + 10000 * sin(directionOfRay2);
-                
-
-                // SDL_SetRenderDrawColor(gRenderer, 0, 0, 0, 255);
-                // // Draw the ray to the nearest intersection point or its full length
-                // SDL_RenderDrawLine(gRenderer, (int)startX, (int)startY, (int)endXRay1, (int)endYRay1); // ray1
-
-                // SDL_RenderDrawLine(gRenderer, (int)startX, (int)startY, (int)endXRay2, (int)endYRay2); // ray2
-
-                // this calculates the dots of the tangents of the test circle
-                // using this tutorial
-                // https://stackoverflow.com/questions/49968720/find-tangent-points-in-a-circle-from-a-point
-
-                float vectorFromLightToObstacle = sqrt(pow(startX - testCircle.position.x, 2) + pow(startY - testCircle.position.y, 2)); // this is 'b'
-
-                float thetaV2 = acos(testCircle.radius/ vectorFromLightToObstacle);  // angle theta
-
-                float directionAngle = atan2(startY - testCircle.position.y, startX - testCircle.position.x); // this is 'd'
-
-                float d1 = directionAngle + thetaV2;
-                float d2 = directionAngle - thetaV2;
-                
-                // first tangent point
-                tangentPoint1.x = testCircle.position.x + testCircle.radius * cos(d1);
-                tangentPoint1.y = testCircle.position.y + testCircle.radius * sin(d1);
-                
-                // Second tangent point
-                tangentPoint2.x = testCircle.position.x + testCircle.radius * cos(d2);
-                tangentPoint2.y = testCircle.position.y + testCircle.radius * sin(d2);
-
-                // // Render the tangent points
-                // SDL_SetRenderDrawColor(gRenderer, 100, 100, 100, 255);
-                // DrawFilledCircle(gRenderer, tangentPoint1.x, tangentPoint1.y, 2);
-                // DrawFilledCircle(gRenderer, tangentPoint2.x, tangentPoint2.y, 2);
-
-                float intersectionOfCircleX, intersectionOfCircleY; 
-                float intersectionOfLineRay1X, intersectionOfLineRay1Y; // intersection between the perpendicular line and ray 1
-                float intersectionOfLineRay2X, intersectionOfLineRay2Y; // intersection between the perpendicular line and ray 2
-                int perp_x1, perp_y1, perp_x2, perp_y2;
-
-    
-                RayIntersectsCircle(startX, startY, testCircle.position.x, testCircle.position.y, testCircle.position.x, testCircle.position.y, testCircle.radius, &intersectionOfCircleX, &intersectionOfCircleY); 
-                
-
-                DrawPerpendicularLine(gRenderer, startX, startY, intersectionOfCircleX, intersectionOfCircleY, intersectionOfCircleX, intersectionOfCircleY, 1000, &perp_x1, &perp_y1, &perp_x2, &perp_y2); 
-
-                rayIntersectsLine(startX, startY, tangentPoint1.x, tangentPoint1.y, perp_x1, perp_y1, perp_x2, perp_y2, &intersectionOfLineRay1X, &intersectionOfLineRay1Y);
-                rayIntersectsLine(startX, startY, tangentPoint2.x, tangentPoint2.y, perp_x1, perp_y1, perp_x2, perp_y2, &intersectionOfLineRay2X, &intersectionOfLineRay2Y);
+                // run as many fixed physics steps as this frame covers
+                int steps = beginFrame(&step);
+                for (int i = 0; i < steps; i++) {
+                    stepCircles(step.fixedDt, step.substeps);
+                }
 
-                // Update and draw each circle
-                for (int i = 0; i < DYNAMIC_CIRCLES; i++) {
-                    // Update position based on velocity
-                    circles[i].position.x += circles[i].velocity.x;
-                    circles[i].position.y += circles[i].velocity.y;
-
-                    // Handle boundaries
-                    // right
-                    if (circles[i].position.x >= SCREEN_WIDTH - circles[i].radius) {
-                        circles[i].velocity.x *= -1;
-                        circles[i].position.x = SCREEN_WIDTH - circles[i].radius; 
- 
+                // The moving circles cast new shadows every frame, so only the test circle's shadow is
+                // kept: it changes when the light moves, so the light and test circle are hashed and
+                // its mesh is only rebuilt when that changes.
+                SDL_Color shadow = {0, 0, 0, 255};
+                unsigned key = hashFloat(hashFloat(hashFloat(2166136261u, lightCircle.position.x), lightCircle.position.y), lightCircle.radius);
+                key = hashFloat(hashFloat(hashFloat(key, testCircle.position.x), testCircle.position.y), testCircle.radius);
+                if (!shadowsBuilt || key != shadowKey) {
+                    clearGeometryBatch(&shadowBatch);
+                    batchCircleShadow(&shadowBatch, lightCircle.position.x, lightCircle.position.y, lightCircle.radius,
+                                      testCircle.position.x, testCircle.position.y, testCircle.radius, SHADOW_LENGTH, shadow);
+                    shadowKey = key;
+                    if (LOG_SHADOW_CACHE && shadowsBuilt) {
+                        printf("Shadow mesh rebuilt, the last one was drawn again %d times\n", shadowReuses);
                     }
-                    // left
-                    else if (circles[i].position.x <= circles[i].radius)
-                    {
-                        circles[i].velocity.x *= -1;
-                        circles[i].position.x = circles[i].radius; 
-                    }
-                    // bottom
-                    else if (circles[i].position.y >= SCREEN_HEIGHT - circles[i].radius) { 
-                        circles[i].velocity.y *= -1;
-                        circles[i].position.y = SCREEN_HEIGHT - circles[i].radius; 
+                    shadowsBuilt = true;
+                    shadowReuses = 0;
+                } else {
+                    shadowReuses++;
+                }
+                drawGeometryBatch(&shadowBatch, gRenderer);
 
-                    }
-                    // top
-                    else if (circles[i].position.y <= circles[i].radius)
-                    {
-                        circles[i].velocity.y *= -1;
-                        circles[i].position.y = circles[i].radius; 
- 
-                    }
-                    int randColor = rand() % 15;  // Random index (0 to 14)
-                    SDL_SetRenderDrawColor(gRenderer, circles[i].colour.r, circles[i].colour.g, circles[i].colour.b, circles[i].colour.a);
-                    
-                    // Draw the circle
-                    DrawFilledCircle(gRenderer, circles[i].position.x, circles[i].position.y, circles[i].radius);
+                // the moving circles' shadows go in the same batch as the circles, ahead of them so
+                // they stay underneath
+                for (int i = 0; i < DYNAMIC_CIRCLES; i++) {
+                    float x = circles[i].previous.x + (circles[i].position.x - circles[i].previous.x) * step.alpha;
+                    float y = circles[i].previous.y + (circles[i].position.y - circles[i].previous.y) * step.alpha;
+                    batchCircleShadow(&circleBatch, lightCircle.position.x, lightCircle.position.y, lightCircle.radius,
+                                      x, y, circles[i].radius, SHADOW_LENGTH, shadow);
                 }
 
+                // Draw each circle between its last two physics states, over the shadows
+                for (int i = 0; i < DYNAMIC_CIRCLES; i++) {
+                    float x = circles[i].previous.x + (circles[i].position.x - circles[i].previous.x) * step.alpha;
+                    float y = circles[i].previous.y + (circles[i].position.y - circles[i].previous.y) * step.alpha;
 
-                // Set the draw color
-                SDL_SetRenderDrawColor(gRenderer, 0, 0, 0, 255);
-                drawShadow(gRenderer, testCircle.position.x, testCircle.position.y, intersectionOfCircleX, intersectionOfCircleY,tangentPoint1.x, tangentPoint1.y, testCircle.radius, intersectionOfLineRay1X, intersectionOfLineRay1Y, intersectionOfLineRay2X, intersectionOfLineRay2Y, endXRay1, endYRay1, endXRay2, endYRay2); // using intersectionOfLineRay1
-                drawShadow(gRenderer, testCircle.position.x, testCircle.position.y, tangentPoint2.x, tangentPoint2.y, intersectionOfCircleX, intersectionOfCircleY, testCircle.radius, intersectionOfLineRay2X, intersectionOfLineRay2Y, intersectionOfLineRay1X, intersectionOfLineRay1Y, endXRay1, endYRay1, endXRay2, endYRay2); // using intersectionOfLineRay2
+                    SDL_Color colour = {circles[i].colour.r, circles[i].colour.g, circles[i].colour.b, circles[i].colour.a};
+                    batchFilledCircle(&circleBatch, x, y, circles[i].radius, colour);
+                }
 
-                SDL_SetRenderDrawColor(gRenderer, 255, 0, 0, 255);
-                DrawFilledCircle(gRenderer, lightCircle.position.x, lightCircle.position.y, lightCircle.radius);
-                DrawFilledCircle(gRenderer, testCircle.position.x, testCircle.position.y, testCircle.radius);
+                SDL_Color red = {255, 0, 0, 255};
+                batchFilledCircle(&circleBatch, lightCircle.position.x, lightCircle.position.y, lightCircle.radius, red);
+                batchFilledCircle(&circleBatch, testCircle.position.x, testCircle.position.y, testCircle.radius, red);
+                flushGeometryBatch(&circleBatch, gRenderer);
 
 
 
@@ -1074,6 +872,8 @@ int main(int argc, char* args[]) {
             }
         }
     }
+    freeGeometryBatch(&shadowBatch);
+    freeGeometryBatch(&circleBatch);
     close();
     return 0;
 }
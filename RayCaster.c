@@ -1,4 +1,4 @@
-// gcc -O3 -I src/include -L src/lib -o main rayCast.c -lmingw32 -lSDL2main -lSDL2 -lSDL2_ttf -lSDL2_image -lSDL2_mixer
+// gcc -O3 -I src/include -L src/lib -o main rayCast.c poissonDisk.c geometryBatch.c arcTessellator.c circleBVH.c rayPacket.c occluderScene.c threadPool.c radianceField.c visibilityPolygon.c -lmingw32 -lSDL2main -lSDL2 -lSDL2_ttf -lSDL2_image -lSDL2_mixer
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
@@ -10,11 +10,35 @@
 #include <time.h>
 #include <math.h>
 
+#include "poissonDisk.h"
+#include "geometryBatch.h"
+#include "circleBVH.h"
+#include "rayPacket.h"
+#include "occluderScene.h"
+#include "threadPool.h"
+#include "radianceField.h"
+#include "visibilityPolygon.h"
+
 #define SCREEN_WIDTH 1392 // Screen dimension constants
 #define SCREEN_HEIGHT 744 // the size of the screen
-#define NUM_RAYS 360 // Number of points on the circle
 
 #define MAX_BALLS 1000
+#define CIRCLE_MAX_ERROR 0.35f // pixels a circle's polygon may fall short of the true edge
+#define BVH_REBUILD_RATIO 1.5f // rebuild the circle tree once moving has made it this much slower to walk
+#define WALL_CELL_SIZE 64 // pixels per cell of the wall grid
+#define LEVEL_FILE "lightLevel.txt" // walls loaded at start, if the file is there
+#define WALL_WIDTH 2.0f // pixels, plus a fading fringe WALL_FEATHER wide either side
+#define WALL_FEATHER 1.0f
+
+#define MAX_LIGHTS 16 // right click adds one
+#define LIGHT_RINGS 6 // vertices along each ray, so the falloff curve is followed and not just a straight fade
+#define LIGHT_RANGE_RAYS 128 // evenly spaced rays that keep the edge of a light's range round
+#define AMBIENT_LIGHT 40 // how much of the scene shows where no light reaches, out of 255
+#define RADIANCE_SCALE 8 // screen pixels per light map texel along each side, the arrows switch between 4 and 8
+#define RADIANCE_RAYS 8 // rays per light map texel, up and down halve or double it
+#define MAX_RADIANCE_RAYS 256
+#define RADIANCE_GAIN 6 // a light's disc is only met by a few of a texel's rays, so it glows this much brighter
+#define RADIANCE_SETTLE_FRAMES 8 // frames the light map keeps being recomputed after a change, while the bounce spreads
 
 
 typedef struct {
@@ -25,7 +49,6 @@ typedef struct {
     float x, y;
 } Vector2;
 
-
 typedef struct {
     Vector2 position;        // Position
     Vector2 velocity;      // Velocity
@@ -33,8 +56,41 @@ typedef struct {
     float radius;      // Radius
 } Circle;
 
+// A light with a disc of its own, drawn into the light buffer with its own colour and fade
+typedef struct {
+    Circle body;        // the light's disc, rays leave from its rim
+    SDL_Color colour;
+    float range;        // pixels from the centre where the light has faded out
+    float falloff;      // shape of the fade from the rim to the range: 1 linear, 2 quadratic, ...
+    VisibilityPolygon outline;
+    bool cached;        // outline and mesh are up to date for the key below
+    Circle cachedBody;
+    float cachedRange;
+    unsigned circleKey; // hash of the circles whose bounds touch the light's range
+    unsigned wallKey;   // the same for the walls...
+    unsigned wallVersion; // ...rehashed only once walls.version moves on from this
+} Light;
+
 Circle circles[MAX_BALLS]; // Declare the array
 int DYNAMIC_CIRCLES = 4;
+GeometryBatch circleBatch; // every circle of a frame, drawn in one call
+OccluderScene walls; // straight walls: the screen edges, the level and whatever is drawn with the mouse
+lines screenEdges[4] = {
+    {0, 0, SCREEN_WIDTH, 0},                       // top
+    {0, SCREEN_HEIGHT, SCREEN_WIDTH, SCREEN_HEIGHT}, // bottom
+    {0, 0, 0, SCREEN_HEIGHT},                      // left
+    {SCREEN_WIDTH, 0, SCREEN_WIDTH, SCREEN_HEIGHT}   // right
+};
+CircleBVH circleTree; // the circles again, for the light's rays
+Light lights[MAX_LIGHTS];
+int lightCount = 0;
+SDL_Texture* lightBuffer = NULL; // lights add up here, then it multiplies the scene; NULL adds them straight onto it
+RayDirections rangeRays;
+ThreadPool lightPool; // computes the light map a tile at a time
+RadianceField radiance; // soft lighting, used instead of the visibility polygons when radianceMode is on
+bool radianceMode = false;
+int radianceFrames = 0; // computed since the lights last changed
+int radianceLightCount = 0;
 
 // Texture wrapper structure to hold texture data and dimensions
 typedef struct {
@@ -229,190 +285,277 @@ int getTextureHeight(LTexture* lTexture) {
     return lTexture->height;
 }
 
-bool checkOverlap(Circle* b1, Circle* b2){
-    float dx = b2->position.x - b1->position.x;
-    float dy = b2->position.y - b1->position.y;
-    float dist = sqrt(dx * dx + dy * dy);
-    return dist <= (b1->radius + b2->radius);
-}
-
-// circle functions:
-void DrawFilledCircle(SDL_Renderer* renderer, int centerX, int centerY, float radius) {
-    // Loop through the vertical positions (y-coordinates) of the circle from the top to the bottom
-    for (int y = -radius; y <= radius; y++) {
-        // Calculate the horizontal distance (half-width) at this y-level using the circle equation
-        int dx = (int)sqrt(radius * radius - y * y);  // Could use a faster square root approximation
-
-        // Draw a horizontal line across the diameter of the circle at the current y-level
-        SDL_RenderDrawLine(renderer, centerX - dx, centerY + y, centerX + dx, centerY + y);
-    }
-}
-
 void InitializeCircles() {
     srand(time(NULL)); // Seed random number generator
 
+    // Random radius (10 to 90) with circles kept away from the screen edges. The Poisson-disk
+    // fill never overlaps, so there is no retry loop; a random subset of it is used.
+    PoissonDiskParams params = {50, 50, SCREEN_WIDTH - 50, SCREEN_HEIGHT - 50, 10, 90, 0, 0, rand()};
+    int capacity = maxDiskCount(&params);
+    DiskSample* samples = malloc(sizeof(DiskSample) * capacity);
+    int placed = samples != NULL ? poissonDiskFill(&params, samples, capacity) : 0;
+    shuffleDiskSamples(samples, placed, params.seed);
+    if (DYNAMIC_CIRCLES > placed) DYNAMIC_CIRCLES = placed;
+
     for (int i = 0; i < DYNAMIC_CIRCLES; i++) {
-        int randColor = rand() % 15;
-        // Random position within screen bounds (adjust based on your screen size)
-        circles[i].position.x = rand() % (SCREEN_WIDTH - 100) + 50; // Keep circles away from edges
-        circles[i].position.y = rand() % (SCREEN_HEIGHT - 100) + 50;
+        circles[i].position.x = samples[i].x;
+        circles[i].position.y = samples[i].y;
 
         // Random velocity components (from -5 to 5, but non-zero)
         circles[i].velocity.x = (rand() % 5) - 2; // -5 to 5
         circles[i].velocity.y = (rand() % 5) - 2;
 
-        // Random radius (10 to 50)
-        circles[i].radius = rand() % 81 + 10; // 10 to 50
+        circles[i].radius = samples[i].r;
 
         // Mass proportional to radius (scaling factor: 1.5 for example)
         circles[i].mass = circles[i].radius * 1.5;
-
-        // Mass proportional to radius (scaling factor: 1.5 for example)
-
-        for (int j = 0; j < i; j++)
-        {
-            if (checkOverlap(&circles[i], &circles[j]))
-            {
-                i--; 
-                break; 
-            }
-        }
-        
     }
+    free(samples);
 }
 
-int rayIntersectsLine(float rayStartX, float rayStartY, float rayEndX, float rayEndY,
-                      float lineStartX, float lineStartY, float lineEndX, float lineEndY,
-                      float *intersectionX, float *intersectionY) {
-    float dx = rayEndX - rayStartX;
-    float dy = rayEndY - rayStartY;
-    float sx = lineEndX - lineStartX;
-    float sy = lineEndY - lineStartY;
-
-    float denominator = dx * sy - dy * sx;
-
-    // Check if lines are parallel
-    if (fabs(denominator) < 1e-6) {
-        return 0; // No intersection
+// Turns the light's outline into one closed mesh: LIGHT_RINGS vertices along every ray from the rim
+// to the outline, coloured by how far the light has faded there, joined to the next ray by quads
+bool buildLightMesh(Light* light) {
+    VisibilityPolygon* vis = &light->outline;
+    int n = vis->count;
+    vis->vertexCount = vis->indexCount = 0;
+    if (n < 2) return true;
+
+    if (n * LIGHT_RINGS > vis->vertexCapacity) {
+        SDL_Vertex* vertices = realloc(vis->vertices, sizeof(SDL_Vertex) * n * LIGHT_RINGS);
+        if (vertices == NULL) return false;
+        vis->vertices = vertices;
+        vis->vertexCapacity = n * LIGHT_RINGS;
     }
-
-    float t = ((lineStartX - rayStartX) * sy - (lineStartY - rayStartY) * sx) / denominator;
-    float u = ((lineStartX - rayStartX) * dy - (lineStartY - rayStartY) * dx) / denominator;
-
-    // Check if the intersection is valid
-    if (t >= 0 && u >= 0 && u <= 1) {
-        *intersectionX = rayStartX + t * dx;
-        *intersectionY = rayStartY + t * dy;
-        return 1; // Intersection found
+    if (n * (LIGHT_RINGS - 1) * 6 > vis->indexCapacity) {
+        int* indices = realloc(vis->indices, sizeof(int) * n * (LIGHT_RINGS - 1) * 6);
+        if (indices == NULL) return false;
+        vis->indices = indices;
+        vis->indexCapacity = n * (LIGHT_RINGS - 1) * 6;
     }
 
-    return 0; // No valid intersection
-}
-
-int checkPreBuilt(float rayStartX, float rayStartY, float *rayEndX, float *rayEndY){ // I will need to refactor this
-    float dx = *rayEndX - rayStartX;
-    float dy = *rayEndY - rayStartY;
-
-    // boundaries
-    lines line[4];
-    line[0].startX = 0; line[0].startY = 0; line[0].endX = SCREEN_WIDTH; line[0].endY = 0; // top
-    line[1].startX = 0; line[1].startY = SCREEN_HEIGHT; line[1].endX = SCREEN_WIDTH; line[1].endY = SCREEN_HEIGHT; // bottom
-    line[2].startX = 0; line[2].startY = 0; line[2].endX = 0; line[2].endY = SCREEN_HEIGHT; // left
-    line[3].startX = SCREEN_WIDTH; line[3].startY = 0; line[3].endX = SCREEN_WIDTH; line[3].endY = SCREEN_HEIGHT; // right
-
-    for (int i = 0; i < 4; i++)
-    {
-        float sx = line[i].endX - line[i].startX;
-        float sy = line[i].endY - line[i].startY;
-        float denominator = dx * sy - dy * sx;
-
-        // Check if lines are parallel
-        if (fabs(denominator) < 1e-6) {
-            continue;
+    float cx = light->body.position.x, cy = light->body.position.y;
+    float fade = light->range - light->body.radius;
+    SDL_Vertex* v = vis->vertices;
+    for (int i = 0; i < n; i++) {
+        for (int ring = 0; ring < LIGHT_RINGS; ring++) {
+            float s = (float)ring / (LIGHT_RINGS - 1);
+            float x = vis->starts[i].x + (vis->ends[i].x - vis->starts[i].x) * s;
+            float y = vis->starts[i].y + (vis->ends[i].y - vis->starts[i].y) * s;
+            float d = (sqrtf((x - cx) * (x - cx) + (y - cy) * (y - cy)) - light->body.radius) / fade;
+            float intensity = d < 0 ? 1 : (d > 1 ? 0 : powf(1 - d, light->falloff));
+
+            v->position.x = x;
+            v->position.y = y;
+            v->color.r = (Uint8)(light->colour.r * intensity);
+            v->color.g = (Uint8)(light->colour.g * intensity);
+            v->color.b = (Uint8)(light->colour.b * intensity);
+            v->color.a = 255;
+            v->tex_coord.x = v->tex_coord.y = 0;
+            v++;
         }
+    }
 
-        float t = ((line[i].startX - rayStartX) * sy - (line[i].startY - rayStartY) * sx) / denominator;
-        float u = ((line[i].startX - rayStartX) * dy - (line[i].startY - rayStartY) * dx) / denominator;
+    int* index = vis->indices;
+    for (int i = 0; i < n; i++) {
+        int a = i * LIGHT_RINGS, b = ((i + 1) % n) * LIGHT_RINGS; // the last ray closes the mesh with the first
+        for (int ring = 0; ring < LIGHT_RINGS - 1; ring++) {
+            *index++ = a + ring;
+            *index++ = a + ring + 1;
+            *index++ = b + ring + 1;
+            *index++ = a + ring;
+            *index++ = b + ring + 1;
+            *index++ = b + ring;
+        }
+    }
+    vis->vertexCount = n * LIGHT_RINGS;
+    vis->indexCount = n * (LIGHT_RINGS - 1) * 6;
+    return true;
+}
 
-        // Check if the intersection is valid
-        if (t >= 0 && u >= 0 && u <= 1) {
-            *rayEndX = rayStartX + t * dx;
-            *rayEndY = rayStartY + t * dy;
-            return 1; // Intersection found
-        } 
+void DrawLightFromOutline(SDL_Renderer* renderer, Light* light) {
+    VisibilityPolygon* vis = &light->outline;
+    if (vis->indexCount > 0) {
+        SDL_RenderGeometry(renderer, NULL, vis->vertices, vis->vertexCount, vis->indices, vis->indexCount);
     }
-    return 0; 
+}
 
+bool addLight(float x, float y, float radius, SDL_Color colour, float range, float falloff) {
+    if (lightCount == MAX_LIGHTS) return false;
+    Light* light = &lights[lightCount++];
+    memset(light, 0, sizeof(*light));
+    light->body.position.x = x;
+    light->body.position.y = y;
+    light->body.radius = radius;
+    light->colour = colour;
+    light->range = range;
+    light->falloff = falloff;
+    return true;
 }
 
-int RayIntersectsCircle(float rayStartX, float rayStartY, float rayEndX, float rayEndY,
-                        float circleX, float circleY, float radius, 
-                        float *intersectionX, float *intersectionY) {
-    float dx = rayEndX - rayStartX;
-    float dy = rayEndY - rayStartY;
+// Mixes one occluder into a key. Keys add these up, so the order occluders are found in does not matter.
+unsigned occluderHash(int index, float a, float b, float c, float d) {
+    float values[4] = {a, b, c, d};
+    unsigned hash = 2166136261u ^ (unsigned)index;
+    for (int k = 0; k < 4; k++) {
+        unsigned bits;
+        memcpy(&bits, &values[k], sizeof(bits));
+        hash = (hash ^ bits) * 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
 
-    // Quadratic coefficients
-    float A = dx * dx + dy * dy;
-    float B = 2 * (dx * (rayStartX - circleX) + dy * (rayStartY - circleY));
-    float C = (rayStartX - circleX) * (rayStartX - circleX) + 
-              (rayStartY - circleY) * (rayStartY - circleY) - radius * radius;
+int* nearWallBuffer = NULL; // segmentsNearBox results for wallsKey, grown to the wall count
+int nearWallCapacity = 0;
 
-    // Discriminant
-    float discriminant = B * B - 4 * A * C;
+// Key of every wall with a grid cell touching the box
+unsigned wallsKey(float minX, float minY, float maxX, float maxY) {
+    if (walls.count > nearWallCapacity) {
+        int* grown = realloc(nearWallBuffer, sizeof(int) * walls.count);
+        if (grown == NULL) return walls.version; // no room to look, so any change to the walls counts
+        nearWallBuffer = grown;
+        nearWallCapacity = walls.count;
+    }
+    int count = segmentsNearBox(&walls, minX, minY, maxX, maxY, nearWallBuffer, nearWallCapacity);
+    unsigned key = (unsigned)count;
+    for (int k = 0; k < count; k++) {
+        int w = nearWallBuffer[k];
+        key += occluderHash(w, walls.x0[w], walls.y0[w], walls.x1[w], walls.y1[w]);
+    }
+    return key;
+}
 
-    if (discriminant < 0) {
-        return 0; // No intersection
+// Key of every circle whose bounds touch the box
+unsigned circlesKey(float minX, float minY, float maxX, float maxY) {
+    int nearby[MAX_BALLS];
+    int count = overlapCircleBVH(&circleTree, minX, minY, maxX, maxY, nearby, MAX_BALLS);
+    unsigned key = (unsigned)count;
+    for (int k = 0; k < count; k++) {
+        Circle* c = &circles[nearby[k]];
+        key += occluderHash(nearby[k], c->position.x, c->position.y, c->radius, 0);
     }
+    return key;
+}
 
-    // Compute the two possible values of t
-    float sqrtDiscriminant = sqrt(discriminant);
-    float t1 = (-B - sqrtDiscriminant) / (2 * A);
-    float t2 = (-B + sqrtDiscriminant) / (2 * A);
+// Brings the light's key up to date and says whether it changed: the light itself moved, grew or
+// reached further, or a circle or wall inside its reach moved, came or went. Occluders out of
+// its reach, and everything in a scene at rest, leave the key alone.
+bool lightChanged(Light* light) {
+    float x = light->body.position.x, y = light->body.position.y, reach = light->range;
+    bool moved = x != light->cachedBody.position.x || y != light->cachedBody.position.y ||
+                 light->body.radius != light->cachedBody.radius || light->range != light->cachedRange;
+
+    unsigned circleKey = circlesKey(x - reach, y - reach, x + reach, y + reach);
+    unsigned wallKey = light->wallKey;
+    if (moved || light->wallVersion != walls.version) {
+        wallKey = wallsKey(x - reach, y - reach, x + reach, y + reach);
+    }
+    bool changed = moved || circleKey != light->circleKey || wallKey != light->wallKey;
+
+    light->cachedBody = light->body;
+    light->cachedRange = light->range;
+    light->circleKey = circleKey;
+    light->wallKey = wallKey;
+    light->wallVersion = walls.version;
+    return changed;
+}
 
-    // Check for the smallest positive t (valid intersection)
-    float t = (t1 >= 0) ? t1 : ((t2 >= 0) ? t2 : -1);
-    if (t < 0) {
-        return 0; // No valid intersection
+// Recasts only the lights whose key changed, a light whose view is unchanged keeps last frame's
+// mesh and costs one draw call. Returns how many were recast.
+int updateLights(void) {
+    int recast = 0;
+    for (int l = 0; l < lightCount; l++) {
+        Light* light = &lights[l];
+        if (!lightChanged(light) && light->cached) continue;
+
+        computeVisibility(&light->outline, &walls, &circleTree, &rangeRays, &circleBatch.arcs,
+                          light->body.position.x, light->body.position.y, light->body.radius, light->range);
+        light->cached = buildLightMesh(light);
+        recast++;
     }
+    return recast;
+}
 
-    // Calculate the intersection point
-    *intersectionX = rayStartX + t * dx;
-    *intersectionY = rayStartY + t * dy;
+SDL_FPoint* wallPoints = NULL; // one run of walls at a time for batchWalls, grown to the wall count
+int wallPointCapacity = 0;
+
+// Strokes every wall into the batch. Walls added one after another in the same group that carry
+// on from each other, as a polygon's or polyline's do, are stroked as one polyline so their
+// corners are mitred, and a run that comes back to its start is closed.
+void batchWalls(GeometryBatch* batch) {
+    SDL_Color white = {255, 255, 255, 255};
+    if (walls.count + 1 > wallPointCapacity) {
+        SDL_FPoint* grown = realloc(wallPoints, sizeof(SDL_FPoint) * (walls.count + 1));
+        if (grown == NULL) return;
+        wallPoints = grown;
+        wallPointCapacity = walls.count + 1;
+    }
 
-    return 1; // Intersection found
+    int w = 0;
+    while (w < walls.count) {
+        int count = 0;
+        wallPoints[count++] = (SDL_FPoint){walls.x0[w], walls.y0[w]};
+        wallPoints[count++] = (SDL_FPoint){walls.x1[w], walls.y1[w]};
+        for (w++; w < walls.count && walls.group[w] == walls.group[w - 1] &&
+                  walls.x0[w] == walls.x1[w - 1] && walls.y0[w] == walls.y1[w - 1]; w++) {
+            wallPoints[count++] = (SDL_FPoint){walls.x1[w], walls.y1[w]};
+        }
+        bool closed = count > 3 && wallPoints[count - 1].x == wallPoints[0].x && wallPoints[count - 1].y == wallPoints[0].y;
+        batchPolyline(batch, wallPoints, closed ? count - 1 : count, closed, WALL_WIDTH, LINE_JOIN_MITER, WALL_FEATHER, white);
+    }
 }
 
+// Adds every light up in the light buffer over the ambient level and multiplies the scene by it
+void renderLights(SDL_Renderer* renderer) {
+    if (lightBuffer != NULL) {
+        SDL_SetRenderTarget(renderer, lightBuffer);
+        SDL_SetRenderDrawColor(renderer, AMBIENT_LIGHT, AMBIENT_LIGHT, AMBIENT_LIGHT, 255);
+        SDL_RenderClear(renderer);
+    }
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_ADD);
+    for (int l = 0; l < lightCount; l++) {
+        DrawLightFromOutline(renderer, &lights[l]);
+    }
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
 
-void DrawLightFromOutline(SDL_Renderer* renderer, SDL_Point rayEndpoints[], SDL_Point rayStarts[]) {
-    SDL_Vertex vertices[NUM_RAYS * 2]; // Two vertices for each ray: start and end
+    if (lightBuffer != NULL) {
+        SDL_SetRenderTarget(renderer, NULL);
+        SDL_RenderCopy(renderer, lightBuffer, NULL, NULL); // the buffer's blend mode is MOD
+    }
+}
 
-    // Create vertices for the light effect
-    for (int i = 0; i < NUM_RAYS; i++) {
-        // Ray start point (on the circle outline)
-        vertices[i * 2].position.x = rayStarts[i].x;
-        vertices[i * 2].position.y = rayStarts[i].y;
-        vertices[i * 2].color = (SDL_Color){255, 255, 100, 200}; // Light yellow
 
-        // Ray end point
-        vertices[i * 2 + 1].position.x = rayEndpoints[i].x;
-        vertices[i * 2 + 1].position.y = rayEndpoints[i].y;
-        vertices[i * 2 + 1].color = (SDL_Color){255, 255, 100, 0}; // Fading light
+// Soft lighting: every light becomes a glowing disc for the light map, which is computed on the
+// worker threads at a fraction of the screen's resolution and multiplies the scene. The map is
+// only recomputed for a few frames after a light's key changes, long enough for the bounce
+// to settle, and otherwise last frame's texture is drawn again.
+void renderRadiance(SDL_Renderer* renderer) {
+    bool changed = lightCount != radianceLightCount;
+    for (int l = 0; l < lightCount; l++) {
+        if (lightChanged(&lights[l])) changed = true;
     }
-
-    // Define indices for triangles
-    int indices[(NUM_RAYS - 1) * 3]; // Each triangle needs 3 indices
-    for (int i = 0; i < NUM_RAYS - 1; i++) {
-        indices[i * 3] = i * 2;         // Start of ray i
-        indices[i * 3 + 1] = i * 2 + 1; // End of ray i
-        indices[i * 3 + 2] = i * 2 + 3; // End of ray i+1
+    radianceLightCount = lightCount;
+    if (changed) radianceFrames = 0;
+    if (radianceFrames >= RADIANCE_SETTLE_FRAMES) {
+        drawRadianceField(&radiance, renderer);
+        return;
     }
 
-    // Draw geometry
-    SDL_RenderGeometry(renderer, NULL, vertices, NUM_RAYS * 2, indices, (NUM_RAYS - 1) * 3);
+    RadianceEmitter emitters[MAX_LIGHTS];
+    for (int l = 0; l < lightCount; l++) {
+        Light* light = &lights[l];
+        emitters[l] = (RadianceEmitter){
+            light->body.position.x, light->body.position.y, light->body.radius,
+            light->colour.r * RADIANCE_GAIN, light->colour.g * RADIANCE_GAIN, light->colour.b * RADIANCE_GAIN,
+            light->range
+        };
+    }
+    if (computeRadianceField(&radiance, &lightPool, &walls, &circleTree, emitters, lightCount)) {
+        radianceFrames++;
+        drawRadianceField(&radiance, renderer);
+    }
 }
 
-
-
 // main function
 int main(int argc, char* args[]) {
     
@@ -425,14 +568,36 @@ int main(int argc, char* args[]) {
             int quit = 0;
             SDL_Event event;
             
-            Circle lightCircle;
-            lightCircle.position.x = 350; lightCircle.position.y = 400; lightCircle.radius = 80; 
-            
-            SDL_Point rayStartPoints[NUM_RAYS]; 
-            SDL_Point rayEndPoints[NUM_RAYS]; 
+            addLight(350, 400, 80, (SDL_Color){255, 255, 100, 255}, 900, 1.5f);
+            SDL_Color lightColours[] = {{255, 120, 80, 255}, {90, 160, 255, 255}, {120, 255, 140, 255}, {230, 110, 255, 255}};
+            initRayDirections(&rangeRays, LIGHT_RANGE_RAYS);
+
+            // without render targets the lights are added straight onto the scene
+            lightBuffer = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
+            if (lightBuffer != NULL) SDL_SetTextureBlendMode(lightBuffer, SDL_BLENDMODE_MOD);
+
+            // R switches to the light map, which needs its texture and the worker threads
+            initThreadPool(&lightPool, 0);
+            if (initRadianceField(&radiance, gRenderer, SCREEN_WIDTH, SCREEN_HEIGHT, RADIANCE_SCALE, RADIANCE_RAYS)) {
+                radiance.ambient = AMBIENT_LIGHT;
+            }
 
 
             InitializeCircles();
+            initGeometryBatch(&circleBatch, CIRCLE_MAX_ERROR);
+            initCircleBVH(&circleTree, BVH_REBUILD_RATIO);
+
+            initOccluderScene(&walls, WALL_CELL_SIZE);
+            for (int e = 0; e < 4; e++) {
+                addSegment(&walls, screenEdges[e].startX, screenEdges[e].startY, screenEdges[e].endX, screenEdges[e].endY);
+            }
+            FILE* level = fopen(LEVEL_FILE, "r");
+            if (level != NULL) {
+                fclose(level);
+                loadOccluderLevel(&walls, LEVEL_FILE);
+            }
+            int firstDrawnWall = walls.nextGroup; // C takes away everything from here on
+            int wallStartX = 0, wallStartY = 0;
 
             while (!quit) {
                 while (SDL_PollEvent(&event) != 0) {
@@ -440,27 +605,59 @@ int main(int argc, char* args[]) {
                     if (event.type == SDL_QUIT) quit = 1;
                     if (event.type == SDL_KEYDOWN) {
                         if (event.key.keysym.sym == SDLK_ESCAPE) quit = 1;
-                        if (event.key.keysym.sym == SDLK_c) {};
+                        if (event.key.keysym.sym == SDLK_c) {
+                            for (int group = firstDrawnWall; group < walls.nextGroup; group++) removeOccluder(&walls, group);
+                            for (int l = 1; l < lightCount; l++) freeVisibilityPolygon(&lights[l].outline);
+                            lightCount = 1;
+                        }
+
+                        // each mode keeps the lights' keys for itself, so the other starts over
+                        if (event.key.keysym.sym == SDLK_r) {
+                            radianceMode = !radianceMode;
+                            radianceFrames = 0;
+                            for (int l = 0; l < lightCount; l++) lights[l].cached = false;
+                        }
 
-                        // mode for which substance will be dropped
-                        if (event.key.keysym.sym == SDLK_RIGHT){};
-                        if (event.key.keysym.sym == SDLK_LEFT){};
+                        // the light map's resolution: right makes texels coarser, left finer
+                        if (event.key.keysym.sym == SDLK_RIGHT && radiance.scale < 8) {
+                            setRadianceQuality(&radiance, gRenderer, 8, radiance.raysPerTexel);
+                            radianceFrames = 0;
+                        }
+                        if (event.key.keysym.sym == SDLK_LEFT && radiance.scale > 4) {
+                            setRadianceQuality(&radiance, gRenderer, 4, radiance.raysPerTexel);
+                            radianceFrames = 0;
+                        }
 
-                        // this changes the size of the dropper
-                        if (event.key.keysym.sym == SDLK_UP) {};
-                        if (event.key.keysym.sym == SDLK_DOWN){};
+                        // and its rays per texel
+                        if (event.key.keysym.sym == SDLK_UP && radiance.raysPerTexel < MAX_RADIANCE_RAYS) {
+                            setRadianceQuality(&radiance, gRenderer, radiance.scale, radiance.raysPerTexel * 2);
+                            radianceFrames = 0;
+                        }
+                        if (event.key.keysym.sym == SDLK_DOWN && radiance.raysPerTexel > 1) {
+                            setRadianceQuality(&radiance, gRenderer, radiance.scale, radiance.raysPerTexel / 2);
+                            radianceFrames = 0;
+                        }
 
                     }
 
+                    // drag with the left button to draw a wall
                     if (event.type == SDL_MOUSEBUTTONDOWN) {
                         if (event.button.button == SDL_BUTTON_LEFT) {
-                            
+                            wallStartX = event.button.x;
+                            wallStartY = event.button.y;
                         }
                     }
 
+                    // right click adds a light
+                    if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_RIGHT) {
+                        addLight(event.button.x, event.button.y, 12, lightColours[lightCount % 4], 450, 2.0f);
+                    }
+
                     if (event.type == SDL_MOUSEBUTTONUP) {
                         if (event.button.button == SDL_BUTTON_LEFT) {
-                            
+                            if (event.button.x != wallStartX || event.button.y != wallStartY) {
+                                addSegment(&walls, wallStartX, wallStartY, event.button.x, event.button.y);
+                            }
                         }
                     }
 
@@ -472,6 +669,7 @@ int main(int argc, char* args[]) {
 
                 
                 // Update and draw each circle
+                SDL_Color circleColour = {246, 196, 31, 255};
                 for (int i = 0; i < DYNAMIC_CIRCLES; i++) {
                     // Update position based on velocity
                     circles[i].position.x += circles[i].velocity.x;
@@ -504,68 +702,40 @@ int main(int argc, char* args[]) {
  
                     }
 
-                    
-                    SDL_SetRenderDrawColor(gRenderer, 246, 196, 31, 255);
-                    // Draw the circle
-                    DrawFilledCircle(gRenderer, circles[i].position.x, circles[i].position.y, circles[i].radius);
-                    
-                    DrawFilledCircle(gRenderer, lightCircle.position.x, lightCircle.position.y, lightCircle.radius);
-
 
+                    // Draw the circle
+                    batchFilledCircle(&circleBatch, circles[i].position.x, circles[i].position.y, circles[i].radius, circleColour);
                 }
+                flushGeometryBatch(&circleBatch, gRenderer);
 
-                for (int j = 0; j < NUM_RAYS; j++) {
-                    // Calculate the angle for this ray
-                    float angle = j * (2 * M_PI / NUM_RAYS);
-
-                    // Calculate the starting point of the ray
-                    float startX = lightCircle.position.x + lightCircle.radius * cos(angle);
-                    float startY = lightCircle.position.y + lightCircle.radius * sin(angle);
-
-                    // Initialize the end point of the ray to be far away
-                    float endX = startX + 5000 * cos(angle);
-                    float endY = startY + 5000 * sin(angle);
-
-                    float nearestX = endX, nearestY = endY; // Store nearest intersection point
-                    int foundIntersection = 0; // Flag to indicate intersection occurred
-
+                // refit the ray tree to where the circles moved
+                if (resizeCircleBVH(&circleTree, DYNAMIC_CIRCLES)) {
                     for (int i = 0; i < DYNAMIC_CIRCLES; i++) {
-                        float intersectionX, intersectionY;
-
-                        if (RayIntersectsCircle(startX, startY, endX, endY,
-                                                circles[i].position.x, circles[i].position.y, circles[i].radius,
-                                                &intersectionX, &intersectionY)) {
-                            
-                            foundIntersection = 1;
-
-                            // Calculate distance to this intersection
-                            float distToIntersection = sqrt(pow(intersectionX - startX, 2) + pow(intersectionY - startY, 2));
-                            float distToNearest = sqrt(pow(nearestX - startX, 2) + pow(nearestY - startY, 2));
-
-                            // Update nearest intersection point if closer
-                            if (distToIntersection < distToNearest) {
-                                nearestX = intersectionX;
-                                nearestY = intersectionY;
-                            }
-
-                        }
+                        circleTree.x[i] = circles[i].position.x;
+                        circleTree.y[i] = circles[i].position.y;
+                        circleTree.r[i] = circles[i].radius;
                     }
+                    updateCircleBVH(&circleTree);
+                }
 
-                    // Draw the ray to the nearest intersection point or its full length
-                    // SDL_RenderDrawLine(gRenderer, (int)startX, (int)startY, (int)nearestX, (int)nearestY);
-
-                    rayStartPoints[j].x = (int)startX; rayStartPoints[j].y = (int)startY;
-                    rayEndPoints[j].x = (int)nearestX; rayEndPoints[j].y = (int)nearestY;
-
+                SDL_SetRenderDrawBlendMode(gRenderer, SDL_BLENDMODE_BLEND);
+                batchWalls(&circleBatch);
+                flushGeometryBatch(&circleBatch, gRenderer);
+                SDL_SetRenderDrawBlendMode(gRenderer, SDL_BLENDMODE_NONE);
 
-                        
+                if (radianceMode) {
+                    renderRadiance(gRenderer);
+                } else {
+                    updateLights();
+                    renderLights(gRenderer);
                 }
 
-                DrawLightFromOutline(gRenderer, rayEndPoints, rayStartPoints);
+                // the lights' own discs, unaffected by the lighting
+                for (int l = 0; l < lightCount; l++) {
+                    batchFilledCircle(&circleBatch, lights[l].body.position.x, lights[l].body.position.y, lights[l].body.radius, lights[l].colour);
+                }
+                flushGeometryBatch(&circleBatch, gRenderer);
 
-                
-                
-                
 
                 //this is for text
                 renderTexture(&modeTextTexture, 0,0, NULL, 0, NULL, SDL_FLIP_NONE); 
@@ -577,6 +747,16 @@ int main(int argc, char* args[]) {
             }
         }
     }
+    for (int l = 0; l < lightCount; l++) freeVisibilityPolygon(&lights[l].outline);
+    if (lightBuffer != NULL) SDL_DestroyTexture(lightBuffer);
+    freeRadianceField(&radiance);
+    freeThreadPool(&lightPool);
+    freeRayDirections(&rangeRays);
+    free(nearWallBuffer);
+    free(wallPoints);
+    freeCircleBVH(&circleTree);
+    freeOccluderScene(&walls);
+    freeGeometryBatch(&circleBatch);
     close();
     return 0;
 }
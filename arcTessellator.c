@@ -0,0 +1,91 @@
+#include "arcTessellator.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define PI 3.14159265358979323846f
+#define MIN_CIRCLE_SEGMENTS 6
+#define MAX_CIRCLE_SEGMENTS 256
+
+void initArcTessellator(ArcTessellator* arcs, float maxError) {
+    memset(arcs, 0, sizeof(*arcs));
+    arcs->maxError = maxError > 0 ? maxError : 0.5f;
+}
+
+void freeArcTessellator(ArcTessellator* arcs) {
+    for (int n = 0; n < arcs->tableCount; n++) {
+        free(arcs->tables[n]);
+    }
+    free(arcs->tables);
+    memset(arcs, 0, sizeof(*arcs));
+}
+
+int circleSegmentCount(const ArcTessellator* arcs, float radius) {
+    // a chord of angle a sits radius * (1 - cos(a / 2)) inside the circle at its middle, which is
+    // at most radius * a^2 / 8, so a = sqrt(8 * maxError / radius) keeps within it without an acosf
+    if (radius <= arcs->maxError) {
+        return MIN_CIRCLE_SEGMENTS;
+    }
+    int segments = (int)ceilf(PI * sqrtf(radius / (2.0f * arcs->maxError)));
+    if (segments < MIN_CIRCLE_SEGMENTS) return MIN_CIRCLE_SEGMENTS;
+    if (segments > MAX_CIRCLE_SEGMENTS) return MAX_CIRCLE_SEGMENTS;
+    return segments;
+}
+
+int arcSegmentCount(const ArcTessellator* arcs, float radius, float sweep) {
+    int segments = (int)ceilf(circleSegmentCount(arcs, radius) * fabsf(sweep) / (2.0f * PI));
+    return segments > 0 ? segments : 1;
+}
+
+const SDL_FPoint* unitCircle(ArcTessellator* arcs, int segments) {
+    if (segments < 1) {
+        return NULL;
+    }
+    if (segments >= arcs->tableCount) {
+        int count = arcs->tableCount > 0 ? arcs->tableCount : MAX_CIRCLE_SEGMENTS + 1;
+        while (count <= segments) {
+            count *= 2;
+        }
+        SDL_FPoint** grown = realloc(arcs->tables, sizeof(SDL_FPoint*) * count);
+        if (grown == NULL) {
+            return NULL;
+        }
+        memset(grown + arcs->tableCount, 0, sizeof(SDL_FPoint*) * (count - arcs->tableCount));
+        arcs->tables = grown;
+        arcs->tableCount = count;
+    }
+
+    if (arcs->tables[segments] == NULL) {
+        // made once, so each point gets its own cosf/sinf and no rounding builds up round the circle
+        SDL_FPoint* table = malloc(sizeof(SDL_FPoint) * (segments + 1));
+        if (table == NULL) {
+            return NULL;
+        }
+        for (int k = 0; k < segments; k++) {
+            float angle = 2.0f * PI * k / segments;
+            table[k].x = cosf(angle);
+            table[k].y = sinf(angle);
+        }
+        table[segments] = table[0];
+        arcs->tables[segments] = table;
+    }
+    return arcs->tables[segments];
+}
+
+int tessellateArc(float x, float y, float radius, float startX, float startY, float sweep,
+                  int segments, SDL_FPoint* out) {
+    if (segments < 1) {
+        segments = 1;
+    }
+    float stepCos = cosf(sweep / segments), stepSin = sinf(sweep / segments);
+    float dirX = startX, dirY = startY;
+    for (int k = 0; k <= segments; k++) {
+        out[k].x = x + dirX * radius;
+        out[k].y = y + dirY * radius;
+        float rotated = dirX * stepCos - dirY * stepSin;
+        dirY = dirX * stepSin + dirY * stepCos;
+        dirX = rotated;
+    }
+    return segments + 1;
+}
@@ -0,0 +1,35 @@
+#ifndef ARC_TESSELLATOR_H
+#define ARC_TESSELLATOR_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+// Splits circles and arcs into straight segments that stay within maxError pixels of the true
+// curve. Whole circles come from unit-circle tables made once per segment count and scaled;
+// arcs turn a unit vector through one fixed rotation per point, a complex multiply. Neither
+// calls cosf or sinf per point, and the segment count needs only a sqrtf.
+typedef struct {
+    float maxError;
+    SDL_FPoint** tables; // tables[n]: the unit circle split into n segments, NULL until first asked for
+    int tableCount;      // length of tables
+} ArcTessellator;
+
+void initArcTessellator(ArcTessellator* arcs, float maxError);
+void freeArcTessellator(ArcTessellator* arcs);
+
+// Segments for a whole circle of this radius to stay within maxError
+int circleSegmentCount(const ArcTessellator* arcs, float radius);
+
+// Segments for an arc of this radius turning sweep radians either way, at least 1
+int arcSegmentCount(const ArcTessellator* arcs, float radius, float sweep);
+
+// segments + 1 points round the unit circle from angle 0, point k at angle 2 * pi * k / segments
+// and the last one back on the first. NULL when out of memory.
+const SDL_FPoint* unitCircle(ArcTessellator* arcs, int segments);
+
+// Writes the segments + 1 points of the arc round (x, y) that starts in the unit direction
+// (startX, startY) and turns sweep radians, towards +y when positive. Returns how many were written.
+int tessellateArc(float x, float y, float radius, float startX, float startY, float sweep,
+                  int segments, SDL_FPoint* out);
+
+#endif
@@ -48,6 +48,7 @@ GitHub: https://github.com/Ghassan-top-dev
 
 ///////////////////////////////////////////////////*/
 
+// gcc -O3 -mavx2 -I src/include -L src/lib -o main cellularAutomataSandboxV2.c circleWorld.c threadPool.c geometryBatch.c arcTessellator.c gridLight.c glyphAtlas.c -lmingw32 -lSDL2main -lSDL2 -lSDL2_ttf -lSDL2_image -lSDL2_mixer
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
@@ -58,6 +59,13 @@ GitHub: https://github.com/Ghassan-top-dev
 #include <stdbool.h>
 #include <time.h>
 #include <math.h>
+#include <stdint.h>
+
+#include "circleWorld.h"
+#include "geometryBatch.h"
+#include "threadPool.h"
+#include "gridLight.h"
+#include "glyphAtlas.h"
 
 // Screen dimension constants
 // the size of the screen
@@ -74,6 +82,24 @@ GitHub: https://github.com/Ghassan-top-dev
 #define GRID_HEIGHT (SCREEN_HEIGHT / PIXEL_SIZE)
 #define GRID_WIDTH (SCREEN_WIDTH / PIXEL_SIZE)
 
+// rigid circles (B drops one at the mouse) that push the sand around
+#define BALL_DT (1.0f / 60.0f) // one circle step per frame, like the cells
+#define BALL_SUBSTEPS 2
+#define BALL_GRAVITY 900.0f // pixels per second^2
+#define BALL_FRICTION 0.4f // lets a heap of circles come to rest instead of sliding flat
+#define BALL_MIN_RADIUS 10
+#define BALL_MAX_RADIUS 28
+#define CELL_MASS 0.5f // mass of one sand cell, circles weigh radius * 1.5 like in circlePhysics
+#define GRID_RESTITUTION 0.2f // bounce off cells that hold their ground
+#define EJECT_MARGIN 4 // cells past a circle's edge searched for room to throw displaced sand into
+#define WINDOW_CELLS 64 // the cells around a circle are sampled as one 64 bit word per row
+
+#define MAX_PLACED_LIGHTS 16 // right click places one
+#define PLACED_LIGHT_RANGE 90 // cells
+#define FIRE_BLOCK 8 // fire cells light the sandbox in blocks of this many cells square, one light per burning block
+#define FIRE_LIGHT_RANGE 18 // cells
+#define SANDBOX_AMBIENT 45 // how much shows where no light reaches, out of 255
+
 // Texture wrapper structure to hold texture data and dimensions
 typedef struct {
     SDL_Texture* texture;
@@ -81,7 +107,7 @@ typedef struct {
     int height;
 } LTexture;
 
-SDL_Color textColor = {255, 255, 255}; // text color
+SDL_Color textColor = {255, 255, 255, 255}; // text color, opaque since it tints the glyph atlas
 SDL_Color textColorForSubstances = {255, 255, 255};
 
 
@@ -179,12 +205,21 @@ void renderTexture(LTexture* lTexture, int x, int y, SDL_Rect* clip, double angl
 int getTextureWidth(LTexture* lTexture);
 int getTextureHeight(LTexture* lTexture);
 
-// Global variables for the SDL window, renderer, font, and text texture
+CircleWorld balls; // circles dropped into the sandbox
+SDL_Color* ballColours = NULL; // attached to balls so colours follow their circle
+GeometryBatch ballBatch;
+
+GridLighting cellLighting; // L switches it on: shadows of sand, wood and circles from placed lights and fire
+ThreadPool lightPool;
+bool lightMode = false;
+SDL_Point placedLights[MAX_PLACED_LIGHTS]; // in cells
+int placedLightCount = 0;
+
+// Global variables for the SDL window, renderer, font, and glyph atlas
 SDL_Window* gWindow = NULL;
 SDL_Renderer* gRenderer = NULL;
 TTF_Font* gFont = NULL;
-LTexture modeTextTexture;
-LTexture SizeOfDropperTexture;
+GlyphAtlas hudText; // the font's glyphs, rendered once, so the mode and dropper size are redrawn each frame without SDL_ttf
 
 // Initializes SDL, creates window and renderer, sets up image and text libraries
 bool init() {
@@ -243,15 +278,9 @@ bool loadMedia() {
         success = false;
     } else {
 
-        // Render the text to create a texture
-        if (!loadFromRenderedText(&modeTextTexture, " ", textColor)) {
-            printf("Failed to render text texture!\n");
-            success = false;
-        }
-
-        // Render the text to create a texture
-        if (!loadFromRenderedText(&SizeOfDropperTexture, " ", textColor)) {
-            printf("Failed to render text texture!\n");
+        // Render every glyph once into the atlas the HUD text is drawn from
+        if (!initGlyphAtlas(&hudText, gRenderer, gFont)) {
+            printf("Failed to build glyph atlas!\n");
             success = false;
         }
     }
@@ -260,8 +289,7 @@ bool loadMedia() {
 
 // Frees up resources and shuts down SDL libraries
 void close() {
-    freeTexture(&modeTextTexture); // Free text texture
-    freeTexture(&SizeOfDropperTexture); 
+    freeGlyphAtlas(&hudText); // Free glyph atlas
 
     TTF_CloseFont(gFont); // Close font
     gFont = NULL;
@@ -917,6 +945,219 @@ void updatePhysics() {
 }
 
 
+// Occupancy of the cells around one circle, one bit per cell: bit b of row r is GRID[x0 + b][y0 + r].
+// Sampling it costs the circle's area, never the grid's, and every query after that reads whole
+// rows of bits, so empty space is skipped 64 cells at a time.
+typedef struct {
+    int x0, y0;
+    int cells;                    // the window is cells x cells, at most WINDOW_CELLS
+    uint64_t solid[WINDOW_CELLS]; // sand and wood, what a circle collides with
+    uint64_t loose[WINDOW_CELLS]; // the solid cells a circle can push aside (sand)
+} CellWindow;
+
+static uint64_t bitSpan(int b0, int b1) { // bits b0..b1 set, 0 <= b0 <= b1 < 64
+    return (~0ULL >> (63 - b1)) & (~0ULL << b0);
+}
+
+// Samples the cells within reach of a circle at (cx, cy) with radius rc, all in cell units
+void sampleCellWindow(CellWindow* w, float cx, float cy, float rc) {
+    int reach = (int)ceilf(rc) + EJECT_MARGIN;
+    if (2 * reach + 1 > WINDOW_CELLS) reach = (WINDOW_CELLS - 1) / 2;
+    w->x0 = (int)cx - reach;
+    w->y0 = (int)cy - reach;
+    w->cells = 2 * reach + 1;
+
+    int b0 = w->x0 < 0 ? -w->x0 : 0;
+    int b1 = w->x0 + w->cells > GRID_WIDTH ? GRID_WIDTH - 1 - w->x0 : w->cells - 1;
+    for (int row = 0; row < w->cells; row++) {
+        uint64_t solid = 0, loose = 0;
+        int gy = w->y0 + row;
+        if (gy >= 0 && gy < GRID_HEIGHT) {
+            for (int b = b0; b <= b1; b++) {
+                PixelType type = GRID[w->x0 + b][gy].type;
+                if (type == SAND || type == WOOD) solid |= 1ULL << b;
+                if (type == SAND) loose |= 1ULL << b;
+            }
+        }
+        w->solid[row] = solid;
+        w->loose[row] = loose;
+    }
+}
+
+// Throws the sand cell at bit b of row out along (ux, uy) into the first empty cell past the
+// circle's edge. False when there is no room within EJECT_MARGIN cells of the edge.
+bool ejectCell(CellWindow* w, int b, int row, float ux, float uy, float cx, float cy, float rc) {
+    float px = w->x0 + b + 0.5f, py = w->y0 + row + 0.5f;
+    int steps = (int)ceilf(rc - sqrtf((px - cx) * (px - cx) + (py - cy) * (py - cy))) + EJECT_MARGIN;
+
+    for (int k = 1; k <= steps; k++) {
+        int tb = (int)floorf(px + ux * k) - w->x0, trow = (int)floorf(py + uy * k) - w->y0;
+        int gx = w->x0 + tb, gy = w->y0 + trow;
+        if (tb < 0 || tb >= w->cells || trow < 0 || trow >= w->cells ||
+            gx < 0 || gx >= GRID_WIDTH || gy < 0 || gy >= GRID_HEIGHT) {
+            return false;
+        }
+        float ox = gx + 0.5f - cx, oy = gy + 0.5f - cy;
+        if (ox * ox + oy * oy < rc * rc || (w->solid[trow] >> tb) & 1 || GRID[gx][gy].type != EMPTY) {
+            continue; // still under the circle or taken, look further out
+        }
+
+        GRID[gx][gy] = GRID[w->x0 + b][w->y0 + row];
+        GRID[gx][gy].velocity = 0;
+        GRID[w->x0 + b][w->y0 + row] = emptyPixel;
+        w->solid[trow] |= 1ULL << tb;
+        w->loose[trow] |= 1ULL << tb;
+        w->solid[row] &= ~(1ULL << b);
+        w->loose[row] &= ~(1ULL << b);
+        return true;
+    }
+    return false;
+}
+
+// Collides circle i with the solid cells it covers. The circle's signed distance is sampled at
+// the centre of every occupied cell under it: sand is ejected past the edge and takes some of the
+// circle's momentum with it, cells that cannot move (wood, packed sand) push the circle back out
+// along the depth-weighted sum of their directions.
+void collideBallWithGrid(int i) {
+    float cx = balls.x[i] / PIXEL_SIZE, cy = balls.y[i] / PIXEL_SIZE, rc = balls.r[i] / PIXEL_SIZE;
+    float mass = 1.0f / balls.invMass[i];
+    CellWindow w;
+    sampleCellWindow(&w, cx, cy, rc);
+
+    float nx = 0, ny = 0, depth = 0;
+    for (int row = 0; row < w.cells; row++) {
+        float dy = w.y0 + row + 0.5f - cy;
+        if (dy * dy >= rc * rc) continue;
+
+        // cells of this row whose centre lies inside the circle
+        float half = sqrtf(rc * rc - dy * dy);
+        int b0 = (int)ceilf(cx - half - 0.5f) - w.x0, b1 = (int)floorf(cx + half - 0.5f) - w.x0;
+        if (b0 < 0) b0 = 0;
+        if (b1 > w.cells - 1) b1 = w.cells - 1;
+        if (b0 > b1) continue;
+
+        uint64_t hits = w.solid[row] & bitSpan(b0, b1);
+        while (hits) {
+            int b = __builtin_ctzll(hits);
+            hits &= hits - 1;
+
+            float ux = w.x0 + b + 0.5f - cx, uy = dy;
+            float dist = sqrtf(ux * ux + uy * uy);
+            float signedDistance = dist - rc; // < 0, how deep the cell centre is inside
+            if (dist > 0) {
+                ux /= dist;
+                uy /= dist;
+            } else {
+                ux = 0;
+                uy = 1;
+            }
+
+            if ((w.loose[row] >> b) & 1 && ejectCell(&w, b, row, ux, uy, cx, cy, rc)) {
+                // the thrown cell leaves with the circle's speed along its direction
+                float vn = balls.vx[i] * ux + balls.vy[i] * uy;
+                if (vn > 0) {
+                    float share = CELL_MASS / (mass + CELL_MASS);
+                    balls.vx[i] -= ux * vn * share;
+                    balls.vy[i] -= uy * vn * share;
+                }
+                continue;
+            }
+
+            nx -= ux * -signedDistance;
+            ny -= uy * -signedDistance;
+            if (-signedDistance > depth) depth = -signedDistance;
+        }
+    }
+
+    float length = sqrtf(nx * nx + ny * ny);
+    if (length > 0) {
+        nx /= length;
+        ny /= length;
+        balls.x[i] += nx * depth * PIXEL_SIZE;
+        balls.y[i] += ny * depth * PIXEL_SIZE;
+
+        float vn = balls.vx[i] * nx + balls.vy[i] * ny;
+        if (vn < 0) {
+            balls.vx[i] -= (1.0f + GRID_RESTITUTION) * vn * nx;
+            balls.vy[i] -= (1.0f + GRID_RESTITUTION) * vn * ny;
+        }
+    }
+}
+
+// One frame of the circles: gravity, circle-circle contacts and screen edges, then the cells
+void updateBalls() {
+    stepCircleWorld(&balls, BALL_DT, BALL_SUBSTEPS, SCREEN_WIDTH, SCREEN_HEIGHT);
+    for (int i = 0; i < balls.awakeCount; i++) {
+        collideBallWithGrid(i);
+    }
+}
+
+void dropBall(int x, int y) {
+    float radius = BALL_MIN_RADIUS + rand() % (BALL_MAX_RADIUS - BALL_MIN_RADIUS + 1);
+    if (circleOverlapsAny(&balls, x, y, radius)) return;
+
+    CircleHandle handle = addCircle(&balls, x, y, 0, 0, radius * 1.5f, radius);
+    int i = circleIndex(&balls, handle);
+    if (i >= 0) {
+        SDL_Color colour = {200 + rand() % 56, 60 + rand() % 80, 40 + rand() % 40, 255};
+        ballColours[i] = colour;
+    }
+}
+
+void renderBalls() {
+    for (int i = 0; i < balls.count; i++) {
+        batchFilledCircle(&ballBatch, balls.x[i], balls.y[i], balls.r[i], ballColours[i]);
+    }
+    flushGeometryBatch(&ballBatch, gRenderer);
+}
+
+// Refills the light mask from the grid and the circles, gathers this frame's lights and relights
+// the cells. Fire adds one light per burning block, brighter the more of it burns.
+void updateLighting() {
+    clearSolidCells(&cellLighting);
+    for (int y = 0; y < GRID_HEIGHT; y++) {
+        for (int x = 0; x < GRID_WIDTH; x++) {
+            PixelType type = GRID[x][y].type;
+            if (type != SAND && type != WOOD) continue;
+            int run = x;
+            while (run + 1 < GRID_WIDTH && (GRID[run + 1][y].type == SAND || GRID[run + 1][y].type == WOOD)) run++;
+            setSolidSpan(&cellLighting, y, x, run);
+            x = run;
+        }
+    }
+    for (int i = 0; i < balls.count; i++) {
+        float cx = balls.x[i] / PIXEL_SIZE, cy = balls.y[i] / PIXEL_SIZE, rc = balls.r[i] / PIXEL_SIZE;
+        for (int y = (int)ceilf(cy - rc - 0.5f); y <= (int)floorf(cy + rc - 0.5f); y++) {
+            float dy = y + 0.5f - cy;
+            float half = sqrtf(fmaxf(rc * rc - dy * dy, 0));
+            setSolidSpan(&cellLighting, y, (int)ceilf(cx - half - 0.5f), (int)floorf(cx + half - 0.5f));
+        }
+    }
+
+    clearGridLights(&cellLighting);
+    for (int l = 0; l < placedLightCount; l++) {
+        addGridLight(&cellLighting, placedLights[l].x + 0.5f, placedLights[l].y + 0.5f, PLACED_LIGHT_RANGE, 255, 240, 200);
+    }
+    for (int by = 0; by < GRID_HEIGHT; by += FIRE_BLOCK) {
+        for (int bx = 0; bx < GRID_WIDTH; bx += FIRE_BLOCK) {
+            int burning = 0;
+            float sumX = 0, sumY = 0;
+            for (int x = bx; x < bx + FIRE_BLOCK && x < GRID_WIDTH; x++) {
+                for (int y = by; y < by + FIRE_BLOCK && y < GRID_HEIGHT; y++) {
+                    if (GRID[x][y].type != FIRE) continue;
+                    burning++;
+                    sumX += x + 0.5f;
+                    sumY += y + 0.5f;
+                }
+            }
+            if (burning == 0) continue;
+            float strength = fminf(1.0f, burning / (float)(FIRE_BLOCK * 2));
+            addGridLight(&cellLighting, sumX / burning, sumY / burning, FIRE_LIGHT_RANGE, 255 * strength, 130 * strength, 40 * strength);
+        }
+    }
+    computeGridLighting(&cellLighting, &lightPool);
+}
+
 // this function takes the position of the mouse, and the choice of substance and turns the area of 'dropperSize' into 
 // that substance before it is rendered or updated
 void instantiateSubstance(int x, int y, int dropperSize, int substanceMode) { 
@@ -970,9 +1211,17 @@ int main(int argc, char* args[]) {
     // Seed random number generator
     srand(time(NULL));
 
-    if (!init()) {
+    if (!init() || !initCircleWorld(&balls, 64) || !attachBodyArray(&balls, (void**)&ballColours, sizeof(SDL_Color))) {
         printf("Failed to initialize!\n");
     } else {
+        balls.restitution = 0.3f;
+        balls.friction = BALL_FRICTION;
+        balls.gravityY = BALL_GRAVITY;
+        initGeometryBatch(&ballBatch, 0.35f);
+        initThreadPool(&lightPool, 0);
+        if (initGridLighting(&cellLighting, gRenderer, GRID_WIDTH, GRID_HEIGHT)) {
+            cellLighting.ambient = SANDBOX_AMBIENT;
+        }
         if (!loadMedia()) {
             printf("Failed to load media!\n");
         } else {
@@ -982,7 +1231,7 @@ int main(int argc, char* args[]) {
             bool pressed = false;
             
             // text variables
-            int mode = 0; char modePresented[32], lastMode = -1; //which substance
+            int mode = 0; //which substance
             const Substance lookUpOfSubstances[] = {
                 {"Erase", {255, 255, 255, 255}}, // White for erase
                 {"Sand", {234, 225, 176, 255}}, // Sand color
@@ -999,7 +1248,17 @@ int main(int argc, char* args[]) {
                     if (event.type == SDL_QUIT) quit = 1;
                     if (event.type == SDL_KEYDOWN) {
                         if (event.key.keysym.sym == SDLK_ESCAPE) quit = 1;
-                        if (event.key.keysym.sym == SDLK_c) memcpy(GRID, EMPTY_GRID, sizeof(GRID));
+                        if (event.key.keysym.sym == SDLK_c) {
+                            memcpy(GRID, EMPTY_GRID, sizeof(GRID));
+                            while (balls.count > 0) removeCircle(&balls, circleHandle(&balls, balls.count - 1));
+                            placedLightCount = 0;
+                        }
+                        if (event.key.keysym.sym == SDLK_l) lightMode = !lightMode;
+                        if (event.key.keysym.sym == SDLK_b) {
+                            int mouseX, mouseY;
+                            SDL_GetMouseState(&mouseX, &mouseY);
+                            dropBall(mouseX, mouseY);
+                        }
 
                         // mode for which substance will be dropped
                         if (event.key.keysym.sym == SDLK_RIGHT && mode+1 <= 4) mode+=1;
@@ -1015,6 +1274,16 @@ int main(int argc, char* args[]) {
                         if (event.button.button == SDL_BUTTON_LEFT) {
                             pressed = true;
                         }
+                        // right click places a light, the oldest goes once there are too many
+                        if (event.button.button == SDL_BUTTON_RIGHT) {
+                            if (placedLightCount == MAX_PLACED_LIGHTS) {
+                                memmove(placedLights, placedLights + 1, sizeof(SDL_Point) * (MAX_PLACED_LIGHTS - 1));
+                                placedLightCount--;
+                            }
+                            placedLights[placedLightCount].x = event.button.x / PIXEL_SIZE;
+                            placedLights[placedLightCount].y = event.button.y / PIXEL_SIZE;
+                            placedLightCount++;
+                        }
                     }
 
                     if (event.type == SDL_MOUSEBUTTONUP) {
@@ -1031,13 +1300,8 @@ int main(int argc, char* args[]) {
                     instantiateSubstance(mouseX, mouseY, sizeOfDropping, mode);
 
                 }
-                // this chooses the mode and presents it
-                if (mode != lastMode)
-                {
-                    const Substance *currentSubstance = (mode >= 1 && mode <= 4) ? &lookUpOfSubstances[mode] : &lookUpOfSubstances[0];
-                    loadFromRenderedText(&modeTextTexture, currentSubstance->name, currentSubstance->color);
-                    lastMode = mode; 
-                }
+                // this chooses the mode that is presented
+                const Substance *currentSubstance = (mode >= 1 && mode <= 4) ? &lookUpOfSubstances[mode] : &lookUpOfSubstances[0];
 
 
                 // Clear screen with grey background color
@@ -1045,18 +1309,22 @@ int main(int argc, char* args[]) {
                 SDL_RenderClear(gRenderer);
 
 
-                sprintf(modePresented, "Dropper Size: %d", sizeOfDropping); 
-                loadFromRenderedText(&SizeOfDropperTexture, modePresented, textColor);
-
                 // Update physics
                 updatePhysics();
+                updateBalls();
 
                 // Render
                 render();
+                renderBalls();
+                if (lightMode) {
+                    updateLighting();
+                    drawGridLighting(&cellLighting, gRenderer, PIXEL_SIZE);
+                }
                 
                 //this is for text
-                renderTexture(&modeTextTexture, 0,0, NULL, 0, NULL, SDL_FLIP_NONE); 
-                renderTexture(&SizeOfDropperTexture, 0,20, NULL, 0, NULL, SDL_FLIP_NONE); 
+                batchText(&hudText, 0, 0, currentSubstance->name, currentSubstance->color);
+                batchTextFormat(&hudText, 0, 20, textColor, "Dropper Size: %d", sizeOfDropping);
+                flushGlyphAtlas(&hudText, gRenderer);
                 SDL_RenderPresent(gRenderer); // Update screen
 
                 // Optional: Add a small delay to control simulation speed
@@ -1065,6 +1333,10 @@ int main(int argc, char* args[]) {
             }
         }
     }
+    freeGridLighting(&cellLighting);
+    freeThreadPool(&lightPool);
+    freeGeometryBatch(&ballBatch);
+    freeCircleWorld(&balls);
     close();
     return 0;
 }
@@ -6,6 +6,8 @@
 #include <string.h>
 #include <stdbool.h>
 
+#include "geometryBatch.h"
+
 // Screen dimension constants
 const int SCREEN_WIDTH = 1400;
 const int SCREEN_HEIGHT = 750;
@@ -14,6 +16,7 @@ int stepperX = 300; //both of these are used for user input movement
 int stepperY = 300;
 int r = 0, g = 0, b = 0, checker = 0; //used for background 
 int shapeSize = 10; //used for the shape of the size. ex. for circle radius
+GeometryBatch shapeBatch; //shapes of a frame, drawn in one call
 
 
 // Texture wrapper structure to hold texture data and dimensions
@@ -36,58 +39,6 @@ int getTextureHeight(LTexture* lTexture); // Returns texture height
 bool moveRight = false, moveLeft = false, moveUp = false, moveDown = false, dash = false; //here add the movements
 
 
-//circle functions:
-
-void DrawCircle(SDL_Renderer* renderer, int32_t centreX, int32_t centreY, int32_t radius)
-{
-    const int32_t diameter = (radius * 2);
-
-    int32_t x = (radius - 1);
-    int32_t y = 0;
-    int32_t tx = 1;
-    int32_t ty = 1;
-    int32_t error = (tx - diameter);
-
-    while (x >= y)
-    {
-        // Each of the following renders an octant of the circle
-        SDL_RenderDrawPoint(renderer, centreX + x, centreY - y);
-        SDL_RenderDrawPoint(renderer, centreX + x, centreY + y);
-        SDL_RenderDrawPoint(renderer, centreX - x, centreY - y);
-        SDL_RenderDrawPoint(renderer, centreX - x, centreY + y);
-        SDL_RenderDrawPoint(renderer, centreX + y, centreY - x);
-        SDL_RenderDrawPoint(renderer, centreX + y, centreY + x);
-        SDL_RenderDrawPoint(renderer, centreX - y, centreY - x);
-        SDL_RenderDrawPoint(renderer, centreX - y, centreY + x);
-
-        if (error <= 0)
-        {
-            ++y;
-            error += ty;
-            ty += 2;
-        }
-
-        if (error > 0)
-        {
-            --x;
-            tx += 2;
-            error += (tx - diameter);
-        }
-    }
-}
-
-void DrawFilledCircle(SDL_Renderer* renderer, int centerX, int centerY, int radius) {
-    // Loop through the y-coordinates of the circle from the top to the bottom
-    for (int y = -radius; y <= radius; y++) {
-        // Calculate the width of each line at this y level (circle equation)
-        int dx = (int)sqrt(radius * radius - y * y); //maybe implement fast inverse square root?
-
-        // Draw a horizontal line for each row from left to right across the diameter
-        SDL_RenderDrawLine(renderer, centerX - dx, centerY + y, centerX + dx, centerY + y);
-    }
-}
-
-
 // Global variables for the SDL window, renderer, font, and text texture
 SDL_Window* gWindow = NULL;
 SDL_Renderer* gRenderer = NULL;
@@ -273,6 +224,7 @@ int main(int argc, char* args[]) {
         } else {
             int quit = 0; // Main loop flag
             SDL_Event e; // Event handler
+            initGeometryBatch(&shapeBatch, 0.35f); // circles stay within 0.35 pixels of their true edge
 
             while (!quit) {
                 while (SDL_PollEvent(&e) != 0) { // Handle events
@@ -414,9 +366,10 @@ int main(int argc, char* args[]) {
                 // SDL_RenderFillRect(gRenderer, &rect); // Draw filled rectangle
 
                 //circle
-                SDL_SetRenderDrawColor(gRenderer, 65, 107, 223, 255); // Set color (r, g, b, a)
-                DrawFilledCircle(gRenderer, stepperX, stepperY, shapeSize); //This will draw filled circle
-                // DrawCircle(gRenderer, stepperX, stepperY, 60); //This will draw a circle that isn't filled
+                SDL_Color circleColour = {65, 107, 223, 255}; // Set color (r, g, b, a)
+                batchFilledCircle(&shapeBatch, stepperX, stepperY, shapeSize, circleColour); //This will draw filled circle
+                // batchCircleOutline(&shapeBatch, stepperX, stepperY, 60, 1, circleColour); //This will draw a circle that isn't filled
+                flushGeometryBatch(&shapeBatch, gRenderer);
 
 
 
@@ -430,6 +383,7 @@ int main(int argc, char* args[]) {
             }
         }
     }
+    freeGeometryBatch(&shapeBatch);
     close(); // Free resources and close SDL
 
     return 0;
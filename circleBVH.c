@@ -0,0 +1,385 @@
+// Binned-SAH bounding-volume hierarchy over circles, refit every frame.
+
+#include "circleBVH.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define LEAF_SIZE 4       // circles a leaf holds when splitting further is not worth it
+#define MAX_LEAF_SIZE 16  // past this a node is split even when the heuristic says otherwise
+#define SAH_BINS 12       // candidate split planes per node
+#define MAX_DEPTH 48      // deeper nodes become leaves, so walks fit a fixed stack
+#define TRAVERSE_COST 1.0f // visiting a box, relative to testing one circle
+
+void initCircleBVH(CircleBVH* bvh, float rebuildRatio) {
+    memset(bvh, 0, sizeof(*bvh));
+    bvh->rebuildRatio = rebuildRatio;
+}
+
+void freeCircleBVH(CircleBVH* bvh) {
+    free(bvh->nodes);
+    free(bvh->order);
+    free(bvh->x);
+    free(bvh->y);
+    free(bvh->r);
+    memset(bvh, 0, sizeof(*bvh));
+}
+
+bool resizeCircleBVH(CircleBVH* bvh, int count) {
+    if (count > bvh->capacity) {
+        int capacity = bvh->capacity > 0 ? bvh->capacity : 64;
+        while (capacity < count) {
+            capacity *= 2;
+        }
+
+        void** arrays[] = {(void**)&bvh->order, (void**)&bvh->x, (void**)&bvh->y, (void**)&bvh->r};
+        size_t sizes[] = {sizeof(int), sizeof(float), sizeof(float), sizeof(float)};
+        for (int i = 0; i < 4; i++) {
+            void* grown = realloc(*arrays[i], sizes[i] * capacity);
+            if (grown == NULL) {
+                return false;
+            }
+            *arrays[i] = grown;
+        }
+
+        // a binary tree with one circle per leaf at worst has 2n - 1 nodes
+        BVHNode* nodes = realloc(bvh->nodes, sizeof(BVHNode) * 2 * capacity);
+        if (nodes == NULL) {
+            return false;
+        }
+        bvh->nodes = nodes;
+        bvh->nodeCapacity = 2 * capacity;
+        bvh->capacity = capacity;
+    }
+    bvh->count = count;
+    return true;
+}
+
+static float perimeter(float minX, float minY, float maxX, float maxY) {
+    return 2.0f * ((maxX - minX) + (maxY - minY));
+}
+
+static void fitLeaf(const CircleBVH* bvh, BVHNode* node) {
+    node->minX = node->minY = INFINITY;
+    node->maxX = node->maxY = -INFINITY;
+    for (int k = node->first; k < node->first + node->count; k++) {
+        int i = bvh->order[k];
+        node->minX = fminf(node->minX, bvh->x[i] - bvh->r[i]);
+        node->minY = fminf(node->minY, bvh->y[i] - bvh->r[i]);
+        node->maxX = fmaxf(node->maxX, bvh->x[i] + bvh->r[i]);
+        node->maxY = fmaxf(node->maxY, bvh->y[i] + bvh->r[i]);
+    }
+}
+
+// Splits the circles order[first, first + count) under node, or leaves them as a leaf
+static void buildNode(CircleBVH* bvh, int node, int first, int count, int depth) {
+    BVHNode* n = &bvh->nodes[node];
+    n->child = 0;
+    n->first = first;
+    n->count = count;
+    fitLeaf(bvh, n);
+    if (count <= LEAF_SIZE || depth >= MAX_DEPTH) {
+        return;
+    }
+
+    // bin the circles by centre along the longer side of their centres' bounds
+    float cMin[2] = {INFINITY, INFINITY}, cMax[2] = {-INFINITY, -INFINITY};
+    for (int k = first; k < first + count; k++) {
+        int i = bvh->order[k];
+        cMin[0] = fminf(cMin[0], bvh->x[i]);
+        cMax[0] = fmaxf(cMax[0], bvh->x[i]);
+        cMin[1] = fminf(cMin[1], bvh->y[i]);
+        cMax[1] = fmaxf(cMax[1], bvh->y[i]);
+    }
+    int axis = cMax[1] - cMin[1] > cMax[0] - cMin[0];
+    float extent = cMax[axis] - cMin[axis];
+    if (extent <= 0) {
+        return; // every centre in one spot, nothing separates them
+    }
+    const float* centre = axis == 0 ? bvh->x : bvh->y;
+    float scale = SAH_BINS / extent;
+
+    int binCount[SAH_BINS] = {0};
+    float binBox[SAH_BINS][4];
+    for (int b = 0; b < SAH_BINS; b++) {
+        binBox[b][0] = binBox[b][1] = INFINITY;
+        binBox[b][2] = binBox[b][3] = -INFINITY;
+    }
+    for (int k = first; k < first + count; k++) {
+        int i = bvh->order[k];
+        int b = (int)((centre[i] - cMin[axis]) * scale);
+        if (b >= SAH_BINS) b = SAH_BINS - 1;
+        binCount[b]++;
+        binBox[b][0] = fminf(binBox[b][0], bvh->x[i] - bvh->r[i]);
+        binBox[b][1] = fminf(binBox[b][1], bvh->y[i] - bvh->r[i]);
+        binBox[b][2] = fmaxf(binBox[b][2], bvh->x[i] + bvh->r[i]);
+        binBox[b][3] = fmaxf(binBox[b][3], bvh->y[i] + bvh->r[i]);
+    }
+
+    // sweep from the right to get the cost of everything past each plane, then from the left
+    float rightCost[SAH_BINS];
+    float box[4] = {INFINITY, INFINITY, -INFINITY, -INFINITY};
+    int right = 0;
+    for (int b = SAH_BINS - 1; b > 0; b--) {
+        right += binCount[b];
+        box[0] = fminf(box[0], binBox[b][0]);
+        box[1] = fminf(box[1], binBox[b][1]);
+        box[2] = fmaxf(box[2], binBox[b][2]);
+        box[3] = fmaxf(box[3], binBox[b][3]);
+        rightCost[b] = right > 0 ? perimeter(box[0], box[1], box[2], box[3]) * right : 0;
+    }
+
+    int bestPlane = -1;
+    float bestCost = INFINITY;
+    box[0] = box[1] = INFINITY;
+    box[2] = box[3] = -INFINITY;
+    int left = 0;
+    for (int b = 0; b < SAH_BINS - 1; b++) {
+        left += binCount[b];
+        box[0] = fminf(box[0], binBox[b][0]);
+        box[1] = fminf(box[1], binBox[b][1]);
+        box[2] = fmaxf(box[2], binBox[b][2]);
+        box[3] = fmaxf(box[3], binBox[b][3]);
+        if (left == 0 || left == count) {
+            continue;
+        }
+        float cost = perimeter(box[0], box[1], box[2], box[3]) * left + rightCost[b + 1];
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestPlane = b + 1;
+        }
+    }
+
+    float leafCost = perimeter(n->minX, n->minY, n->maxX, n->maxY) * count;
+    float splitCost = TRAVERSE_COST * perimeter(n->minX, n->minY, n->maxX, n->maxY) + bestCost;
+    if (bestPlane < 0 || (splitCost >= leafCost && count <= MAX_LEAF_SIZE)) {
+        return;
+    }
+
+    // partition the circles so the ones left of the plane come first
+    int* order = bvh->order;
+    int lo = first, hi = first + count - 1;
+    while (lo <= hi) {
+        int b = (int)((centre[order[lo]] - cMin[axis]) * scale);
+        if (b >= SAH_BINS) b = SAH_BINS - 1;
+        if (b < bestPlane) {
+            lo++;
+        } else {
+            int swap = order[lo];
+            order[lo] = order[hi];
+            order[hi] = swap;
+            hi--;
+        }
+    }
+    int leftCount = lo - first;
+
+    int child = bvh->nodeCount;
+    bvh->nodeCount += 2;
+    n->child = child;
+    n->count = 0;
+    buildNode(bvh, child, first, leftCount, depth + 1);
+    buildNode(bvh, child + 1, first + leftCount, count - leftCount, depth + 1);
+}
+
+// Refits every box bottom-up and returns the walk cost of the tree: the perimeter of each box
+// relative to the root's, times what is done on entering it
+static float refit(CircleBVH* bvh) {
+    float cost = 0;
+    // children always come after their parent
+    for (int k = bvh->nodeCount - 1; k >= 0; k--) {
+        BVHNode* n = &bvh->nodes[k];
+        if (n->child == 0) {
+            fitLeaf(bvh, n);
+            cost += perimeter(n->minX, n->minY, n->maxX, n->maxY) * n->count;
+        } else {
+            BVHNode* a = &bvh->nodes[n->child];
+            BVHNode* b = &bvh->nodes[n->child + 1];
+            n->minX = fminf(a->minX, b->minX);
+            n->minY = fminf(a->minY, b->minY);
+            n->maxX = fmaxf(a->maxX, b->maxX);
+            n->maxY = fmaxf(a->maxY, b->maxY);
+            cost += perimeter(n->minX, n->minY, n->maxX, n->maxY) * TRAVERSE_COST;
+        }
+    }
+    BVHNode* root = &bvh->nodes[0];
+    float rootPerimeter = perimeter(root->minX, root->minY, root->maxX, root->maxY);
+    return rootPerimeter > 0 ? cost / rootPerimeter : 0;
+}
+
+bool updateCircleBVH(CircleBVH* bvh) {
+    if (bvh->count == 0) {
+        bvh->nodeCount = 0;
+        bvh->builtCount = 0;
+        return true;
+    }
+
+    if (bvh->count == bvh->builtCount && bvh->nodeCount > 0) {
+        bvh->cost = refit(bvh);
+        if (bvh->cost <= bvh->builtCost * bvh->rebuildRatio) {
+            return true;
+        }
+    }
+
+    for (int i = 0; i < bvh->count; i++) {
+        bvh->order[i] = i;
+    }
+    bvh->nodeCount = 1;
+    buildNode(bvh, 0, 0, bvh->count, 0);
+    bvh->cost = bvh->builtCost = refit(bvh);
+    bvh->builtCount = bvh->count;
+    bvh->rebuilds++;
+    return true;
+}
+
+// Entry t of the ray into a box, INFINITY when it misses or enters past tMax
+static float enterBox(const BVHNode* n, float ox, float oy, float invX, float invY, float tMax) {
+    float tx0 = (n->minX - ox) * invX, tx1 = (n->maxX - ox) * invX;
+    float ty0 = (n->minY - oy) * invY, ty1 = (n->maxY - oy) * invY;
+    float tNear = fmaxf(fmaxf(fminf(tx0, tx1), fminf(ty0, ty1)), 0.0f);
+    float tFar = fminf(fminf(fmaxf(tx0, tx1), fmaxf(ty0, ty1)), tMax);
+    return tNear <= tFar ? tNear : INFINITY;
+}
+
+int rayCastCircleBVH(const CircleBVH* bvh, float ox, float oy, float dx, float dy, float tMax, float* t) {
+    if (bvh->nodeCount == 0) {
+        return -1;
+    }
+    float invX = 1.0f / dx, invY = 1.0f / dy;
+    float A = dx * dx + dy * dy;
+    if (A <= 0) {
+        return -1;
+    }
+
+    int hit = -1;
+    float best = tMax;
+    int stack[MAX_DEPTH + 2];
+    int top = 0;
+    if (enterBox(&bvh->nodes[0], ox, oy, invX, invY, best) == INFINITY) {
+        return -1;
+    }
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const BVHNode* n = &bvh->nodes[stack[--top]];
+        if (n->child == 0) {
+            for (int k = n->first; k < n->first + n->count; k++) {
+                int i = bvh->order[k];
+                float fx = ox - bvh->x[i], fy = oy - bvh->y[i];
+                float B = 2 * (dx * fx + dy * fy);
+                float C = fx * fx + fy * fy - bvh->r[i] * bvh->r[i];
+                float discriminant = B * B - 4 * A * C;
+                if (discriminant < 0) {
+                    continue;
+                }
+                float root = sqrtf(discriminant);
+                float tHit = (-B - root) / (2 * A);
+                if (tHit < 0) {
+                    tHit = (-B + root) / (2 * A); // starts inside, leaves through the far side
+                }
+                if (tHit >= 0 && tHit <= best) {
+                    best = tHit;
+                    hit = i;
+                }
+            }
+            continue;
+        }
+
+        // push the farther child first so the nearer one is walked first and shrinks best
+        int a = n->child, b = n->child + 1;
+        float ta = enterBox(&bvh->nodes[a], ox, oy, invX, invY, best);
+        float tb = enterBox(&bvh->nodes[b], ox, oy, invX, invY, best);
+        if (ta > tb) {
+            int swapIndex = a;
+            a = b;
+            b = swapIndex;
+            float swapT = ta;
+            ta = tb;
+            tb = swapT;
+        }
+        if (tb != INFINITY) {
+            stack[top++] = b;
+        }
+        if (ta != INFINITY) {
+            stack[top++] = a;
+        }
+    }
+
+    if (hit >= 0) {
+        *t = best;
+    }
+    return hit;
+}
+
+void rayCastCircleBVHPacket(const CircleBVH* bvh, RayPacket* packet) {
+    if (bvh->nodeCount == 0 || boxPacketMask(packet, bvh->nodes[0].minX, bvh->nodes[0].minY,
+                                             bvh->nodes[0].maxX, bvh->nodes[0].maxY) == 0) {
+        return;
+    }
+    int stack[MAX_DEPTH + 2];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const BVHNode* n = &bvh->nodes[stack[--top]];
+        if (n->child == 0) {
+            for (int k = n->first; k < n->first + n->count; k++) {
+                int i = bvh->order[k];
+                intersectCirclePacket(packet, bvh->x[i], bvh->y[i], bvh->r[i], i);
+            }
+            continue;
+        }
+
+        // a box no ray of the packet still reaches is skipped; of the two children the one whose
+        // centre is nearer the first ray's origin is walked first
+        int a = n->child, b = n->child + 1;
+        const BVHNode* na = &bvh->nodes[a];
+        const BVHNode* nb = &bvh->nodes[b];
+        float ax = (na->minX + na->maxX) * 0.5f - packet->ox[0], ay = (na->minY + na->maxY) * 0.5f - packet->oy[0];
+        float bx = (nb->minX + nb->maxX) * 0.5f - packet->ox[0], by = (nb->minY + nb->maxY) * 0.5f - packet->oy[0];
+        if (ax * ax + ay * ay > bx * bx + by * by) {
+            int swapIndex = a;
+            a = b;
+            b = swapIndex;
+            const BVHNode* swapNode = na;
+            na = nb;
+            nb = swapNode;
+        }
+        if (boxPacketMask(packet, nb->minX, nb->minY, nb->maxX, nb->maxY)) {
+            stack[top++] = b;
+        }
+        if (boxPacketMask(packet, na->minX, na->minY, na->maxX, na->maxY)) {
+            stack[top++] = a;
+        }
+    }
+}
+
+int overlapCircleBVH(const CircleBVH* bvh, float minX, float minY, float maxX, float maxY, int* out, int maxOut) {
+    if (bvh->nodeCount == 0) {
+        return 0;
+    }
+    int found = 0;
+    int stack[MAX_DEPTH + 2];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const BVHNode* n = &bvh->nodes[stack[--top]];
+        if (n->minX > maxX || n->maxX < minX || n->minY > maxY || n->maxY < minY) {
+            continue;
+        }
+        if (n->child != 0) {
+            stack[top++] = n->child;
+            stack[top++] = n->child + 1;
+            continue;
+        }
+        for (int k = n->first; k < n->first + n->count && found < maxOut; k++) {
+            int i = bvh->order[k];
+            if (bvh->x[i] - bvh->r[i] <= maxX && bvh->x[i] + bvh->r[i] >= minX &&
+                bvh->y[i] - bvh->r[i] <= maxY && bvh->y[i] + bvh->r[i] >= minY) {
+                out[found++] = i;
+            }
+        }
+    }
+    return found;
+}
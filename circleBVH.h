@@ -0,0 +1,60 @@
+#ifndef CIRCLE_BVH_H
+#define CIRCLE_BVH_H
+
+#include <stdbool.h>
+
+#include "rayPacket.h"
+
+// One box of the hierarchy. Children are stored next to each other, the right one at child + 1.
+typedef struct {
+    float minX, minY, maxX, maxY;
+    int child; // first child of an inner node, 0 for leaves (the root is never a child)
+    int first; // leaves: circles order[first] .. order[first + count - 1]
+    int count;
+} BVHNode;
+
+// Bounding-volume hierarchy over circles for ray and overlap queries. The caller writes the
+// circles into x, y and r every frame and calls updateCircleBVH: the boxes are refit to where
+// the circles moved, and the tree is rebuilt from scratch with the surface area heuristic
+// once refitting has made it more than rebuildRatio times as costly to walk as when it was built.
+typedef struct {
+    BVHNode* nodes;
+    int nodeCount;
+    int nodeCapacity;
+    int* order;  // circle indices grouped by leaf
+
+    float* x;    // circles, by index, written by the caller
+    float* y;
+    float* r;
+    int count;
+    int capacity;
+
+    float rebuildRatio;
+    float builtCost;   // expected walk cost right after the last rebuild, 0 before the first
+    float cost;        // the same after the last refit
+    int builtCount;    // circles in the tree at the last rebuild
+    int rebuilds;      // counted since init, to see how often refitting is not enough
+} CircleBVH;
+
+void initCircleBVH(CircleBVH* bvh, float rebuildRatio);
+void freeCircleBVH(CircleBVH* bvh);
+
+// Makes room for count circles and sets bvh->count, false when out of memory. The circles
+// themselves are then written to x, y and r.
+bool resizeCircleBVH(CircleBVH* bvh, int count);
+
+// Refits or rebuilds the tree after the circles changed. False when out of memory.
+bool updateCircleBVH(CircleBVH* bvh);
+
+// Closest circle along the ray (ox, oy) + t * (dx, dy) with 0 <= t <= tMax, or -1 when there is
+// none. A ray starting inside a circle hits it where it leaves. *t is set on a hit.
+int rayCastCircleBVH(const CircleBVH* bvh, float ox, float oy, float dx, float dy, float tMax, float* t);
+
+// The same for eight rays at once: lowers packet->t and sets packet->hit to the circle index
+// for every lane that meets a circle before its current t
+void rayCastCircleBVHPacket(const CircleBVH* bvh, RayPacket* packet);
+
+// Writes up to maxOut circles whose bounding boxes touch the box to out, returns how many were written
+int overlapCircleBVH(const CircleBVH* bvh, float minX, float minY, float maxX, float maxY, int* out, int maxOut);
+
+#endif
@@ -1,4 +1,4 @@
-// gcc -O3 -I src/include -L src/lib -o main circlePhysics.c -lmingw32 -lSDL2main -lSDL2 -lSDL2_ttf -lSDL2_image -lSDL2_mixer -mwindows
+// gcc -O3 -mavx2 -I src/include -L src/lib -o main circlePhysics.c circleWorld.c threadPool.c fixedTimestep.c poissonDisk.c gravityTree.c geometryBatch.c arcTessellator.c glyphAtlas.c -lmingw32 -lSDL2main -lSDL2 -lSDL2_ttf -lSDL2_image -lSDL2_mixer -mwindows
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
@@ -9,13 +9,38 @@
 #include <stdbool.h>
 #include <time.h>
 #include <math.h>
+#include <limits.h>
+
+#include "circleWorld.h"
+#include "fixedTimestep.h"
+#include "poissonDisk.h"
+#include "gravityTree.h"
+#include "geometryBatch.h"
+#include "glyphAtlas.h"
 
 // Screen dimension constants
 // the size of the screen
 #define SCREEN_WIDTH 1392
 #define SCREEN_HEIGHT 744
 
-#define MAX_BALLS 1000
+#define MAX_BALLS 1000 // starting capacity, the world grows when it fills up
+#define STRESS_BATCH 1000 // circles added/removed per key press with B and X
+#define FILL_MIN_RADIUS 1.0f // F fills the screen with circles this size, about 100k of them
+#define FILL_MAX_RADIUS 2.0f
+
+#define PHYSICS_THREADS 0 // worker threads for the solver, 0 = one per extra CPU core
+#define SOLVER_ITERATIONS 4 // velocity iterations per substep
+#define POSITION_ITERATIONS 4 // most overlap correction passes per substep, fewer once the pile is resolved
+#define PHYSICS_HZ 60 // fixed physics steps per second
+#define PHYSICS_SUBSTEPS 2 // contact passes per physics step
+#define CCD_FRACTION 1.0f // bodies moving more than this fraction of their radius per substep are swept
+#define LINEAR_DAMPING 0.18f // velocity lost per second, what the old 30% chance of * 0.99 per step averaged to
+#define SLEEP_VELOCITY 6.0f // bodies slower than this (pixels per second) count as resting
+#define SLEEP_STEPS 30 // physics steps an island must rest before it sleeps
+#define GRAVITY_CONSTANT 2000.0f // G toggles mutual attraction, in pixels^3 / (mass * second^2)
+#define GRAVITY_THETA 0.6f // Barnes-Hut opening angle, lower is more exact and slower
+#define GRAVITY_SOFTENING 5.0f // pixels, keeps close passes from slingshotting
+#define CIRCLE_MAX_ERROR 0.35f // pixels a circle's polygon may fall short of the true edge
 
 // Struct for storing circle data
 typedef struct {
@@ -29,16 +54,13 @@ typedef struct {
     int a; // Alpha component
 } Color;
 
-typedef struct {
-    Vector2 position;        // Position
-    Vector2 velocity;      // Velocity
-    float mass; // mass
-    float radius;      // Radius
-    Color colour;
-} Circle;
-
-Circle circles[MAX_BALLS]; // Declare the array
-int DYNAMIC_CIRCLES = 1;
+CircleWorld world; // body state (positions, velocities, masses, radii)
+ThreadPool physicsPool; // workers shared by the contact solver and integration
+GravityTree gravity; // quadtree for the N-body mode
+GeometryBatch circleBatch; // every circle of a frame, drawn in one call
+bool gravityMode = false;
+Color* circleColours = NULL; // render-only data, attached to the world so it follows its body
+int DYNAMIC_CIRCLES = 1; // number of circles spawned at startup
 
 const Color colors[] = {
     // Earthy Browns and Greens
@@ -64,14 +86,14 @@ const Color colors[] = {
 };
 
 float mouseVX, mouseVY;
-float deltaTime = 1.0f / 60.0f; // Assume a frame rate of 60 FPS (adjust if variable)
+float deltaTime = 1.0f / 60.0f; // real length of the last frame, measured by the fixed timestep
 
 // Global or persistent variables to store mouse positions
 int previousMouseX = 0, previousMouseY = 0;
 
 
 
-SDL_Color textColor = {0, 0, 0}; // text color
+SDL_Color textColor = {0, 0, 0, 255}; // text color, opaque since it tints the glyph atlas
 
 // Texture wrapper structure to hold texture data and dimensions
 typedef struct {
@@ -82,7 +104,7 @@ typedef struct {
  
 // Function declarations for initialization, media loading, cleanup, and texture operations
 bool init(); // Initializes SDL, window, and renderer
-bool loadMedia(); // Loads media (e.g., font and text)
+bool loadMedia(); // Loads media (e.g., font and glyph atlas)
 void close(); // Frees resources and shuts down SDL
 bool loadFromFile(LTexture* lTexture, const char* path); // Loads image from file into texture
 bool loadFromRenderedText(LTexture* lTexture, const char* textureText, SDL_Color textColor); // Renders text as texture
@@ -95,7 +117,7 @@ int getTextureHeight(LTexture* lTexture); // Returns texture height
 SDL_Window* gWindow = NULL;
 SDL_Renderer* gRenderer = NULL;
 TTF_Font* gFont = NULL;
-LTexture gTextTexture; // Texture to display text
+GlyphAtlas hudText; // the font's glyphs, rendered once, so the ball count is redrawn each frame without SDL_ttf
 
 // Initializes SDL, creates window and renderer, sets up image and text libraries
 bool init() {
@@ -154,9 +176,9 @@ bool loadMedia() {
         success = false;
     } else {
 
-        // Render the text to create a texture
-        if (!loadFromRenderedText(&gTextTexture, " ", textColor)) {
-            printf("Failed to render text texture!\n");
+        // Render every glyph once into the atlas the HUD text is drawn from
+        if (!initGlyphAtlas(&hudText, gRenderer, gFont)) {
+            printf("Failed to build glyph atlas!\n");
             success = false;
         }
     }
@@ -165,7 +187,7 @@ bool loadMedia() {
 
 // Frees up resources and shuts down SDL libraries
 void close() {
-    freeTexture(&gTextTexture); // Free text texture
+    freeGlyphAtlas(&hudText); // Free glyph atlas
 
     TTF_CloseFont(gFont); // Close font
     gFont = NULL;
@@ -263,18 +285,6 @@ int getTextureHeight(LTexture* lTexture) {
     return lTexture->height;
 }
 
-// circle functions:
-void DrawFilledCircle(SDL_Renderer* renderer, int centerX, int centerY, float radius) {
-    // Loop through the vertical positions (y-coordinates) of the circle from the top to the bottom
-    for (int y = -radius; y <= radius; y++) {
-        // Calculate the horizontal distance (half-width) at this y-level using the circle equation
-        int dx = (int)sqrt(radius * radius - y * y);  // Could use a faster square root approximation
-
-        // Draw a horizontal line across the diameter of the circle at the current y-level
-        SDL_RenderDrawLine(renderer, centerX - dx, centerY + y, centerX + dx, centerY + y);
-    }
-}
-
 // Add two vectors
 Vector2 addVectors(Vector2 v1, Vector2 v2) {
     Vector2 result = {
@@ -333,106 +343,81 @@ Vector2 setMagnitude(Vector2 v, float newMag) {
 
 
 
-void resolveCollision(Circle* b1, Circle* b2) {
-
-    // this is the distance between the center of the 2 balls
-    float dx = b2->position.x - b1->position.x;
-    float dy = b2->position.y - b1->position.y;
-    float dist = sqrt(dx * dx + dy * dy);
-
-    // Check if the circles are colliding (i.e., distance is less than sum of radii)
-    if (dist <= b1->radius + b2->radius) {
-
-        // Calculate mass terms
-        float totalMass = b1->mass + b2->mass;
-
-        // save the actual velocities
-        Vector2 SavedvelocityB1 = b1->velocity;
-        Vector2 SavedvelocityB2 = b2->velocity;
-
-        // numerator ball1
-        float numeratorB1 = (2.0f * b2->mass) * (  dotProduct(  subtractVectors(b2->velocity,b1->velocity)  , subtractVectors(b2->position,b1->position) )  );
-        // numerator ball2
-        float numeratorB2 = (2.0f * b1->mass) * (  dotProduct(  subtractVectors(b1->velocity,b2->velocity)  , subtractVectors(b1->position,b2->position) )  );
+// Adds up to count circles spread over the params region without overlapping each other,
+// returns how many were added
+int spawnPoissonCircles(PoissonDiskParams* params, int count) {
+    int capacity = maxDiskCount(params);
+    DiskSample* samples = malloc(sizeof(DiskSample) * capacity);
+    if (samples == NULL) return 0;
 
+    // fill the whole region, then keep a random subset so a few circles are not all in one clump
+    params->seed = rand();
+    int placed = poissonDiskFill(params, samples, capacity);
+    shuffleDiskSamples(samples, placed, params->seed);
+    if (placed > count) placed = count;
 
+    int first = placed > 0 ? reserveCircles(&world, placed) : -1;
+    if (first < 0) {
+        free(samples);
+        return 0;
+    }
 
-        // denomenator
-        float denomenator = totalMass * dist * dist; 
+    for (int k = 0; k < placed; k++) {
+        int i = first + k;
+        world.x[i] = samples[k].x;
+        world.y[i] = samples[k].y;
 
-        // ball1
-        b1->velocity = addVectors(SavedvelocityB1 , scaleVector( subtractVectors(b2->position , b1->position) ,  numeratorB1 / denomenator));
-        // ball2
-        b2->velocity = addVectors(SavedvelocityB2 , scaleVector( subtractVectors(b1->position , b2->position) ,  numeratorB2 / denomenator));
+        // Random velocity components (from -2 to 2 pixels per 60Hz tick)
+        world.vx[i] = ((rand() % 5) - 2) * 60.0f;
+        world.vy[i] = ((rand() % 5) - 2) * 60.0f;
 
+        // Mass proportional to radius (scaling factor: 1.5 for example)
+        world.invMass[i] = 1.0f / (samples[k].r * 1.5f);
+        world.r[i] = samples[k].r;
+        circleColours[i] = colors[rand() % 15];
     }
-}
 
-bool checkOverlap(Circle* b1, Circle* b2){
-    float dx = b2->position.x - b1->position.x;
-    float dy = b2->position.y - b1->position.y;
-    float dist = sqrt(dx * dx + dy * dy);
-    return dist <= (b1->radius + b2->radius);
+    free(samples);
+    return placed;
 }
 
 void InitializeCircles() {
     srand(time(NULL)); // Seed random number generator
 
-    for (int i = 0; i < DYNAMIC_CIRCLES; i++) {
-        int randColor = rand() % 15;
-        // Random position within screen bounds (adjust based on your screen size)
-        circles[i].position.x = rand() % (SCREEN_WIDTH - 100) + 50; // Keep circles away from edges
-        circles[i].position.y = rand() % (SCREEN_HEIGHT - 100) + 50;
-
-        // Random velocity components (from -5 to 5, but non-zero)
-        circles[i].velocity.x = (rand() % 5) - 2; // -5 to 5
-        circles[i].velocity.y = (rand() % 5) - 2;
-
-        // Random radius (10 to 50)
-        circles[i].radius = rand() % 11 + 10; // 10 to 50
-
-        // Mass proportional to radius (scaling factor: 1.5 for example)
-        circles[i].mass = circles[i].radius * 1.5;
+    // Random radius (10 to 20), kept away from the screen edges
+    PoissonDiskParams params = {50, 50, SCREEN_WIDTH - 50, SCREEN_HEIGHT - 50, 10, 20, 0, 0, 0};
+    spawnPoissonCircles(&params, DYNAMIC_CIRCLES);
+}
 
-        // Mass proportional to radius (scaling factor: 1.5 for example)
-        circles[i].colour = colors[randColor]; 
-
-        for (int j = 0; j < i; j++)
-        {
-            if (checkOverlap(&circles[i], &circles[j]))
-            {
-                i--; 
-                break; 
-            }
+// Spawns count small circles around (x, y) in one reservation
+void spawnBurst(int count, int x, int y) {
+    PoissonDiskParams params = {fmaxf(x - 100, 0), fmaxf(y - 100, 0), fminf(x + 100, SCREEN_WIDTH), fminf(y + 100, SCREEN_HEIGHT), 3, 6, 0, 0, 0};
+    spawnPoissonCircles(&params, count);
+}
 
-            
-        }
-        
-        
+// Replaces every circle with as many tiny ones as fit on the screen
+void fillScreen() {
+    while (world.count > 0) {
+        removeCircle(&world, circleHandle(&world, world.count - 1));
     }
+    PoissonDiskParams params = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, FILL_MIN_RADIUS, FILL_MAX_RADIUS, 0, 0, 0};
+    spawnPoissonCircles(&params, INT_MAX);
 }
 
+// Switches the N-body mode on or off. Bodies keep falling towards each other, so they are
+// kept awake while it is on.
+void toggleGravity() {
+    gravityMode = !gravityMode;
+    world.sleepSteps = gravityMode ? 0 : SLEEP_STEPS;
+    while (world.awakeCount < world.count) {
+        wakeCircle(&world, circleHandle(&world, world.awakeCount));
+    }
+}
 
-void correctPositions() {
-    for (int i = 0; i < DYNAMIC_CIRCLES; i++) {
-        for (int j = i + 1; j < DYNAMIC_CIRCLES; j++) {
-            if (checkOverlap(&circles[i], &circles[j])) {
-                float dx = circles[j].position.x - circles[i].position.x;
-                float dy = circles[j].position.y - circles[i].position.y;
-                float dist = sqrt(dx * dx + dy * dy);
-                float overlap = (circles[i].radius + circles[j].radius) - dist;
-
-                if (dist > 0) { // Avoid divide by zero
-                    float moveX = (dx / dist) * (overlap / 2);
-                    float moveY = (dy / dist) * (overlap / 2);
-
-                    circles[i].position.x -= moveX;
-                    circles[i].position.y -= moveY;
-                    circles[j].position.x += moveX;
-                    circles[j].position.y += moveY;
-                }
-            }
-        }
+// Removes up to count random circles
+void removeRandomCircles(int count) {
+    for (int i = 0; i < count && world.count > 0; i++) {
+        removeCircle(&world, circleHandle(&world, rand() % world.count));
     }
 }
 
@@ -450,68 +435,47 @@ void updateMouseVelocity(float* mouseVX, float* mouseVY, float deltaTime , int c
 
 
 void handleMouseCollision(int mouseX, int mouseY, float mouseVX, float mouseVY) {
-    Circle mouseCircle;
-    // Center the mouse circle properly
-    mouseCircle.position.x = mouseX;
-    mouseCircle.position.y = mouseY;
-    
-    // Adjust velocity scaling based on testing
-    const float velocityScale = 0.05f;  // Adjusted from 0.01
-    mouseCircle.velocity.x = mouseVX * velocityScale;
-    mouseCircle.velocity.y = mouseVY * velocityScale;
-    
-    // Make radius and mass more reasonable
-    mouseCircle.radius = 5.0f;  // Smaller radius for more precise collisions
-    mouseCircle.mass = 20.0f;   // Adjusted mass for better collision response
-    
+    // Adjust velocity scaling based on testing (0.05 pixels per tick per pixel per second)
+    const float velocityScale = 3.0f;
+    float probeVX = mouseVX * velocityScale;
+    float probeVY = mouseVY * velocityScale;
+
     // Add some minimum velocity threshold to prevent tiny movements
-    const float minVelocity = 0.1f;
-    if (fabsf(mouseCircle.velocity.x) < minVelocity && fabsf(mouseCircle.velocity.y) < minVelocity) {
+    const float minVelocity = 6.0f; // pixels per second
+    if (fabsf(probeVX) < minVelocity && fabsf(probeVY) < minVelocity) {
         return;
     }
 
-    for (int i = 0; i < DYNAMIC_CIRCLES; i++) {
-        if (checkOverlap(&mouseCircle, &circles[i])) {
-            resolveCollision(&mouseCircle, &circles[i]);
-            
-            // Add minimum velocity after collision to prevent sticking
-            const float minPostCollisionVel = 0.5f;
-            if (fabsf(circles[i].velocity.x) < minPostCollisionVel) {
-                circles[i].velocity.x *= minPostCollisionVel / fabsf(circles[i].velocity.x);
-            }
-            if (fabsf(circles[i].velocity.y) < minPostCollisionVel) {
-                circles[i].velocity.y *= minPostCollisionVel / fabsf(circles[i].velocity.y);
-            }
-        }
-    }
-}
-
-void applyDampening(float *xVel, float *yVel){
-
-    if (rand() % 100 < 30)
-    {
-        *xVel *= 0.99;
-        *yVel *= 0.99;
-
-    }
-    
-
-
+    // The mouse acts as a small heavy circle (radius 5, mass 20). A flick can launch a ball
+    // several radii per substep, integrateCircles sweeps those so they cannot skip past others.
+    collideProbe(&world, mouseX, mouseY, probeVX, probeVY, 20.0f, 5.0f);
 }
 
-
 // Main function - sets up SDL, loads media, runs main loop, and cleans up
 int main(int argc, char* args[]) {
-    if (!init()) { // Initialize SDL and create window
+    if (!init() || !initCircleWorld(&world, MAX_BALLS) || !attachBodyArray(&world, (void**)&circleColours, sizeof(Color)) ||
+        !initThreadPool(&physicsPool, PHYSICS_THREADS)) { // Initialize SDL and create window
         printf("Failed to initialize!\n");
     } else {
+        world.pool = &physicsPool;
+        world.solverIterations = SOLVER_ITERATIONS;
+        world.positionIterations = POSITION_ITERATIONS;
+        world.ccdFraction = CCD_FRACTION;
+        world.linearDamping = LINEAR_DAMPING;
+        world.sleepVelocity = SLEEP_VELOCITY;
+        world.sleepSteps = SLEEP_STEPS;
+        initGravityTree(&gravity, GRAVITY_CONSTANT, GRAVITY_THETA, GRAVITY_SOFTENING);
+        initGeometryBatch(&circleBatch, CIRCLE_MAX_ERROR);
+
         if (!loadMedia()) { // Load media (text textures, fonts)
             printf("Failed to load media!\n");
         } else {
             int quit = 0; // Main loop flag
             SDL_Event e; // Event handler
             InitializeCircles();
-            char ballNum[32];
+
+            FixedTimestep step;
+            initFixedTimestep(&step, 1.0 / PHYSICS_HZ, PHYSICS_SUBSTEPS);
 
             bool pressed = false; 
 
@@ -534,6 +498,12 @@ int main(int argc, char* args[]) {
                         if (e.key.keysym.sym == SDLK_ESCAPE) {
                             quit = 1; // Exit on pressing the escape key
                         }
+
+                        // stress controls, hold to repeat
+                        if (e.key.keysym.sym == SDLK_b) spawnBurst(STRESS_BATCH, mouseX, mouseY);
+                        if (e.key.keysym.sym == SDLK_x) removeRandomCircles(STRESS_BATCH);
+                        if (e.key.keysym.sym == SDLK_f) fillScreen();
+                        if (e.key.keysym.sym == SDLK_g) toggleGravity();
                     }
 
 
@@ -546,18 +516,13 @@ int main(int argc, char* args[]) {
 
                             int randColor = rand() % 15;
 
-                            // Create a new circle
-                            Circle newCircle;
-                            newCircle.position.x = mouseX;
-                            newCircle.position.y = mouseY;
-                            newCircle.velocity.x = (rand() % 5) - 2; // Random velocity
-                            newCircle.velocity.y = (rand() % 5) - 2;
-                            newCircle.radius = rand() % 11 + 10;     // Random radius
-                            newCircle.mass = newCircle.radius * 1.5; // Mass proportional to radius
-                            newCircle.colour = colors[randColor];
-
-                            // Add the circle to the array
-                            circles[DYNAMIC_CIRCLES++] = newCircle;                        
+                            // Create a new circle with a random velocity, mass proportional to radius
+                            float radius = rand() % 11 + 10;
+                            CircleHandle handle = addCircle(&world, mouseX, mouseY, ((rand() % 5) - 2) * 60.0f, ((rand() % 5) - 2) * 60.0f, radius * 1.5f, radius);
+                            int index = circleIndex(&world, handle);
+                            if (index >= 0) {
+                                circleColours[index] = colors[randColor];
+                            }
                         }
 
                         if (e.button.button == SDL_BUTTON_LEFT) pressed = true;
@@ -589,72 +554,39 @@ int main(int argc, char* args[]) {
 
 
 
-                for (int i = 0; i < DYNAMIC_CIRCLES; i++) {
-                    for (int j = i + 1; j < DYNAMIC_CIRCLES; j++) {
-
-                        resolveCollision(&circles[i], &circles[j]);
-                    }
-                } 
-
-                correctPositions();
-
-
-
+                // measure the frame and run as many fixed physics steps as it covers
+                int steps = beginFrame(&step);
+                if (step.frameTime > 0) deltaTime = step.frameTime;
                 updateMouseVelocity(&mouseVX, &mouseVY, deltaTime, mouseX, mouseY);
 
+                for (int s = 0; s < steps; s++) {
+                    if (gravityMode) applyGravity(&gravity, &world, step.fixedDt);
+                    stepCircleWorld(&world, step.fixedDt, step.substeps, SCREEN_WIDTH, SCREEN_HEIGHT);
+                }
 
-                // Update and draw each circle
-                for (int i = 0; i < DYNAMIC_CIRCLES; i++) {
-                    // Update position based on velocity
-                    circles[i].position.x += circles[i].velocity.x;
-                    circles[i].position.y += circles[i].velocity.y;
-
-                    // Handle boundaries
-                    // right
-                    if (circles[i].position.x >= SCREEN_WIDTH - circles[i].radius) {
-                        circles[i].velocity.x *= -1;
-                        circles[i].position.x = SCREEN_WIDTH - circles[i].radius; 
- 
-                    }
-                    // left
-                    else if (circles[i].position.x <= circles[i].radius)
-                    {
-                        circles[i].velocity.x *= -1;
-                        circles[i].position.x = circles[i].radius; 
-                    }
-                    // bottom
-                    else if (circles[i].position.y >= SCREEN_HEIGHT - circles[i].radius) { 
-                        circles[i].velocity.y *= -1;
-                        circles[i].position.y = SCREEN_HEIGHT - circles[i].radius; 
-
-                    }
-                    // top
-                    else if (circles[i].position.y <= circles[i].radius)
-                    {
-                        circles[i].velocity.y *= -1;
-                        circles[i].position.y = circles[i].radius; 
- 
-                    }
+                // Draw each circle between its last two physics states
+                float alpha = step.alpha;
+                for (int i = 0; i < world.count; i++) {
+                    float x, y;
+                    interpolateCircle(&world, i, alpha, &x, &y);
 
-                    applyDampening(&circles[i].velocity.x, &circles[i].velocity.y);
-                    
-                    int randColor = rand() % 15;  // Random index (0 to 14)
-                    SDL_SetRenderDrawColor(gRenderer, circles[i].colour.r, circles[i].colour.g, circles[i].colour.b, circles[i].colour.a);
-                    // Draw the circle
-                    DrawFilledCircle(gRenderer, circles[i].position.x, circles[i].position.y, circles[i].radius);
+                    Color colour = circleColours[i];
+                    SDL_Color vertexColour = {colour.r, colour.g, colour.b, colour.a};
+                    batchFilledCircle(&circleBatch, x, y, world.r[i], vertexColour);
                 }
+                flushGeometryBatch(&circleBatch, gRenderer);
 
-                sprintf(ballNum, "Number of balls: %d", DYNAMIC_CIRCLES);
-                loadFromRenderedText(&gTextTexture,ballNum, textColor);
                 //this is for text
-                renderTexture(&gTextTexture, 0,0, NULL, 0, NULL, SDL_FLIP_NONE); //this is for text (dk, posx, posy, dk, dk, dk,dk); 
-                SDL_RenderPresent(gRenderer); // Update screen
-
-                // Optional: Add a small delay to control simulation speed
-                SDL_Delay(16);
+                batchTextFormat(&hudText, 0, 0, textColor, "Number of balls: %d", world.count);
+                flushGlyphAtlas(&hudText, gRenderer);
+                SDL_RenderPresent(gRenderer); // Update screen (vsynced, the timestep handles speed)
             }
         }
     }
+    freeThreadPool(&physicsPool);
+    freeGravityTree(&gravity);
+    freeGeometryBatch(&circleBatch);
+    freeCircleWorld(&world);
     close(); // Free resources and close SDL
 
     return 0;
@@ -0,0 +1,1568 @@
+// Circle simulation core: structure-of-arrays body storage, broadphase, contact gathering,
+// a batched impulse solver that can run on a thread pool, and island sleeping.
+// Build with -mavx2 to get the 8-wide narrowphase, otherwise the scalar path is used.
+
+#include "circleWorld.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define GATHER_BLOCK 256    // sorted bodies per contact gathering task
+#define SOLVE_BLOCK 256     // contacts per solver task
+#define INTEGRATE_BLOCK 1024 // bodies per integration task
+#define CCD_MAX_HITS 4       // impacts a swept body resolves per substep before it stops for the rest of it
+#define MAX_ATTACHED_SIZE 256 // largest element accepted by attachBodyArray
+
+// Contacts written by one gathering task
+typedef struct {
+    Contact* contacts;
+    int count;
+    int capacity;
+    int tested; // candidate pairs checked by the narrowphase
+} ContactBuffer;
+
+// Uniform grid over a range of bodies, entries sorted by cell so neighbouring cells in a row are contiguous
+typedef struct {
+    float minX, minY, cellSize;
+    float maxR;     // largest radius in the grid
+    int cols, rows; // 0 when the grid is empty
+    int* cellStart; // cols * rows + 1 entries
+    int cellCapacity;
+    int* bodyCell;  // cell of each body in input order
+    int* sCell;     // cell, x, y and r in cell order
+    float* sx;
+    float* sy;
+    float* sr;
+    int* sItem;     // body index (awake grid) or handle id (sleeping grid) in cell order
+} SortedGrid;
+
+// A body touching a screen edge, solved like a contact with an immovable wall so the edge holds
+// up what rests on it inside the solver iterations instead of only clamping after integration
+typedef struct {
+    int body;
+    int axis;       // 0 for the left and right edges, 1 for the top and bottom
+    float side;     // +1 for the right or bottom edge, -1 for the left or top
+    float limit;    // the coordinate the body's centre may not pass
+    float targetVn; // speed away from the edge the solver aims for (restitution)
+    float impulse;  // velocity taken out of the body towards the edge this substep
+    float tangentImpulse; // velocity taken out along the edge by friction this substep
+} EdgeContact;
+
+// Accumulated impulses of the last solved contacts, open addressing on the handle id pair
+typedef struct {
+    uint64_t* keys; // 0 marks an empty slot
+    float* impulses;
+    int capacity;   // power of two
+} ImpulseCache;
+
+struct CircleWorldScratch {
+    SortedGrid awake;    // rebuilt every substep
+    SortedGrid sleeping; // keyed by handle id, rebuilt only when the sleeping set changes
+    bool sleepingDirty;
+
+    ContactBuffer* taskContacts;
+    int taskCapacity;
+
+    ImpulseCache cache;
+
+    uint32_t* colourMask; // colours already used by each body's contacts
+    uint8_t* contactColour;
+    int colourCapacity;
+
+    int* islandParent;      // union-find over the awake bodies
+    uint8_t* islandBlocked; // island root -> island cannot sleep this step
+
+    uint8_t* fast;    // set by integration for bodies left to the swept pass
+    int* sweptBodies; // the fast bodies of this substep in index order
+    float* sweepX;    // start and reach of every fast body's move, in sweptBodies order
+    float* sweepY;
+    float* sweepR;
+    SortedGrid swept; // fast bodies by the circle their whole move stays inside
+
+    EdgeContact* edges; // awake bodies touching the screen edges this substep
+    int edgeCount;
+    int edgeCapacity;
+
+    float gravitySpeed; // twice the speed the world's gravity adds over the current step, 0 before the first
+};
+
+// A body resting under gravity still gains up to a step's worth of fall before its contacts
+// take it back, so neither that speed nor a bounce off it may count as moving
+static float restSpeed(const CircleWorld* world) {
+    return world->sleepVelocity > world->scratch->gravitySpeed ? world->sleepVelocity : world->scratch->gravitySpeed;
+}
+
+static float bounceSpeed(const CircleWorld* world) {
+    return world->bounceVelocity > world->scratch->gravitySpeed ? world->bounceVelocity : world->scratch->gravitySpeed;
+}
+
+static void* growArray(void* array, int* capacity, int needed, size_t elementSize) {
+    if (needed <= *capacity) {
+        return array;
+    }
+    int newCapacity = *capacity > 0 ? *capacity : 64;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    void* grown = realloc(array, elementSize * newCapacity);
+    if (grown == NULL) {
+        return NULL;
+    }
+    *capacity = newCapacity;
+    return grown;
+}
+
+// Resizes one per-body array, leaving it untouched on failure
+static bool resizeBodyArray(void** array, int capacity, size_t elementSize) {
+    void* grown = realloc(*array, elementSize * capacity);
+    if (grown == NULL) {
+        return false;
+    }
+    *array = grown;
+    return true;
+}
+
+static bool growGrid(SortedGrid* g, int newCapacity) {
+    return resizeBodyArray((void**)&g->bodyCell, newCapacity, sizeof(int)) &&
+           resizeBodyArray((void**)&g->sCell, newCapacity, sizeof(int)) &&
+           resizeBodyArray((void**)&g->sx, newCapacity, sizeof(float)) &&
+           resizeBodyArray((void**)&g->sy, newCapacity, sizeof(float)) &&
+           resizeBodyArray((void**)&g->sr, newCapacity, sizeof(float)) &&
+           resizeBodyArray((void**)&g->sItem, newCapacity, sizeof(int));
+}
+
+static void freeGrid(SortedGrid* g) {
+    free(g->cellStart);
+    free(g->bodyCell);
+    free(g->sCell);
+    free(g->sx);
+    free(g->sy);
+    free(g->sr);
+    free(g->sItem);
+}
+
+// Grows every per-body array (world, scratch and attached) to newCapacity
+static bool growBodies(CircleWorld* world, int newCapacity) {
+    CircleWorldScratch* s = world->scratch;
+    void** arrays[] = {
+        (void**)&world->x, (void**)&world->y, (void**)&world->vx, (void**)&world->vy,
+        (void**)&world->invMass, (void**)&world->r, (void**)&world->prevX, (void**)&world->prevY,
+        (void**)&world->restSteps,
+        (void**)&world->handleIndex, (void**)&world->handleGeneration, (void**)&world->bodyHandle,
+        (void**)&world->islandNext, (void**)&world->islandPrev,
+        (void**)&s->colourMask, (void**)&s->islandParent, (void**)&s->islandBlocked,
+        (void**)&s->fast, (void**)&s->sweptBodies,
+        (void**)&s->sweepX, (void**)&s->sweepY, (void**)&s->sweepR
+    };
+    size_t sizes[] = {
+        sizeof(float), sizeof(float), sizeof(float), sizeof(float),
+        sizeof(float), sizeof(float), sizeof(float), sizeof(float),
+        sizeof(int),
+        sizeof(int), sizeof(int), sizeof(int),
+        sizeof(int), sizeof(int),
+        sizeof(uint32_t), sizeof(int), sizeof(uint8_t),
+        sizeof(uint8_t), sizeof(int),
+        sizeof(float), sizeof(float), sizeof(float)
+    };
+
+    for (int i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        if (!resizeBodyArray(arrays[i], newCapacity, sizes[i])) {
+            return false;
+        }
+    }
+    if (!growGrid(&s->awake, newCapacity) || !growGrid(&s->sleeping, newCapacity) || !growGrid(&s->swept, newCapacity)) {
+        return false;
+    }
+    for (int i = 0; i < world->attachedCount; i++) {
+        if (!resizeBodyArray(world->attached[i], newCapacity, world->attachedSize[i])) {
+            return false;
+        }
+    }
+
+    world->capacity = newCapacity;
+    return true;
+}
+
+bool initCircleWorld(CircleWorld* world, int capacity) {
+    memset(world, 0, sizeof(*world));
+    world->scratch = calloc(1, sizeof(CircleWorldScratch));
+    world->freeHandle = -1;
+    world->solverIterations = 4;
+    world->warmStarting = true;
+    world->positionIterations = 4;
+    // at 0.8 a heap dozens of bodies deep overshoots, gains energy and never sleeps, while bodies
+    // that only touch briefly (gas, mixed radii in physicsBench) come out the same either way
+    world->positionRelaxation = 0.5f;
+    world->positionSlop = 0.05f;
+    world->restitution = 1.0f;
+    world->bounceVelocity = 2.0f;
+    world->ccdFraction = 1.0f;
+    world->linearDamping = 0.0f;
+    world->sleepVelocity = 6.0f;
+    world->sleepSteps = 0;
+
+    if (world->scratch == NULL || !growBodies(world, capacity > 16 ? capacity : 16)) {
+        freeCircleWorld(world);
+        return false;
+    }
+    return true;
+}
+
+void freeCircleWorld(CircleWorld* world) {
+    free(world->x);
+    free(world->y);
+    free(world->vx);
+    free(world->vy);
+    free(world->invMass);
+    free(world->r);
+    free(world->prevX);
+    free(world->prevY);
+    free(world->restSteps);
+    free(world->handleIndex);
+    free(world->handleGeneration);
+    free(world->bodyHandle);
+    free(world->islandNext);
+    free(world->islandPrev);
+    free(world->contacts);
+    for (int i = 0; i < world->attachedCount; i++) {
+        free(*world->attached[i]);
+        *world->attached[i] = NULL;
+    }
+
+    CircleWorldScratch* s = world->scratch;
+    if (s != NULL) {
+        freeGrid(&s->awake);
+        freeGrid(&s->sleeping);
+        for (int i = 0; i < s->taskCapacity; i++) {
+            free(s->taskContacts[i].contacts);
+        }
+        free(s->taskContacts);
+        free(s->cache.keys);
+        free(s->cache.impulses);
+        free(s->colourMask);
+        free(s->contactColour);
+        free(s->islandParent);
+        free(s->islandBlocked);
+        free(s->fast);
+        free(s->sweptBodies);
+        free(s->sweepX);
+        free(s->sweepY);
+        free(s->sweepR);
+        freeGrid(&s->swept);
+        free(s->edges);
+        free(s);
+    }
+    memset(world, 0, sizeof(*world));
+}
+
+bool attachBodyArray(CircleWorld* world, void** array, size_t elementSize) {
+    if (world->attachedCount >= MAX_ATTACHED_ARRAYS || elementSize > MAX_ATTACHED_SIZE ||
+        !resizeBodyArray(array, world->capacity, elementSize)) {
+        return false;
+    }
+    world->attached[world->attachedCount] = array;
+    world->attachedSize[world->attachedCount] = elementSize;
+    world->attachedCount++;
+    return true;
+}
+
+// Exchanges the bodies in slots i and j, handles follow their bodies
+static void swapBodies(CircleWorld* world, int i, int j) {
+    if (i == j) {
+        return;
+    }
+
+    float* floats[] = {world->x, world->y, world->vx, world->vy, world->invMass, world->r, world->prevX, world->prevY};
+    for (int k = 0; k < (int)(sizeof(floats) / sizeof(floats[0])); k++) {
+        float t = floats[k][i];
+        floats[k][i] = floats[k][j];
+        floats[k][j] = t;
+    }
+    int rest = world->restSteps[i];
+    world->restSteps[i] = world->restSteps[j];
+    world->restSteps[j] = rest;
+
+    unsigned char temp[MAX_ATTACHED_SIZE];
+    for (int a = 0; a < world->attachedCount; a++) {
+        char* array = *world->attached[a];
+        size_t size = world->attachedSize[a];
+        memcpy(temp, array + size * i, size);
+        memcpy(array + size * i, array + size * j, size);
+        memcpy(array + size * j, temp, size);
+    }
+
+    int idI = world->bodyHandle[i], idJ = world->bodyHandle[j];
+    world->bodyHandle[i] = idJ;
+    world->bodyHandle[j] = idI;
+    world->handleIndex[idJ] = i;
+    world->handleIndex[idI] = j;
+}
+
+int reserveCircles(CircleWorld* world, int count) {
+    if (world->count + count > world->capacity) {
+        int newCapacity = world->capacity;
+        while (newCapacity < world->count + count) {
+            newCapacity *= 2; // geometric growth keeps appends amortised O(1)
+        }
+        if (!growBodies(world, newCapacity)) {
+            return -1;
+        }
+    }
+
+    int end = world->count;
+    for (int i = end; i < end + count; i++) {
+        // reuse a freed id if there is one, its generation was bumped on removal
+        int id = world->freeHandle;
+        if (id >= 0) {
+            world->freeHandle = world->handleIndex[id];
+        } else {
+            id = world->handleCount++;
+            world->handleGeneration[id] = 0;
+        }
+        world->handleIndex[id] = i;
+        world->bodyHandle[i] = id;
+        world->restSteps[i] = 0;
+        world->prevX[i] = NAN; // no step yet, interpolateCircle uses the position the caller writes
+        world->prevY[i] = NAN;
+    }
+    world->count += count;
+
+    // new bodies start awake: the sleeping bodies they displace move to the new tail
+    int first = world->awakeCount;
+    int tail = first + count > end ? first + count : end;
+    for (int k = 0; k < count && first + k < end; k++) {
+        swapBodies(world, first + k, tail + k);
+    }
+    world->awakeCount += count;
+    return first;
+}
+
+CircleHandle addCircle(CircleWorld* world, float x, float y, float vx, float vy, float mass, float radius) {
+    int i = reserveCircles(world, 1);
+    if (i < 0) {
+        CircleHandle none = {-1, 0};
+        return none;
+    }
+
+    world->x[i] = x;
+    world->y[i] = y;
+    world->vx[i] = vx;
+    world->vy[i] = vy;
+    world->invMass[i] = mass > 0 ? 1.0f / mass : 0.0f;
+    world->r[i] = radius;
+    world->prevX[i] = x;
+    world->prevY[i] = y;
+    return circleHandle(world, i);
+}
+
+void interpolateCircle(const CircleWorld* world, int i, float alpha, float* x, float* y) {
+    if (isnan(world->prevX[i])) {
+        *x = world->x[i];
+        *y = world->y[i];
+        return;
+    }
+    *x = world->prevX[i] + (world->x[i] - world->prevX[i]) * alpha;
+    *y = world->prevY[i] + (world->y[i] - world->prevY[i]) * alpha;
+}
+
+bool removeCircle(CircleWorld* world, CircleHandle handle) {
+    int i = circleIndex(world, handle);
+    if (i < 0) {
+        return false;
+    }
+
+    if (i < world->awakeCount) {
+        // the last awake body fills the hole so the awake range stays dense
+        world->awakeCount--;
+        swapBodies(world, i, world->awakeCount);
+        i = world->awakeCount;
+    } else {
+        // leave the sleeping island
+        world->islandNext[world->islandPrev[handle.id]] = world->islandNext[handle.id];
+        world->islandPrev[world->islandNext[handle.id]] = world->islandPrev[handle.id];
+        world->scratch->sleepingDirty = true;
+    }
+
+    // swap-and-pop: the last body fills the hole so iteration stays dense
+    swapBodies(world, i, world->count - 1);
+    world->count--;
+
+    // retire the id: bump its generation so old handles go stale, then free it
+    world->handleGeneration[handle.id]++;
+    world->handleIndex[handle.id] = world->freeHandle;
+    world->freeHandle = handle.id;
+    return true;
+}
+
+int circleIndex(const CircleWorld* world, CircleHandle handle) {
+    if (handle.id < 0 || handle.id >= world->handleCount || world->handleGeneration[handle.id] != handle.generation) {
+        return -1;
+    }
+    return world->handleIndex[handle.id];
+}
+
+CircleHandle circleHandle(const CircleWorld* world, int index) {
+    CircleHandle handle = {world->bodyHandle[index], world->handleGeneration[world->bodyHandle[index]]};
+    return handle;
+}
+
+// Moves every body of the sleeping island containing id back into the awake range
+static void wakeIsland(CircleWorld* world, int id, int restSteps) {
+    if (world->handleIndex[id] < world->awakeCount) {
+        return;
+    }
+
+    int member = id;
+    do {
+        swapBodies(world, world->handleIndex[member], world->awakeCount);
+        world->restSteps[world->awakeCount] = restSteps;
+        world->awakeCount++;
+        member = world->islandNext[member];
+    } while (member != id);
+    world->scratch->sleepingDirty = true;
+}
+
+bool isCircleAsleep(const CircleWorld* world, CircleHandle handle) {
+    return circleIndex(world, handle) >= world->awakeCount;
+}
+
+void wakeCircle(CircleWorld* world, CircleHandle handle) {
+    if (circleIndex(world, handle) >= 0) {
+        wakeIsland(world, handle.id, 0);
+    }
+}
+
+// Returns one bit per circle j in [start, end) (at most 8) that touches (px, py, pr).
+// Only squared distances are compared, no square root is taken here.
+static unsigned overlapMask8(const float* xs, const float* ys, const float* rs, float px, float py, float pr, int start, int end) {
+#ifdef __AVX2__
+    if (end - start == 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + start), _mm256_set1_ps(px));
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + start), _mm256_set1_ps(py));
+        __m256 radii = _mm256_add_ps(_mm256_loadu_ps(rs + start), _mm256_set1_ps(pr));
+
+        __m256 distSq = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        __m256 touching = _mm256_cmp_ps(distSq, _mm256_mul_ps(radii, radii), _CMP_LE_OQ);
+        return (unsigned)_mm256_movemask_ps(touching);
+    }
+#endif
+
+    // scalar path, also used for the tail of a range
+    unsigned mask = 0;
+    for (int j = start; j < end; j++) {
+        float dx = xs[j] - px;
+        float dy = ys[j] - py;
+        float radii = rs[j] + pr;
+        if (dx * dx + dy * dy <= radii * radii) {
+            mask |= 1u << (j - start);
+        }
+    }
+    return mask;
+}
+
+bool circleOverlapsAny(const CircleWorld* world, float x, float y, float r) {
+    for (int j = 0; j < world->count; j += 8) {
+        int end = j + 8 < world->count ? j + 8 : world->count;
+        if (overlapMask8(world->x, world->y, world->r, x, y, r, j, end)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Sorts n circles into g, a uniform grid whose cells are one body diameter wide, so every
+// touching pair lies in the same or a neighbouring cell. Entry i gets item items[i], or
+// itemBase + i when items is NULL.
+static bool fillGrid(SortedGrid* g, const float* x, const float* y, const float* r, int n, const int* items, int itemBase) {
+    g->cols = g->rows = 0;
+    if (n <= 0) {
+        return true;
+    }
+
+    float minX = x[0], maxX = x[0];
+    float minY = y[0], maxY = y[0];
+    float maxR = r[0];
+    for (int i = 1; i < n; i++) {
+        if (x[i] < minX) minX = x[i];
+        if (x[i] > maxX) maxX = x[i];
+        if (y[i] < minY) minY = y[i];
+        if (y[i] > maxY) maxY = y[i];
+        if (r[i] > maxR) maxR = r[i];
+    }
+
+    float cellSize = 2.0f * maxR > 1.0f ? 2.0f * maxR : 1.0f;
+    float cols = floorf((maxX - minX) / cellSize) + 1;
+    float rows = floorf((maxY - minY) / cellSize) + 1;
+
+    // keep the grid proportional to the body count when bodies are spread far apart
+    float maxCells = 4.0f * n + 64;
+    if (cols * rows > maxCells) {
+        cellSize *= sqrtf(cols * rows / maxCells);
+        cols = floorf((maxX - minX) / cellSize) + 1;
+        rows = floorf((maxY - minY) / cellSize) + 1;
+    }
+
+    int cells = (int)cols * (int)rows;
+    int* cellStart = growArray(g->cellStart, &g->cellCapacity, cells + 1, sizeof(int));
+    if (cellStart == NULL) {
+        return false;
+    }
+    g->cellStart = cellStart;
+    g->minX = minX;
+    g->minY = minY;
+    g->cellSize = cellSize;
+    g->maxR = maxR;
+    g->cols = (int)cols;
+    g->rows = (int)rows;
+    memset(cellStart, 0, sizeof(int) * (cells + 1));
+
+    // counting sort by cell, stable so the order only depends on the body order
+    float invCell = 1.0f / cellSize;
+    for (int i = 0; i < n; i++) {
+        int cx = (int)((x[i] - minX) * invCell);
+        int cy = (int)((y[i] - minY) * invCell);
+        if (cx >= g->cols) cx = g->cols - 1;
+        if (cy >= g->rows) cy = g->rows - 1;
+        g->bodyCell[i] = cy * g->cols + cx;
+        cellStart[g->bodyCell[i] + 1]++;
+    }
+    for (int c = 0; c < cells; c++) {
+        cellStart[c + 1] += cellStart[c];
+    }
+    for (int i = 0; i < n; i++) {
+        int slot = cellStart[g->bodyCell[i]]++;
+        g->sCell[slot] = g->bodyCell[i];
+        g->sx[slot] = x[i];
+        g->sy[slot] = y[i];
+        g->sr[slot] = r[i];
+        g->sItem[slot] = items != NULL ? items[i] : itemBase + i;
+    }
+    // the scatter advanced every start to the next cell's start, shift back
+    for (int c = cells; c > 0; c--) {
+        cellStart[c] = cellStart[c - 1];
+    }
+    cellStart[0] = 0;
+    return true;
+}
+
+static bool buildGrid(CircleWorld* world, SortedGrid* g, int first, int n, bool byHandle) {
+    return fillGrid(g, world->x + first, world->y + first, world->r + first, n,
+                    byHandle ? world->bodyHandle + first : NULL, first);
+}
+
+// Cells of g that can hold a circle touching (x, y, r), false if there are none
+static bool gridCellRange(const SortedGrid* g, float x, float y, float r, int* cx0, int* cy0, int* cx1, int* cy1) {
+    if (g->cols == 0) {
+        return false;
+    }
+    float reach = r + g->maxR;
+    float invCell = 1.0f / g->cellSize;
+    float fx0 = floorf((x - reach - g->minX) * invCell), fx1 = floorf((x + reach - g->minX) * invCell);
+    float fy0 = floorf((y - reach - g->minY) * invCell), fy1 = floorf((y + reach - g->minY) * invCell);
+    if (fx1 < 0 || fy1 < 0 || fx0 >= g->cols || fy0 >= g->rows) {
+        return false;
+    }
+    *cx0 = fx0 > 0 ? (int)fx0 : 0;
+    *cy0 = fy0 > 0 ? (int)fy0 : 0;
+    *cx1 = fx1 < g->cols - 1 ? (int)fx1 : g->cols - 1;
+    *cy1 = fy1 < g->rows - 1 ? (int)fy1 : g->rows - 1;
+    return true;
+}
+
+static bool pushContact(ContactBuffer* out, int a, int b, float dx, float dy) {
+    Contact* grown = growArray(out->contacts, &out->capacity, out->count + 1, sizeof(Contact));
+    if (grown == NULL) {
+        return false;
+    }
+    out->contacts = grown;
+
+    float dist = sqrtf(dx * dx + dy * dy); // only touching pairs get here
+
+    Contact* c = &out->contacts[out->count++];
+    c->a = a;
+    c->b = b;
+    c->nx = dist > 0 ? dx / dist : 1.0f;
+    c->ny = dist > 0 ? dy / dist : 0.0f;
+    c->targetVn = 0;
+    c->impulse = 0;
+    c->overlap = 0;
+    return true;
+}
+
+// Tests sorted body i against the sorted range [start, end) and records the touching pairs
+static void gatherRange(ContactBuffer* out, const SortedGrid* g, int i, int start, int end) {
+    float xi = g->sx[i], yi = g->sy[i], ri = g->sr[i];
+    out->tested += end > start ? end - start : 0;
+
+    for (int j = start; j < end; j += 8) {
+        int blockEnd = j + 8 < end ? j + 8 : end;
+        unsigned mask = overlapMask8(g->sx, g->sy, g->sr, xi, yi, ri, j, blockEnd);
+
+        while (mask) {
+            int k = j + __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (!pushContact(out, g->sItem[i], g->sItem[k], g->sx[k] - xi, g->sy[k] - yi)) {
+                return;
+            }
+        }
+    }
+}
+
+// Records the contacts between awake body a and the sleeping bodies it rests on
+static void gatherSleeping(CircleWorld* world, ContactBuffer* out, int a) {
+    const SortedGrid* g = &world->scratch->sleeping;
+    float x = world->x[a], y = world->y[a], r = world->r[a];
+    int cx0, cy0, cx1, cy1;
+    if (!gridCellRange(g, x, y, r, &cx0, &cy0, &cx1, &cy1)) {
+        return;
+    }
+
+    for (int cy = cy0; cy <= cy1; cy++) {
+        int start = g->cellStart[cy * g->cols + cx0], end = g->cellStart[cy * g->cols + cx1 + 1];
+        for (int j = start; j < end; j += 8) {
+            int blockEnd = j + 8 < end ? j + 8 : end;
+            unsigned mask = overlapMask8(g->sx, g->sy, g->sr, x, y, r, j, blockEnd);
+
+            while (mask) {
+                int k = j + __builtin_ctz(mask);
+                mask &= mask - 1;
+                if (!pushContact(out, a, world->handleIndex[g->sItem[k]], g->sx[k] - x, g->sy[k] - y)) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+static void gatherTask(void* data, int task) {
+    CircleWorld* world = data;
+    CircleWorldScratch* s = world->scratch;
+    const SortedGrid* g = &s->awake;
+    ContactBuffer* out = &s->taskContacts[task];
+    out->count = 0;
+    out->tested = 0;
+
+    int begin = task * GATHER_BLOCK;
+    int end = begin + GATHER_BLOCK < world->awakeCount ? begin + GATHER_BLOCK : world->awakeCount;
+
+    for (int i = begin; i < end; i++) {
+        int cell = g->sCell[i];
+        int cx = cell % g->cols, cy = cell / g->cols;
+        int cx0 = cx > 0 ? cx - 1 : 0;
+        int cx1 = cx + 1 < g->cols ? cx + 1 : cx;
+
+        // own row: only bodies sorted after i, so every pair is found once
+        gatherRange(out, g, i, i + 1, g->cellStart[cy * g->cols + cx1 + 1]);
+
+        // the row below, all of it sorts after i
+        if (cy + 1 < g->rows) {
+            int row = (cy + 1) * g->cols;
+            gatherRange(out, g, i, g->cellStart[row + cx0], g->cellStart[row + cx1 + 1]);
+        }
+
+        gatherSleeping(world, out, g->sItem[i]);
+    }
+}
+
+static void refreshSleepingGrid(CircleWorld* world) {
+    CircleWorldScratch* s = world->scratch;
+    if (s->sleepingDirty) {
+        buildGrid(world, &s->sleeping, world->awakeCount, world->count - world->awakeCount, true);
+        s->sleepingDirty = false;
+    }
+}
+
+// Wakes the islands that a moving awake body runs into. Bodies merely resting
+// against a sleeping island stay in contact with it without waking it.
+static void wakeTouchedIslands(CircleWorld* world) {
+    if (world->awakeCount == world->count) {
+        return;
+    }
+    refreshSleepingGrid(world);
+
+    const SortedGrid* g = &world->scratch->sleeping;
+    float wakeSq = restSpeed(world) * restSpeed(world);
+    int awake = world->awakeCount; // woken bodies land after this range and are not rescanned
+
+    for (int a = 0; a < awake; a++) {
+        if (world->vx[a] * world->vx[a] + world->vy[a] * world->vy[a] <= wakeSq) {
+            continue;
+        }
+
+        int cx0, cy0, cx1, cy1;
+        if (!gridCellRange(g, world->x[a], world->y[a], world->r[a], &cx0, &cy0, &cx1, &cy1)) {
+            continue;
+        }
+        for (int cy = cy0; cy <= cy1; cy++) {
+            int start = g->cellStart[cy * g->cols + cx0], end = g->cellStart[cy * g->cols + cx1 + 1];
+            for (int j = start; j < end; j += 8) {
+                int blockEnd = j + 8 < end ? j + 8 : end;
+                unsigned mask = overlapMask8(g->sx, g->sy, g->sr, world->x[a], world->y[a], world->r[a], j, blockEnd);
+                while (mask) {
+                    int k = j + __builtin_ctz(mask);
+                    mask &= mask - 1;
+                    wakeIsland(world, g->sItem[k], 0);
+                }
+            }
+        }
+    }
+
+    refreshSleepingGrid(world);
+}
+
+void findContacts(CircleWorld* world) {
+    CircleWorldScratch* s = world->scratch;
+    world->contactCount = 0;
+    world->stats.candidatePairs = 0;
+    memset(world->batchStart, 0, sizeof(world->batchStart));
+
+    wakeTouchedIslands(world);
+    if (world->awakeCount == 0 || !buildGrid(world, &s->awake, 0, world->awakeCount, false)) {
+        return;
+    }
+
+    int tasks = (world->awakeCount + GATHER_BLOCK - 1) / GATHER_BLOCK;
+    if (tasks > s->taskCapacity) {
+        ContactBuffer* grown = realloc(s->taskContacts, sizeof(ContactBuffer) * tasks);
+        if (grown == NULL) {
+            return;
+        }
+        memset(grown + s->taskCapacity, 0, sizeof(ContactBuffer) * (tasks - s->taskCapacity));
+        s->taskContacts = grown;
+        s->taskCapacity = tasks;
+    }
+    runTasks(world->pool, tasks, gatherTask, world);
+
+    int total = 0;
+    for (int t = 0; t < tasks; t++) {
+        total += s->taskContacts[t].count;
+        world->stats.candidatePairs += s->taskContacts[t].tested;
+    }
+    Contact* contacts = growArray(world->contacts, &world->contactCapacity, total, sizeof(Contact));
+    uint8_t* colours = growArray(s->contactColour, &s->colourCapacity, total, sizeof(uint8_t));
+    if (contacts == NULL || colours == NULL) {
+        return;
+    }
+    world->contacts = contacts;
+    s->contactColour = colours;
+
+    // greedy colouring in task order: a contact takes the first colour neither body uses yet,
+    // the last colour collects whatever is left and is solved serially
+    int colourCount[MAX_CONTACT_COLOURS] = {0};
+    memset(s->colourMask, 0, sizeof(uint32_t) * world->count);
+    int index = 0;
+    for (int t = 0; t < tasks; t++) {
+        ContactBuffer* buffer = &s->taskContacts[t];
+        for (int k = 0; k < buffer->count; k++, index++) {
+            Contact* c = &buffer->contacts[k];
+            uint32_t used = s->colourMask[c->a] | s->colourMask[c->b] | (1u << (MAX_CONTACT_COLOURS - 1));
+            int colour = used == 0xFFFFFFFFu ? MAX_CONTACT_COLOURS - 1 : __builtin_ctz(~used);
+            s->colourMask[c->a] |= 1u << colour;
+            s->colourMask[c->b] |= 1u << colour;
+            colours[index] = (uint8_t)colour;
+            colourCount[colour]++;
+        }
+    }
+
+    // lay the contacts out batch after batch
+    world->batchStart[0] = 0;
+    for (int c = 0; c < MAX_CONTACT_COLOURS; c++) {
+        world->batchStart[c + 1] = world->batchStart[c] + colourCount[c];
+    }
+    int slot[MAX_CONTACT_COLOURS];
+    memcpy(slot, world->batchStart, sizeof(slot));
+    index = 0;
+    for (int t = 0; t < tasks; t++) {
+        ContactBuffer* buffer = &s->taskContacts[t];
+        for (int k = 0; k < buffer->count; k++, index++) {
+            contacts[slot[colours[index]]++] = buffer->contacts[k];
+        }
+    }
+    world->contactCount = total;
+}
+
+// Sleeping bodies hold still: awake bodies resting on them see an immovable body
+static inline float solverInvMass(const CircleWorld* world, int i) {
+    return i < world->awakeCount ? world->invMass[i] : 0.0f;
+}
+
+// A slice of the contact list handed to solver tasks
+typedef struct {
+    CircleWorld* world;
+    int begin, end;
+} ContactRange;
+
+// Order-independent key for the pair of bodies a contact joins, never 0
+static uint64_t pairKey(const CircleWorld* world, int a, int b) {
+    uint64_t idA = (uint64_t)world->bodyHandle[a] + 1, idB = (uint64_t)world->bodyHandle[b] + 1;
+    return idA < idB ? (idA << 32) | idB : (idB << 32) | idA;
+}
+
+// An edge contact's key: the body's handle with a low word no pair of handles reaches
+static uint64_t edgeKey(const CircleWorld* world, const EdgeContact* e) {
+    uint64_t id = (uint64_t)world->bodyHandle[e->body] + 1;
+    return (id << 32) | (0xFFFFFFFCu + 2u * e->axis + (e->side > 0));
+}
+
+static int cacheSlot(uint64_t key, int capacity) {
+    return (int)((key * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+}
+
+static float cachedImpulse(const ImpulseCache* cache, uint64_t key) {
+    if (cache->capacity == 0) {
+        return 0;
+    }
+    for (int slot = cacheSlot(key, cache->capacity); cache->keys[slot] != 0; slot = (slot + 1) & (cache->capacity - 1)) {
+        if (cache->keys[slot] == key) {
+            return cache->impulses[slot];
+        }
+    }
+    return 0;
+}
+
+static void cacheImpulse(ImpulseCache* cache, uint64_t key, float impulse) {
+    int slot = cacheSlot(key, cache->capacity);
+    while (cache->keys[slot] != 0) {
+        slot = (slot + 1) & (cache->capacity - 1);
+    }
+    cache->keys[slot] = key;
+    cache->impulses[slot] = impulse;
+}
+
+// Replaces the cache with the impulses of the contacts and edge contacts just solved
+static void storeImpulses(CircleWorld* world) {
+    CircleWorldScratch* s = world->scratch;
+    ImpulseCache* cache = &s->cache;
+    int capacity = 64;
+    while (capacity < 2 * (world->contactCount + s->edgeCount)) {
+        capacity *= 2; // at most half full so probes stay short
+    }
+    if (capacity > cache->capacity) {
+        uint64_t* keys = realloc(cache->keys, sizeof(uint64_t) * capacity);
+        if (keys != NULL) {
+            cache->keys = keys;
+        }
+        float* impulses = realloc(cache->impulses, sizeof(float) * capacity);
+        if (impulses != NULL) {
+            cache->impulses = impulses;
+        }
+        if (keys == NULL || impulses == NULL) {
+            cache->capacity = 0;
+            return;
+        }
+        cache->capacity = capacity;
+    }
+    memset(cache->keys, 0, sizeof(uint64_t) * cache->capacity);
+
+    for (int k = 0; k < world->contactCount; k++) {
+        Contact* c = &world->contacts[k];
+        if (c->impulse > 0) {
+            cacheImpulse(cache, pairKey(world, c->a, c->b), c->impulse);
+        }
+    }
+    for (int k = 0; k < s->edgeCount; k++) {
+        EdgeContact* e = &s->edges[k];
+        if (e->impulse > 0) {
+            cacheImpulse(cache, edgeKey(world, e), e->impulse);
+        }
+    }
+}
+
+static void prepareTask(void* data, int task) {
+    ContactRange* range = data;
+    CircleWorld* world = range->world;
+    int begin = range->begin + task * SOLVE_BLOCK;
+    int end = begin + SOLVE_BLOCK < range->end ? begin + SOLVE_BLOCK : range->end;
+    float bounce = bounceSpeed(world);
+
+    for (int k = begin; k < end; k++) {
+        Contact* c = &world->contacts[k];
+        float vn = (world->vx[c->b] - world->vx[c->a]) * c->nx + (world->vy[c->b] - world->vy[c->a]) * c->ny;
+        // only pairs approaching faster than bounceVelocity bounce, slower ones just stop so a
+        // resting contact does not hop up by a fraction of the speed it gained this substep
+        c->targetVn = vn < -bounce ? -world->restitution * vn : 0;
+
+        // every pair starts from last substep's impulse, also those drifting apart a little: a
+        // resting stack needs its support from the start, and the clamp takes back any excess
+        c->tangentImpulse = 0;
+        c->impulse = world->warmStarting ? cachedImpulse(&world->scratch->cache, pairKey(world, c->a, c->b)) : 0;
+    }
+}
+
+static void warmStartTask(void* data, int task) {
+    ContactRange* range = data;
+    CircleWorld* world = range->world;
+    int begin = range->begin + task * SOLVE_BLOCK;
+    int end = begin + SOLVE_BLOCK < range->end ? begin + SOLVE_BLOCK : range->end;
+
+    for (int k = begin; k < end; k++) {
+        Contact* c = &world->contacts[k];
+        float invA = solverInvMass(world, c->a);
+        float invB = solverInvMass(world, c->b);
+
+        world->vx[c->a] -= c->nx * c->impulse * invA;
+        world->vy[c->a] -= c->ny * c->impulse * invA;
+        world->vx[c->b] += c->nx * c->impulse * invB;
+        world->vy[c->b] += c->ny * c->impulse * invB;
+    }
+}
+
+static void solveTask(void* data, int task) {
+    ContactRange* range = data;
+    CircleWorld* world = range->world;
+    int begin = range->begin + task * SOLVE_BLOCK;
+    int end = begin + SOLVE_BLOCK < range->end ? begin + SOLVE_BLOCK : range->end;
+
+    for (int k = begin; k < end; k++) {
+        Contact* c = &world->contacts[k];
+        float invA = solverInvMass(world, c->a);
+        float invB = solverInvMass(world, c->b);
+        if (invA + invB <= 0) {
+            continue;
+        }
+
+        float vn = (world->vx[c->b] - world->vx[c->a]) * c->nx + (world->vy[c->b] - world->vy[c->a]) * c->ny;
+        float lambda = (c->targetVn - vn) / (invA + invB);
+
+        // the total impulse may only push the bodies apart
+        float newImpulse = c->impulse + lambda > 0 ? c->impulse + lambda : 0;
+        lambda = newImpulse - c->impulse;
+        c->impulse = newImpulse;
+
+        world->vx[c->a] -= c->nx * lambda * invA;
+        world->vy[c->a] -= c->ny * lambda * invA;
+        world->vx[c->b] += c->nx * lambda * invB;
+        world->vy[c->b] += c->ny * lambda * invB;
+
+        // friction: the circles do not spin, so it only slows one sliding over the other, by at
+        // most friction times the impulse pushing them apart
+        if (world->friction > 0) {
+            float tx = -c->ny, ty = c->nx;
+            float vt = (world->vx[c->b] - world->vx[c->a]) * tx + (world->vy[c->b] - world->vy[c->a]) * ty;
+            float limit = world->friction * c->impulse;
+            float newTangent = c->tangentImpulse - vt / (invA + invB);
+            newTangent = newTangent > limit ? limit : newTangent < -limit ? -limit : newTangent;
+            float tangent = newTangent - c->tangentImpulse;
+            c->tangentImpulse = newTangent;
+
+            world->vx[c->a] -= tx * tangent * invA;
+            world->vy[c->a] -= ty * tangent * invA;
+            world->vx[c->b] += tx * tangent * invB;
+            world->vy[c->b] += ty * tangent * invB;
+        }
+    }
+}
+
+static void correctTask(void* data, int task) {
+    ContactRange* range = data;
+    CircleWorld* world = range->world;
+    int begin = range->begin + task * SOLVE_BLOCK;
+    int end = begin + SOLVE_BLOCK < range->end ? begin + SOLVE_BLOCK : range->end;
+
+    for (int k = begin; k < end; k++) {
+        Contact* c = &world->contacts[k];
+        int a = c->a, b = c->b;
+        float dx = world->x[b] - world->x[a];
+        float dy = world->y[b] - world->y[a];
+        float radii = world->r[a] + world->r[b];
+        float distSq = dx * dx + dy * dy;
+        c->overlap = 0;
+        if (distSq >= radii * radii || distSq <= 0) {
+            continue;
+        }
+
+        float dist = sqrtf(distSq);
+        c->overlap = radii - dist;
+
+        // remove part of the overlap beyond the slop, the lighter body moving further. Only
+        // positions move, velocities are left as the solver made them so no energy goes back in.
+        float invA = solverInvMass(world, a);
+        float invB = solverInvMass(world, b);
+        float correction = world->positionRelaxation * (c->overlap - world->positionSlop);
+        if (correction <= 0 || invA + invB <= 0) {
+            continue;
+        }
+        float moveX = (dx / dist) * correction / (invA + invB);
+        float moveY = (dy / dist) * correction / (invA + invB);
+
+        world->x[a] -= moveX * invA;
+        world->y[a] -= moveY * invA;
+        world->x[b] += moveX * invB;
+        world->y[b] += moveY * invB;
+    }
+}
+
+// Runs fn over every colour batch in order. Contacts inside a batch share no body, so a
+// batch is split across the pool; the last batch holds the leftovers and runs serially.
+static void forEachBatch(CircleWorld* world, TaskFunction fn) {
+    for (int colour = 0; colour < MAX_CONTACT_COLOURS; colour++) {
+        ContactRange range = {world, world->batchStart[colour], world->batchStart[colour + 1]};
+        int size = range.end - range.begin;
+        if (size <= 0) {
+            continue;
+        }
+
+        if (colour == MAX_CONTACT_COLOURS - 1) {
+            for (int task = 0; task * SOLVE_BLOCK < size; task++) {
+                fn(&range, task);
+            }
+        } else {
+            runTasks(world->pool, (size + SOLVE_BLOCK - 1) / SOLVE_BLOCK, fn, &range);
+        }
+    }
+}
+
+// Collects the awake bodies within positionSlop of a screen edge, at most two edges each
+static void findEdgeContacts(CircleWorld* world, float width, float height) {
+    CircleWorldScratch* s = world->scratch;
+    s->edgeCount = 0;
+    EdgeContact* edges = growArray(s->edges, &s->edgeCapacity, 2 * world->awakeCount, sizeof(EdgeContact));
+    if (edges == NULL) {
+        return;
+    }
+    s->edges = edges;
+
+    float slop = world->positionSlop;
+    for (int i = 0; i < world->awakeCount; i++) {
+        float r = world->r[i];
+        float limits[2][2] = {{r, width - r}, {r, height - r}};
+        float position[2] = {world->x[i], world->y[i]};
+        for (int axis = 0; axis < 2; axis++) {
+            float side = 0, limit = 0;
+            if (position[axis] <= limits[axis][0] + slop) {
+                side = -1;
+                limit = limits[axis][0];
+            } else if (position[axis] >= limits[axis][1] - slop) {
+                side = 1;
+                limit = limits[axis][1];
+            }
+            if (side != 0) {
+                EdgeContact* e = &edges[s->edgeCount++];
+                e->body = i;
+                e->axis = axis;
+                e->side = side;
+                e->limit = limit;
+            }
+        }
+    }
+}
+
+// Velocity of body i along an axis, 0 for x and 1 for y
+static inline float* axisVelocity(CircleWorld* world, int axis, int i) {
+    return axis == 0 ? &world->vx[i] : &world->vy[i];
+}
+
+// One pass over the edge contacts, serial since a body in a corner has two
+static void solveEdges(CircleWorld* world) {
+    CircleWorldScratch* s = world->scratch;
+    for (int k = 0; k < s->edgeCount; k++) {
+        EdgeContact* e = &s->edges[k];
+        float* v = axisVelocity(world, e->axis, e->body);
+        float vn = *v * e->side; // towards the edge
+
+        // the total may only hold the body back from the edge, never pull it in
+        float newImpulse = e->impulse + vn + e->targetVn > 0 ? e->impulse + vn + e->targetVn : 0;
+        *v -= (newImpulse - e->impulse) * e->side;
+        e->impulse = newImpulse;
+
+        // friction slows sliding along the edge, up to friction times what holds the body off it
+        float* along = axisVelocity(world, 1 - e->axis, e->body);
+        float limit = world->friction * e->impulse;
+        float newTangent = e->tangentImpulse + *along;
+        newTangent = newTangent > limit ? limit : newTangent < -limit ? -limit : newTangent;
+        *along -= newTangent - e->tangentImpulse;
+        e->tangentImpulse = newTangent;
+    }
+}
+
+void resolveCollisions(CircleWorld* world) {
+    ContactRange all = {world, 0, world->contactCount};
+    runTasks(world->pool, (world->contactCount + SOLVE_BLOCK - 1) / SOLVE_BLOCK, prepareTask, &all);
+    CircleWorldScratch* s = world->scratch;
+    float bounce = bounceSpeed(world);
+    for (int k = 0; k < s->edgeCount; k++) {
+        EdgeContact* e = &s->edges[k];
+        float vn = *axisVelocity(world, e->axis, e->body) * e->side;
+        e->targetVn = vn > bounce ? world->restitution * vn : 0;
+        e->tangentImpulse = 0;
+
+        // the bottom row carries the weight of everything above it, which a few iterations
+        // from nothing can't build up, so edges start from last substep's impulse like pairs
+        e->impulse = world->warmStarting ? cachedImpulse(&s->cache, edgeKey(world, e)) : 0;
+        *axisVelocity(world, e->axis, e->body) -= e->impulse * e->side;
+    }
+    if (world->warmStarting) {
+        forEachBatch(world, warmStartTask);
+    }
+
+    for (int iteration = 0; iteration < world->solverIterations; iteration++) {
+        solveEdges(world);
+        forEachBatch(world, solveTask);
+    }
+
+    if (world->warmStarting) {
+        storeImpulses(world);
+    }
+}
+
+void correctPositions(CircleWorld* world) {
+    world->stats.contacts = world->contactCount;
+    world->stats.maxOverlap = 0;
+    world->stats.averageOverlap = 0;
+
+    for (int iteration = 0; iteration < world->positionIterations && world->contactCount > 0; iteration++) {
+        forEachBatch(world, correctTask);
+        world->stats.positionIterations++;
+
+        // whatever the pairs pushed into an edge goes straight back, so the next pass moves the
+        // body on top instead of the one against the edge
+        CircleWorldScratch* s = world->scratch;
+        for (int k = 0; k < s->edgeCount; k++) {
+            EdgeContact* e = &s->edges[k];
+            float* position = e->axis == 0 ? &world->x[e->body] : &world->y[e->body];
+            if ((*position - e->limit) * e->side > 0) {
+                *position = e->limit;
+            }
+        }
+
+        float maxOverlap = 0, totalOverlap = 0;
+        for (int k = 0; k < world->contactCount; k++) {
+            float overlap = world->contacts[k].overlap;
+            totalOverlap += overlap;
+            if (overlap > maxOverlap) maxOverlap = overlap;
+        }
+        world->stats.maxOverlap = maxOverlap;
+        world->stats.averageOverlap = totalOverlap / world->contactCount;
+
+        // each pass takes a share of what is beyond the slop, so the overlaps only approach it;
+        // once none is more than one pass from it the next pass would hardly move anything
+        if (maxOverlap <= world->positionSlop * (1.0f + world->positionRelaxation)) {
+            break;
+        }
+    }
+}
+
+int collideProbe(CircleWorld* world, float x, float y, float vx, float vy, float mass, float radius) {
+    // minimum velocity after a hit so bodies do not stick to the probe
+    const float minPostCollisionVel = 30.0f; // pixels per second
+    float probeInvMass = 1.0f / mass;
+    int hits = 0;
+
+    // wake the sleeping islands under the probe first, that moves them into the awake range
+    for (int j = world->awakeCount; j < world->count; ) {
+        int end = j + 8 < world->count ? j + 8 : world->count;
+        unsigned mask = overlapMask8(world->x, world->y, world->r, x, y, radius, j, end);
+        if (mask) {
+            wakeIsland(world, world->bodyHandle[j + __builtin_ctz(mask)], 0);
+            j = world->awakeCount; // the sleeping range shrank and was reordered
+        } else {
+            j = end;
+        }
+    }
+
+    for (int j = 0; j < world->awakeCount; j += 8) {
+        int end = j + 8 < world->awakeCount ? j + 8 : world->awakeCount;
+        unsigned mask = overlapMask8(world->x, world->y, world->r, x, y, radius, j, end);
+
+        while (mask) {
+            int k = j + __builtin_ctz(mask);
+            mask &= mask - 1;
+
+            float dx = world->x[k] - x;
+            float dy = world->y[k] - y;
+            float distSq = dx * dx + dy * dy;
+            float invMassSum = probeInvMass + world->invMass[k];
+            if (distSq <= 0 || invMassSum <= 0) {
+                continue;
+            }
+
+            // the probe is kinematic, only the body responds
+            float dot = (world->vx[k] - vx) * dx + (world->vy[k] - vy) * dy;
+            float scale = (2.0f * world->invMass[k] / invMassSum) * dot / distSq;
+            world->vx[k] -= dx * scale;
+            world->vy[k] -= dy * scale;
+
+            if (world->vx[k] != 0 && fabsf(world->vx[k]) < minPostCollisionVel) {
+                world->vx[k] *= minPostCollisionVel / fabsf(world->vx[k]);
+            }
+            if (world->vy[k] != 0 && fabsf(world->vy[k]) < minPostCollisionVel) {
+                world->vy[k] *= minPostCollisionVel / fabsf(world->vy[k]);
+            }
+            world->restSteps[k] = 0;
+            hits++;
+        }
+    }
+    return hits;
+}
+
+// Integration work shared by the tasks
+typedef struct {
+    CircleWorld* world;
+    float dt;
+    float width, height;
+} IntegrateJob;
+
+// Bounces body i off whichever screen edge it crossed
+// Velocity after hitting an edge at speed into it, the same rule as between bodies
+static float edgeBounce(const CircleWorld* world, float speed) {
+    return speed > bounceSpeed(world) ? -world->restitution * speed : 0;
+}
+
+// Puts a body back inside the screen. Only velocity into an edge is turned round, so a body
+// pushed against an edge while moving away from it keeps going.
+static void bounceOffEdges(CircleWorld* world, int i, float width, float height) {
+    float r = world->r[i];
+
+    // right
+    if (world->x[i] >= width - r) {
+        if (world->vx[i] > 0) world->vx[i] = edgeBounce(world, world->vx[i]);
+        world->x[i] = width - r;
+    }
+    // left
+    else if (world->x[i] <= r) {
+        if (world->vx[i] < 0) world->vx[i] = -edgeBounce(world, -world->vx[i]);
+        world->x[i] = r;
+    }
+    // bottom
+    if (world->y[i] >= height - r) {
+        if (world->vy[i] > 0) world->vy[i] = edgeBounce(world, world->vy[i]);
+        world->y[i] = height - r;
+    }
+    // top
+    else if (world->y[i] <= r) {
+        if (world->vy[i] < 0) world->vy[i] = -edgeBounce(world, -world->vy[i]);
+        world->y[i] = r;
+    }
+}
+
+static void integrateTask(void* data, int task) {
+    IntegrateJob* job = data;
+    CircleWorld* world = job->world;
+    int begin = task * INTEGRATE_BLOCK;
+    int end = begin + INTEGRATE_BLOCK < world->awakeCount ? begin + INTEGRATE_BLOCK : world->awakeCount;
+    float damping = 1.0f / (1.0f + world->linearDamping * job->dt);
+    float dtSq = job->dt * job->dt;
+    uint8_t* fast = world->scratch->fast;
+
+    for (int i = begin; i < end; i++) {
+        world->vx[i] *= damping;
+        world->vy[i] *= damping;
+
+        // too fast to move in one jump, the swept pass moves it
+        float reach = world->ccdFraction * world->r[i];
+        fast[i] = reach > 0 && (world->vx[i] * world->vx[i] + world->vy[i] * world->vy[i]) * dtSq > reach * reach;
+        if (fast[i]) {
+            continue;
+        }
+
+        // Update position based on velocity
+        world->x[i] += world->vx[i] * job->dt;
+        world->y[i] += world->vy[i] * job->dt;
+
+        // Handle boundaries
+        bounceOffEdges(world, i, job->width, job->height);
+    }
+}
+
+// Earliest fraction of the move (dx, dy) at which circle (x, y, r) touches circle (qx, qy, qr),
+// or 1 when it never does. Pairs already overlapping or separating are left to the contact solver.
+static float timeOfImpact(float x, float y, float r, float dx, float dy, float qx, float qy, float qr) {
+    float px = x - qx, py = y - qy;
+    float reach = r + qr;
+    float b = px * dx + py * dy;
+    float c = px * px + py * py - reach * reach;
+    if (b >= 0 || c <= 0) {
+        return 1.0f;
+    }
+    float a = dx * dx + dy * dy;
+    float disc = b * b - a * c;
+    if (disc < 0) {
+        return 1.0f;
+    }
+    float t = (-b - sqrtf(disc)) / a;
+    return t < 1.0f ? t : 1.0f;
+}
+
+enum { SWEEP_AWAKE, SWEEP_SLEEPING, SWEEP_FAST }; // which grid sweepGrid searches
+
+// Finds the first body of grid g hit by body i moving (dx, dy). The awake and sleeping grids hold
+// positions from before integration, so their search reaches as far as a slow body can have moved
+// since; the swept grid already stores every fast body with the reach of its whole move.
+static void sweepGrid(const CircleWorld* world, const SortedGrid* g, int i, float dx, float dy,
+                      int kind, float* toi, int* hit) {
+    const uint8_t* fast = world->scratch->fast;
+    float x = world->x[i], y = world->y[i], r = world->r[i];
+    float halfLength = 0.5f * sqrtf(dx * dx + dy * dy);
+    float reach = r + halfLength + (kind == SWEEP_FAST ? 0 : world->ccdFraction * g->maxR);
+    int cx0, cy0, cx1, cy1;
+    if (!gridCellRange(g, x + 0.5f * dx, y + 0.5f * dy, reach, &cx0, &cy0, &cx1, &cy1)) {
+        return;
+    }
+
+    for (int cy = cy0; cy <= cy1; cy++) {
+        int start = g->cellStart[cy * g->cols + cx0], end = g->cellStart[cy * g->cols + cx1 + 1];
+        for (int k = start; k < end; k++) {
+            int j = kind == SWEEP_SLEEPING ? world->handleIndex[g->sItem[k]] : g->sItem[k];
+            if (j == i || (kind == SWEEP_AWAKE && fast[j])) {
+                continue; // fast bodies have left their cells, the swept grid has them
+            }
+            float t = timeOfImpact(x, y, r, dx, dy, world->x[j], world->y[j], world->r[j]);
+            if (t < *toi) {
+                *toi = t;
+                *hit = j;
+            }
+        }
+    }
+}
+
+// Moves fast body i through the substep one impact at a time: it advances to the earliest
+// contact with an edge or another body, bounces, and continues with the time left. Other bodies
+// hold still meanwhile, they have moved less than a fraction of their radius.
+static void sweepBody(CircleWorld* world, int i, float dt, float width, float height) {
+    CircleWorldScratch* s = world->scratch;
+    float r = world->r[i];
+    float remaining = dt;
+
+    for (int impacts = 0; impacts < CCD_MAX_HITS && remaining > 0; impacts++) {
+        float x = world->x[i], y = world->y[i];
+        float dx = world->vx[i] * remaining, dy = world->vy[i] * remaining;
+        float toi = 1.0f;
+        int hit = -1;
+        int wall = 0; // 1 for a vertical edge, 2 for a horizontal one
+
+        if (dx > 0 && x + dx > width - r) {
+            toi = (width - r - x) / dx;
+            wall = 1;
+        } else if (dx < 0 && x + dx < r) {
+            toi = (r - x) / dx;
+            wall = 1;
+        }
+        if (dy > 0 && y + dy > height - r && (height - r - y) / dy < toi) {
+            toi = (height - r - y) / dy;
+            wall = 2;
+        } else if (dy < 0 && y + dy < r && (r - y) / dy < toi) {
+            toi = (r - y) / dy;
+            wall = 2;
+        }
+
+        sweepGrid(world, &s->awake, i, dx, dy, SWEEP_AWAKE, &toi, &hit);
+        if (world->awakeCount < world->count) {
+            sweepGrid(world, &s->sleeping, i, dx, dy, SWEEP_SLEEPING, &toi, &hit);
+        }
+        sweepGrid(world, &s->swept, i, dx, dy, SWEEP_FAST, &toi, &hit);
+
+        toi = toi > 0 ? toi : 0;
+        world->x[i] = x + dx * toi;
+        world->y[i] = y + dy * toi;
+        remaining -= remaining * toi;
+
+        if (hit >= 0) {
+            if (hit >= world->awakeCount) {
+                int id = world->bodyHandle[hit];
+                wakeIsland(world, id, 0);
+                hit = world->handleIndex[id];
+            }
+
+            // elastic response along the line of centres
+            float nx = world->x[hit] - world->x[i], ny = world->y[hit] - world->y[i];
+            float dist = sqrtf(nx * nx + ny * ny);
+            float invMassSum = world->invMass[i] + world->invMass[hit];
+            if (dist > 0 && invMassSum > 0) {
+                nx /= dist;
+                ny /= dist;
+                float vn = (world->vx[hit] - world->vx[i]) * nx + (world->vy[hit] - world->vy[i]) * ny;
+                if (vn < 0) {
+                    float bounce = vn < -bounceSpeed(world) ? world->restitution : 0;
+                    float impulse = -(1.0f + bounce) * vn / invMassSum;
+                    world->vx[i] -= nx * impulse * world->invMass[i];
+                    world->vy[i] -= ny * impulse * world->invMass[i];
+                    world->vx[hit] += nx * impulse * world->invMass[hit];
+                    world->vy[hit] += ny * impulse * world->invMass[hit];
+                }
+            }
+            world->restSteps[hit] = 0;
+        } else if (wall == 1) {
+            world->vx[i] = world->vx[i] > 0 ? edgeBounce(world, world->vx[i]) : -edgeBounce(world, -world->vx[i]);
+        } else if (wall == 2) {
+            world->vy[i] = world->vy[i] > 0 ? edgeBounce(world, world->vy[i]) : -edgeBounce(world, -world->vy[i]);
+        } else {
+            break; // reached the end of the substep
+        }
+    }
+
+    // rounding can leave the body a hair past an edge
+    bounceOffEdges(world, i, width, height);
+}
+
+void integrateCircles(CircleWorld* world, float dt, float width, float height) {
+    IntegrateJob job = {world, dt, width, height};
+    int n = world->awakeCount;
+    runTasks(world->pool, (n + INTEGRATE_BLOCK - 1) / INTEGRATE_BLOCK, integrateTask, &job);
+
+    // the few fast bodies are swept one after the other, in index order so runs stay deterministic.
+    // Bodies they wake land past n and keep still until the next substep.
+    CircleWorldScratch* s = world->scratch;
+    int fastCount = 0;
+    for (int i = 0; i < n; i++) {
+        if (s->fast[i]) {
+            // a bounce turns the move but never takes the body further than |v| * dt from its start
+            float speed = sqrtf(world->vx[i] * world->vx[i] + world->vy[i] * world->vy[i]);
+            s->sweepX[fastCount] = world->x[i];
+            s->sweepY[fastCount] = world->y[i];
+            s->sweepR[fastCount] = world->r[i] + speed * dt;
+            s->sweptBodies[fastCount++] = i;
+        }
+    }
+    if (fastCount == 0) {
+        return;
+    }
+    fillGrid(&s->swept, s->sweepX, s->sweepY, s->sweepR, fastCount, s->sweptBodies, 0);
+    for (int k = 0; k < fastCount; k++) {
+        sweepBody(world, s->sweptBodies[k], dt, width, height);
+    }
+    world->stats.sweptBodies += fastCount;
+}
+
+static int findIsland(int* parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// Groups the awake bodies into contact islands and sends every island whose bodies have all
+// rested for sleepSteps to sleep. A resting island that leans on sleeping bodies wakes them
+// instead (already counted as rested), so the whole pile goes to sleep together next step.
+static void updateSleep(CircleWorld* world) {
+    CircleWorldScratch* s = world->scratch;
+    int n = world->awakeCount;
+    float sleepSq = restSpeed(world) * restSpeed(world);
+    int* parent = s->islandParent;
+    uint8_t* blocked = s->islandBlocked;
+
+    for (int i = 0; i < n; i++) {
+        bool resting = world->vx[i] * world->vx[i] + world->vy[i] * world->vy[i] < sleepSq;
+        world->restSteps[i] = resting ? world->restSteps[i] + 1 : 0;
+        parent[i] = i;
+        blocked[i] = 0;
+    }
+
+    // the contacts are from the last substep, gathered again by the caller if bodies woke since
+    for (int k = 0; k < world->contactCount; k++) {
+        int a = world->contacts[k].a, b = world->contacts[k].b;
+        if (b < n) {
+            int ra = findIsland(parent, a), rb = findIsland(parent, b);
+            if (ra != rb) {
+                // the lower index becomes the root so islands do not depend on contact order
+                if (ra < rb) parent[rb] = ra; else parent[ra] = rb;
+            }
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        if (world->restSteps[i] < world->sleepSteps) {
+            blocked[findIsland(parent, i)] = 1;
+        }
+    }
+
+    // collect the sleeping neighbours of resting islands before anything is reordered,
+    // the awake grid's item array is free until the next findContacts rebuilds it
+    int wakeCount = 0;
+    int* wakeIds = s->awake.sItem;
+    for (int k = 0; k < world->contactCount && wakeCount < world->capacity; k++) {
+        int a = world->contacts[k].a, b = world->contacts[k].b;
+        int root = findIsland(parent, a);
+        if (b >= n && blocked[root] != 1) {
+            blocked[root] = 2; // stays awake this step, sleeps with its neighbours next step
+            wakeIds[wakeCount++] = world->bodyHandle[b];
+        }
+    }
+
+    // link each ready island into a circular list of handle ids around its root
+    for (int i = 0; i < n; i++) {
+        int root = findIsland(parent, i);
+        if (blocked[root]) {
+            continue;
+        }
+        int id = world->bodyHandle[i], rootId = world->bodyHandle[root];
+        if (i == root) {
+            world->islandNext[id] = id;
+            world->islandPrev[id] = id;
+        } else {
+            world->islandNext[id] = world->islandNext[rootId];
+            world->islandPrev[id] = rootId;
+            world->islandPrev[world->islandNext[rootId]] = id;
+            world->islandNext[rootId] = id;
+        }
+    }
+
+    // move the ready islands out of the awake range, back to front so unvisited slots stay put
+    for (int i = n - 1; i >= 0; i--) {
+        if (blocked[findIsland(parent, i)]) {
+            continue;
+        }
+        world->vx[i] = 0;
+        world->vy[i] = 0;
+        world->prevX[i] = world->x[i];
+        world->prevY[i] = world->y[i];
+        world->awakeCount--;
+        swapBodies(world, i, world->awakeCount);
+        s->sleepingDirty = true;
+    }
+
+    for (int k = 0; k < wakeCount; k++) {
+        wakeIsland(world, wakeIds[k], world->sleepSteps);
+    }
+}
+
+// Adds the world's constant acceleration to every awake body for one substep
+static void accelerate(CircleWorld* world, float dt) {
+    if (world->gravityX == 0 && world->gravityY == 0) {
+        return;
+    }
+    for (int i = 0; i < world->awakeCount; i++) {
+        world->vx[i] += world->gravityX * dt;
+        world->vy[i] += world->gravityY * dt;
+    }
+}
+
+void stepCircleWorld(CircleWorld* world, float dt, int substeps, float width, float height) {
+    memcpy(world->prevX, world->x, sizeof(float) * world->awakeCount);
+    memcpy(world->prevY, world->y, sizeof(float) * world->awakeCount);
+
+    world->stats.positionIterations = 0;
+    world->stats.sweptBodies = 0;
+    world->scratch->gravitySpeed = 2.0f * sqrtf(world->gravityX * world->gravityX + world->gravityY * world->gravityY) * dt;
+    float subDt = dt / substeps;
+    int awakeBefore = world->awakeCount;
+    for (int i = 0; i < substeps; i++) {
+        // gravity goes in every substep, so each substep's contacts hold the same weight and the
+        // impulses cached from the last one are the right start for this one
+        accelerate(world, subDt);
+
+        // gather the touching pairs once, then solve them in independent batches
+        findContacts(world);
+        findEdgeContacts(world, width, height);
+        resolveCollisions(world);
+        correctPositions(world);
+        awakeBefore = world->awakeCount;
+        integrateCircles(world, subDt, width, height);
+    }
+
+    if (world->sleepSteps > 0) {
+        // a swept body that woke an island moved sleeping bodies into new slots, so the contacts
+        // gathered before it no longer point at the right bodies and are gathered again
+        if (world->awakeCount != awakeBefore) {
+            int candidatePairs = world->stats.candidatePairs;
+            findContacts(world);
+            world->stats.candidatePairs = candidatePairs;
+        }
+        updateSleep(world);
+    }
+}
@@ -0,0 +1,156 @@
+#ifndef CIRCLE_WORLD_H
+#define CIRCLE_WORLD_H
+
+#include <stdbool.h>
+
+#include "threadPool.h"
+
+#define MAX_CONTACT_COLOURS 32 // contacts that cannot be coloured go in the last, serial batch
+#define MAX_ATTACHED_ARRAYS 8  // per-body arrays owned by the caller but grown and moved by the world
+
+// Stable reference to a body. Dense indices change when bodies are removed,
+// handles do not; a handle goes stale once its body is removed.
+typedef struct {
+    int id;         // slot in the handle table, -1 for none
+    int generation; // must match the slot's generation to be valid
+} CircleHandle;
+
+// A touching pair found by findContacts
+typedef struct {
+    int a, b;        // body indices
+    float nx, ny;    // unit normal from a to b
+    float targetVn;  // normal velocity the solver aims for (restitution)
+    float impulse;   // accumulated normal impulse this step
+    float tangentImpulse; // accumulated friction impulse this step
+    float overlap;   // penetration seen by the last position iteration
+} Contact;
+
+// What the solver did during the last stepCircleWorld
+typedef struct {
+    int contacts;           // contacts in the last substep
+    int candidatePairs;     // awake pairs the grid handed to the narrowphase in the last substep
+    int positionIterations; // position iterations run over all substeps, early exits included
+    float maxOverlap;       // deepest penetration seen by the last position iteration, in pixels
+    float averageOverlap;   // mean penetration over the same contacts
+    int sweptBodies;        // bodies moved by continuous collision over all substeps
+} SolverStats;
+
+typedef struct CircleWorldScratch CircleWorldScratch;
+
+// Body state for the circle simulation, stored as a structure of arrays so the
+// narrowphase can load 8 bodies per register. Bodies are kept dense in [0, count):
+// removal moves the last body into the hole. Awake bodies come first, sleeping ones
+// fill [awakeCount, count) and are skipped by integration and the broadphase.
+// Render-only data (colours etc.) lives with the program that draws the circles
+// in arrays attached with attachBodyArray.
+typedef struct {
+    float* x;       // position
+    float* y;
+    float* vx;      // velocity in pixels per second
+    float* vy;
+    float* invMass; // 1 / mass, 0 for immovable bodies
+    float* r;       // radius
+    float* prevX;   // position before the last step, NAN until a body's first step; read through interpolateCircle
+    float* prevY;
+    int* restSteps; // physics steps the body has been slower than sleepVelocity
+    int count;      // number of live bodies
+    int awakeCount; // bodies [0, awakeCount) are simulated
+    int capacity;   // size of every array above, doubles when full
+
+    // handle table: id -> dense index for live ids, next free id for free ones
+    int* handleIndex;
+    int* handleGeneration;
+    int* bodyHandle; // dense index -> id
+    int handleCount; // ids ever handed out
+    int freeHandle;  // head of the free id list, -1 when empty
+
+    // sleeping islands as circular lists of handle ids
+    int* islandNext;
+    int* islandPrev;
+
+    void** attached[MAX_ATTACHED_ARRAYS];
+    size_t attachedSize[MAX_ATTACHED_ARRAYS];
+    int attachedCount;
+
+    // solver settings
+    int solverIterations;     // velocity iterations per substep
+    bool warmStarting;        // start approaching contacts from last substep's impulse
+    int positionIterations;   // most position iterations per substep, stops early once the overlaps are down to about positionSlop
+    float positionRelaxation; // fraction of the overlap removed per iteration
+    float positionSlop;       // overlap in pixels left alone, keeps resting contacts from jittering
+    float restitution;        // 1 = perfectly elastic, for the edges as well as between bodies
+    float bounceVelocity;     // approach speed in pixels per second below which contacts and edges stop instead of bouncing, at least twice what gravity adds in a step
+    float friction;           // Coulomb friction between bodies and against the edges, 0 = frictionless
+    float ccdFraction;        // bodies moving further than this fraction of their radius per substep are swept, 0 disables
+    float linearDamping;  // fraction of velocity lost per second, 0 = none
+    float gravityX;       // constant acceleration of every awake body in pixels per second^2, added each substep
+    float gravityY;
+    float sleepVelocity;  // speed (pixels per second) under which a body counts as resting, at least twice what gravity adds in a step
+    int sleepSteps;       // steps a whole island must rest before it sleeps, 0 disables sleeping
+    ThreadPool* pool;     // NULL runs everything on the calling thread
+
+    // contacts from the last findContacts, grouped into batches that share no body
+    Contact* contacts;
+    int contactCount;
+    int contactCapacity;
+    int batchStart[MAX_CONTACT_COLOURS + 1];
+    SolverStats stats;
+
+    CircleWorldScratch* scratch; // broadphase and colouring buffers
+} CircleWorld;
+
+bool initCircleWorld(CircleWorld* world, int capacity); // Allocates room for capacity bodies to start with
+void freeCircleWorld(CircleWorld* world); // Frees the body arrays (attached arrays too)
+
+// Registers a caller-owned per-body array (*array must be NULL) that the world keeps
+// sized to its capacity and reorders together with the bodies
+bool attachBodyArray(CircleWorld* world, void** array, size_t elementSize);
+
+// Appends a body, growing the world if needed. Returns an invalid handle (id -1) when out of memory.
+CircleHandle addCircle(CircleWorld* world, float x, float y, float vx, float vy, float mass, float radius);
+
+// Makes room for count new awake bodies at dense indices [first, first + count) and returns first,
+// or -1 when out of memory. The caller fills x, y, vx, vy, invMass and r for the new bodies.
+int reserveCircles(CircleWorld* world, int count);
+
+// Where to draw body i a fraction alpha of the way through the frame, between its positions before
+// and after the last step. A body added since then has no previous position and is drawn where it is.
+void interpolateCircle(const CircleWorld* world, int i, float alpha, float* x, float* y);
+
+// Removes a body in O(1) by moving the last body into its slot. False if the handle is stale.
+bool removeCircle(CircleWorld* world, CircleHandle handle);
+
+int circleIndex(const CircleWorld* world, CircleHandle handle); // Dense index of a handle, -1 if stale
+CircleHandle circleHandle(const CircleWorld* world, int index); // Handle of the body at a dense index
+
+// Sleeping bodies wake when a moving body or collideProbe touches their island
+bool isCircleAsleep(const CircleWorld* world, CircleHandle handle);
+void wakeCircle(CircleWorld* world, CircleHandle handle); // Wakes the body and the island it sleeps in
+
+// True if a circle at (x, y) with radius r overlaps any body in the world
+bool circleOverlapsAny(const CircleWorld* world, float x, float y, float r);
+
+// Gathers every touching pair into world->contacts and splits them into independent batches
+void findContacts(CircleWorld* world);
+
+// Elastic velocity response for the gathered contacts, warm started from a cache of the
+// previous substep's impulses keyed by handle pair
+void resolveCollisions(CircleWorld* world);
+
+// Pushes the gathered overlapping pairs apart in mass-weighted, relaxed iterations
+void correctPositions(CircleWorld* world);
+
+// Collides a kinematic probe (e.g. the mouse) with every body, returns the number of bodies hit
+int collideProbe(CircleWorld* world, float x, float y, float vx, float vy, float mass, float radius);
+
+// Moves every awake body by velocity * dt and bounces it off the screen edges. A body that would
+// move further than ccdFraction of its radius is swept instead, from one time of impact to the
+// next against the edges and the bodies in the grid of the last findContacts, so it cannot jump
+// over them. Only those bodies pay for the sweep.
+void integrateCircles(CircleWorld* world, float dt, float width, float height);
+
+// One fixed physics step of dt seconds, split into substeps passes of contacts + integration,
+// then puts the islands that have rested long enough to sleep
+void stepCircleWorld(CircleWorld* world, float dt, int substeps, float width, float height);
+
+#endif
@@ -1,19 +1,15 @@
-// gcc -O3 -I src/include -L src/lib -o main deep.c -lmingw32 -lSDL2main -lSDL2 -lSDL2_ttf -lSDL2_image -lSDL2_mixer
+// gcc -O3 -I src/include -L src/lib -o main deep.c arcTessellator.c -lmingw32 -lSDL2main -lSDL2 -lSDL2_ttf -lSDL2_image -lSDL2_mixer
 
 #include <SDL2/SDL.h>
 #include <math.h>
 
-#define PI 3.14159265358979323846
+#include "arcTessellator.h"
 
-// Helper function to convert degrees to radians
-double deg_to_rad(double degrees) {
-    return degrees * M_PI / 180.0;
-}
+#define PI 3.14159265358979323846
+#define ARC_MAX_ERROR 0.35f // pixels the arc's segments may fall short of the true curve
+#define MAX_ARC_POINTS 257 // a whole circle at the most segments the tessellator uses, and its closing point
 
-// Helper function to calculate angle between two points
-double get_angle(int x1, int y1, int x2, int y2) {
-    return atan2(y2 - y1, x2 - x1) * 180.0 / M_PI;
-}
+ArcTessellator arcTessellator;
 
 // Draw an arc from start point to end point with given radius
 void draw_arc(SDL_Renderer* renderer, int center_x, int center_y, 
@@ -23,40 +19,27 @@ void draw_arc(SDL_Renderer* renderer, int center_x, int center_y,
     // Set the draw color
     SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
     
-    // Calculate start and end angles
-    double start_angle = get_angle(center_x, center_y, start_x, start_y);
-    double end_angle = get_angle(center_x, center_y, end_x, end_y);
-    
-    // Ensure end angle is greater than start angle
-    if (end_angle < start_angle) {
-        end_angle += 360.0;
+    // Directions of both points from the centre; the arc turns from the first to the second
+    // the same way angles grow on screen, so the sweep is between 0 and a whole turn
+    float from_x = start_x - center_x, from_y = start_y - center_y;
+    float to_x = end_x - center_x, to_y = end_y - center_y;
+    float length = sqrtf(from_x * from_x + from_y * from_y);
+    if (length <= 0) {
+        return;
+    }
+    float sweep = atan2f(from_x * to_y - from_y * to_x, from_x * to_x + from_y * to_y);
+    if (sweep < 0) {
+        sweep += 2 * PI;
     }
     
-    // Number of segments to draw (more segments = smoother arc)
-    const int segments = 120;
-    double angle_step = (end_angle - start_angle) / segments;
-    
-    // Variables to store the previous point
-    int prev_x = 0;
-    int prev_y = 0;
-    
-    // Draw the arc segment by segment
-    for (int i = 0; i <= segments; i++) {
-        double angle = deg_to_rad(start_angle + (i * angle_step));
-        int x = center_x + (int)(radius * cos(angle));
-        int y = center_y + (int)(radius * sin(angle));
-        
-        if (i > 0) {
-            // Draw line from previous point to current point
-            SDL_RenderDrawLine(renderer, 
-                             prev_x, prev_y,
-                             x, y);
-        }
-        
-        // Store current point as previous for next iteration
-        prev_x = x;
-        prev_y = y;
+    // As many segments as the radius needs to look round, not a fixed 120
+    int segments = arcSegmentCount(&arcTessellator, radius, sweep);
+    if (segments > MAX_ARC_POINTS - 1) {
+        segments = MAX_ARC_POINTS - 1;
     }
+    SDL_FPoint points[MAX_ARC_POINTS];
+    int count = tessellateArc(center_x, center_y, radius, from_x / length, from_y / length, sweep, segments, points);
+    SDL_RenderDrawLinesF(renderer, points, count);
 }
 
 int main(int argc, char* argv[]) {
@@ -64,6 +47,7 @@ int main(int argc, char* argv[]) {
 
     SDL_Window* window = SDL_CreateWindow("Circle Arc", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1392, 744, 0);
     SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    initArcTessellator(&arcTessellator, ARC_MAX_ERROR);
 
     // Clear the screen
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
@@ -83,6 +67,7 @@ int main(int argc, char* argv[]) {
     SDL_Delay(5000);
 
     // Clean up
+    freeArcTessellator(&arcTessellator);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -0,0 +1,36 @@
+// Fixed physics timestep driven by SDL's high resolution counter.
+
+#include "fixedTimestep.h"
+
+void initFixedTimestep(FixedTimestep* step, double fixedDt, int substeps) {
+    step->fixedDt = fixedDt;
+    step->substeps = substeps > 0 ? substeps : 1;
+    step->maxFrameTime = 0.25;
+    step->maxSteps = 8;
+
+    step->accumulator = 0;
+    step->frameTime = 0;
+    step->alpha = 0;
+    step->lastCounter = SDL_GetPerformanceCounter();
+}
+
+int beginFrame(FixedTimestep* step) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    step->frameTime = (double)(now - step->lastCounter) / SDL_GetPerformanceFrequency();
+    step->lastCounter = now;
+
+    // a long stall (window drag, breakpoint) must not make the next frame simulate seconds
+    double elapsed = step->frameTime < step->maxFrameTime ? step->frameTime : step->maxFrameTime;
+    step->accumulator += elapsed;
+
+    int steps = (int)(step->accumulator / step->fixedDt);
+    if (steps > step->maxSteps) {
+        // too slow to keep up: run what we can afford and let the world slow down gracefully
+        steps = step->maxSteps;
+        step->accumulator = step->fixedDt * steps;
+    }
+    step->accumulator -= step->fixedDt * steps;
+
+    step->alpha = step->accumulator / step->fixedDt;
+    return steps;
+}
@@ -0,0 +1,26 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+#include <SDL2/SDL.h>
+
+// Decouples the simulation rate from the frame rate. Each frame the real elapsed time is
+// added to an accumulator and consumed in fixed steps; whatever is left over becomes the
+// interpolation factor between the previous and current physics state.
+typedef struct {
+    double fixedDt;      // seconds per physics step
+    int substeps;        // solver passes per physics step
+    double maxFrameTime; // frames longer than this are clamped (spiral-of-death guard)
+    int maxSteps;        // physics steps allowed per frame, leftover time is dropped
+
+    double accumulator;
+    double frameTime;    // real seconds since the previous frame
+    double alpha;        // 0..1 blend from the previous to the current state
+    Uint64 lastCounter;
+} FixedTimestep;
+
+void initFixedTimestep(FixedTimestep* step, double fixedDt, int substeps);
+
+// Samples the clock and returns how many fixed steps to run this frame
+int beginFrame(FixedTimestep* step);
+
+#endif
@@ -0,0 +1,427 @@
+#include "geometryBatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MAX_JOIN_POINTS 130 // a round join turns at most half a circle of at most 256 segments
+
+void initGeometryBatch(GeometryBatch* batch, float maxError) {
+    memset(batch, 0, sizeof(*batch));
+    initArcTessellator(&batch->arcs, maxError);
+}
+
+void freeGeometryBatch(GeometryBatch* batch) {
+    free(batch->vertices);
+    free(batch->indices);
+    freeArcTessellator(&batch->arcs);
+    memset(batch, 0, sizeof(*batch));
+}
+
+// Makes room for vertexCount more vertices and indexCount more indices, doubling as needed
+static bool reserveGeometry(GeometryBatch* batch, int vertexCount, int indexCount) {
+    if (batch->vertexCount + vertexCount > batch->vertexCapacity) {
+        int capacity = batch->vertexCapacity > 0 ? batch->vertexCapacity : 1024;
+        while (capacity < batch->vertexCount + vertexCount) {
+            capacity *= 2;
+        }
+        SDL_Vertex* grown = realloc(batch->vertices, sizeof(SDL_Vertex) * capacity);
+        if (grown == NULL) {
+            return false;
+        }
+        batch->vertices = grown;
+        batch->vertexCapacity = capacity;
+    }
+    if (batch->indexCount + indexCount > batch->indexCapacity) {
+        int capacity = batch->indexCapacity > 0 ? batch->indexCapacity : 4096;
+        while (capacity < batch->indexCount + indexCount) {
+            capacity *= 2;
+        }
+        int* grown = realloc(batch->indices, sizeof(int) * capacity);
+        if (grown == NULL) {
+            return false;
+        }
+        batch->indices = grown;
+        batch->indexCapacity = capacity;
+    }
+    return true;
+}
+
+int circleSegments(const GeometryBatch* batch, float radius) {
+    return circleSegmentCount(&batch->arcs, radius);
+}
+
+// Writes count points of a circle starting at angle 0, scaled from the unit circle of that many segments
+static void writeRim(SDL_Vertex* out, const SDL_FPoint* unit, int count, float x, float y, float radius, SDL_Color colour) {
+    for (int k = 0; k < count; k++) {
+        out[k].position.x = x + unit[k].x * radius;
+        out[k].position.y = y + unit[k].y * radius;
+        out[k].color = colour;
+        out[k].tex_coord.x = 0;
+        out[k].tex_coord.y = 0;
+    }
+}
+
+bool batchFilledCircle(GeometryBatch* batch, float x, float y, float radius, SDL_Color colour) {
+    int segments = circleSegments(batch, radius);
+    const SDL_FPoint* unit = unitCircle(&batch->arcs, segments);
+    if (unit == NULL || !reserveGeometry(batch, segments + 1, segments * 3)) {
+        return false;
+    }
+
+    int centre = batch->vertexCount;
+    SDL_Vertex* v = &batch->vertices[centre];
+    v->position.x = x;
+    v->position.y = y;
+    v->color = colour;
+    v->tex_coord.x = 0;
+    v->tex_coord.y = 0;
+    writeRim(v + 1, unit, segments, x, y, radius, colour);
+
+    int* index = &batch->indices[batch->indexCount];
+    for (int k = 0; k < segments; k++) {
+        *index++ = centre;
+        *index++ = centre + 1 + k;
+        *index++ = centre + 1 + (k + 1 < segments ? k + 1 : 0);
+    }
+
+    batch->vertexCount += segments + 1;
+    batch->indexCount += segments * 3;
+    return true;
+}
+
+bool batchCircleOutline(GeometryBatch* batch, float x, float y, float radius, float thickness, SDL_Color colour) {
+    float inner = radius - thickness > 0 ? radius - thickness : 0;
+    int segments = circleSegments(batch, radius);
+    const SDL_FPoint* unit = unitCircle(&batch->arcs, segments);
+    if (unit == NULL || !reserveGeometry(batch, segments * 2, segments * 6)) {
+        return false;
+    }
+
+    // outer rim followed by the inner rim, quad k joins rim points k and k + 1 of both
+    int first = batch->vertexCount;
+    writeRim(&batch->vertices[first], unit, segments, x, y, radius, colour);
+    writeRim(&batch->vertices[first + segments], unit, segments, x, y, inner, colour);
+
+    int* index = &batch->indices[batch->indexCount];
+    for (int k = 0; k < segments; k++) {
+        int next = k + 1 < segments ? k + 1 : 0;
+        int outerA = first + k, outerB = first + next;
+        int innerA = first + segments + k, innerB = first + segments + next;
+        *index++ = outerA;
+        *index++ = outerB;
+        *index++ = innerA;
+        *index++ = innerA;
+        *index++ = outerB;
+        *index++ = innerB;
+    }
+
+    batch->vertexCount += segments * 2;
+    batch->indexCount += segments * 6;
+    return true;
+}
+
+static void writeVertex(SDL_Vertex* v, float x, float y, SDL_Color colour) {
+    v->position.x = x;
+    v->position.y = y;
+    v->color = colour;
+    v->tex_coord.x = 0;
+    v->tex_coord.y = 0;
+}
+
+bool batchCircleShadow(GeometryBatch* batch, float lightX, float lightY, float lightRadius,
+                       float x, float y, float radius, float length, SDL_Color colour) {
+    float toLightX = lightX - x, toLightY = lightY - y;
+    float distanceSquared = toLightX * toLightX + toLightY * toLightY;
+    if (distanceSquared <= radius * radius) {
+        return true;
+    }
+
+    // u points from the centre to the light and p across it. The tangent points sit at angle
+    // +-a from u, with cos(a) = radius / distance, so only the cap's step needs a cosf/sinf.
+    float distance = sqrtf(distanceSquared);
+    float ux = toLightX / distance, uy = toLightY / distance;
+    float px = -uy, py = ux;
+    float cosA = radius / distance;
+    float sinA = sqrtf(1.0f - cosA * cosA);
+    float a = acosf(cosA);
+
+    int arcSegments = arcSegmentCount(&batch->arcs, radius, 2.0f * a);
+    bool fringe = lightRadius > 0;
+    int vertexCount = arcSegments + 1 + 2 + (fringe ? 2 : 0);
+    int indexCount = (arcSegments - 1) * 3 + 6 + (fringe ? 6 : 0);
+    if (!reserveGeometry(batch, vertexCount, indexCount)) {
+        return false;
+    }
+
+    // the arc facing the light, from the tangent point on the +p side round to the other one
+    int first = batch->vertexCount;
+    SDL_Vertex* v = &batch->vertices[first];
+    float stepCos = cosf(2.0f * a / arcSegments), stepSin = sinf(2.0f * a / arcSegments);
+    float dirX = cosA * ux + sinA * px, dirY = cosA * uy + sinA * py;
+    for (int k = 0; k <= arcSegments; k++) {
+        writeVertex(&v[k], x + dirX * radius, y + dirY * radius, colour);
+        float rotated = dirX * stepCos + dirY * stepSin;
+        dirY = dirY * stepCos - dirX * stepSin;
+        dirX = rotated;
+    }
+
+    // the umbra edges run on from the tangent points directly away from the light's centre,
+    // and the fringes open outwards from them by the angle the light's disc covers there
+    SDL_Color clear = colour;
+    clear.a = 0;
+    int tangents[2] = {0, arcSegments};
+    for (int side = 0; side < 2; side++) {
+        SDL_Vertex* tangent = &v[tangents[side]];
+        float edgeX = tangent->position.x - lightX, edgeY = tangent->position.y - lightY;
+        float edgeLength = sqrtf(edgeX * edgeX + edgeY * edgeY);
+        edgeX /= edgeLength;
+        edgeY /= edgeLength;
+        writeVertex(&v[arcSegments + 1 + side], tangent->position.x + edgeX * length, tangent->position.y + edgeY * length, colour);
+
+        if (fringe) {
+            float spreadSin = lightRadius < edgeLength ? lightRadius / edgeLength : 1.0f;
+            float spreadCos = sqrtf(1.0f - spreadSin * spreadSin);
+            if (side == 0) spreadSin = -spreadSin; // away from the umbra is towards +p on this side
+            float outerX = edgeX * spreadCos - edgeY * spreadSin;
+            float outerY = edgeX * spreadSin + edgeY * spreadCos;
+            writeVertex(&v[arcSegments + 3 + side], tangent->position.x + outerX * length, tangent->position.y + outerY * length, clear);
+        }
+    }
+
+    int tangent1 = first, tangent2 = first + arcSegments;
+    int far1 = first + arcSegments + 1, far2 = far1 + 1;
+    int* index = &batch->indices[batch->indexCount];
+    for (int k = 1; k < arcSegments; k++) {
+        *index++ = tangent1;
+        *index++ = first + k;
+        *index++ = first + k + 1;
+    }
+    *index++ = tangent1;
+    *index++ = far1;
+    *index++ = tangent2;
+    *index++ = tangent2;
+    *index++ = far1;
+    *index++ = far2;
+    if (fringe) {
+        *index++ = tangent1;
+        *index++ = far1 + 2;
+        *index++ = far1;
+        *index++ = tangent2;
+        *index++ = far2;
+        *index++ = far2 + 2;
+    }
+
+    batch->vertexCount += vertexCount;
+    batch->indexCount += indexCount;
+    return true;
+}
+
+// The stroke of one segment from a to b along the unit direction (dx, dy): rows of vertices
+// across it at both ends, two wide or, when feathered, four with clear fringes outside, and at an
+// open end a clear row pushed out by the feather. Neighbouring rows are joined by quads.
+static bool batchStrokeSegment(GeometryBatch* batch, SDL_FPoint a, SDL_FPoint b, float dx, float dy, float half,
+                               float feather, bool capStart, bool capEnd, SDL_Color colour) {
+    float nx = -dy, ny = dx;
+    float across[4] = {half + feather, half, -half, -half - feather};
+    const float* offset = feather > 0 ? across : across + 1;
+    int columns = feather > 0 ? 4 : 2;
+
+    float rowX[4], rowY[4];
+    bool rowClear[4];
+    int rows = 0;
+    if (capStart && feather > 0) {
+        rowX[rows] = a.x - dx * feather;
+        rowY[rows] = a.y - dy * feather;
+        rowClear[rows++] = true;
+    }
+    rowX[rows] = a.x;
+    rowY[rows] = a.y;
+    rowClear[rows++] = false;
+    rowX[rows] = b.x;
+    rowY[rows] = b.y;
+    rowClear[rows++] = false;
+    if (capEnd && feather > 0) {
+        rowX[rows] = b.x + dx * feather;
+        rowY[rows] = b.y + dy * feather;
+        rowClear[rows++] = true;
+    }
+
+    int vertexCount = rows * columns, indexCount = (rows - 1) * (columns - 1) * 6;
+    if (!reserveGeometry(batch, vertexCount, indexCount)) {
+        return false;
+    }
+    SDL_Color clear = colour;
+    clear.a = 0;
+    int first = batch->vertexCount;
+    SDL_Vertex* v = &batch->vertices[first];
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < columns; c++) {
+            bool fringe = rowClear[r] || (feather > 0 && (c == 0 || c == columns - 1));
+            writeVertex(v++, rowX[r] + nx * offset[c], rowY[r] + ny * offset[c], fringe ? clear : colour);
+        }
+    }
+
+    int* index = &batch->indices[batch->indexCount];
+    for (int r = 0; r + 1 < rows; r++) {
+        for (int c = 0; c + 1 < columns; c++) {
+            int corner = first + r * columns + c;
+            *index++ = corner;
+            *index++ = corner + 1;
+            *index++ = corner + columns + 1;
+            *index++ = corner;
+            *index++ = corner + columns + 1;
+            *index++ = corner + columns;
+        }
+    }
+    batch->vertexCount += vertexCount;
+    batch->indexCount += indexCount;
+    return true;
+}
+
+// Fills the gap two strokes leave on the outside of the corner at p, arriving along the unit
+// direction (dx0, dy0) and leaving along (dx1, dy1): a fan from p over the corner's outline, with
+// a clear fringe pushed out from the outline when feathered. The inside of the corner is already
+// covered where the two strokes overlap.
+static bool batchJoin(GeometryBatch* batch, SDL_FPoint p, float dx0, float dy0, float dx1, float dy1,
+                      float half, LineJoin join, float feather, SDL_Color colour) {
+    float cross = dx0 * dy1 - dy0 * dx1, dot = dx0 * dx1 + dy0 * dy1;
+    if (fabsf(cross) < 1e-6f && dot > 0) {
+        return true; // straight on
+    }
+
+    // unit offsets from p to either stroke's edge on the outside of the turn
+    float side = cross > 0 ? -1.0f : 1.0f;
+    float ax = -dy0 * side, ay = dx0 * side;
+    float bx = -dy1 * side, by = dx1 * side;
+    float sumX = ax + bx, sumY = ay + by, sumSquared = sumX * sumX + sumY * sumY;
+
+    SDL_FPoint outline[MAX_JOIN_POINTS];
+    int count;
+    if (join == LINE_JOIN_ROUND) {
+        // the offsets are the directions turned a quarter, so they turn by the corner's angle too;
+        // the segments are for the outside of the fringe, the edge that shows
+        float sweep = atan2f(cross, dot);
+        int segments = arcSegmentCount(&batch->arcs, half + (feather > 0 ? feather : 0), sweep);
+        if (segments > MAX_JOIN_POINTS - 1) segments = MAX_JOIN_POINTS - 1;
+        count = tessellateArc(p.x, p.y, half, ax, ay, sweep, segments, outline);
+    } else {
+        count = 0;
+        outline[count++] = (SDL_FPoint){p.x + ax * half, p.y + ay * half};
+        // the two outer edges meet 2 / |a + b| half widths out along a + b
+        if (join == LINE_JOIN_MITER && sumSquared * MITER_LIMIT * MITER_LIMIT >= 4.0f) {
+            float reach = 2.0f * half / sumSquared;
+            outline[count++] = (SDL_FPoint){p.x + sumX * reach, p.y + sumY * reach};
+        }
+        outline[count++] = (SDL_FPoint){p.x + bx * half, p.y + by * half};
+    }
+
+    bool fringe = feather > 0;
+    int vertexCount = 1 + count * (fringe ? 2 : 1);
+    int indexCount = (count - 1) * (fringe ? 9 : 3);
+    if (!reserveGeometry(batch, vertexCount, indexCount)) {
+        return false;
+    }
+    SDL_Color clear = colour;
+    clear.a = 0;
+    int first = batch->vertexCount;
+    SDL_Vertex* v = &batch->vertices[first];
+    writeVertex(&v[0], p.x, p.y, colour);
+    for (int k = 0; k < count; k++) {
+        writeVertex(&v[1 + k], outline[k].x, outline[k].y, colour);
+        if (fringe) {
+            float ox = outline[k].x - p.x, oy = outline[k].y - p.y;
+            float scale = feather / sqrtf(ox * ox + oy * oy);
+            writeVertex(&v[1 + count + k], outline[k].x + ox * scale, outline[k].y + oy * scale, clear);
+        }
+    }
+
+    int* index = &batch->indices[batch->indexCount];
+    for (int k = 0; k + 1 < count; k++) {
+        int edge = first + 1 + k, outer = first + 1 + count + k;
+        *index++ = first;
+        *index++ = edge;
+        *index++ = edge + 1;
+        if (fringe) {
+            *index++ = edge;
+            *index++ = outer;
+            *index++ = outer + 1;
+            *index++ = edge;
+            *index++ = outer + 1;
+            *index++ = edge + 1;
+        }
+    }
+    batch->vertexCount += vertexCount;
+    batch->indexCount += indexCount;
+    return true;
+}
+
+bool batchPolyline(GeometryBatch* batch, const SDL_FPoint* points, int count, bool closed,
+                   float width, LineJoin join, float feather, SDL_Color colour) {
+    if (count < 2 || width <= 0) {
+        return true;
+    }
+    float half = width / 2.0f;
+    int segments = closed ? count : count - 1;
+
+    // an open polyline ends at its last segment with any length
+    int last = -1;
+    for (int s = segments - 1; s >= 0 && last < 0; s--) {
+        SDL_FPoint a = points[s], b = points[(s + 1) % count];
+        if (a.x != b.x || a.y != b.y) last = s;
+    }
+    if (last < 0) {
+        return true;
+    }
+
+    bool started = false;
+    SDL_FPoint start = points[0];
+    float firstDx = 0, firstDy = 0, lastDx = 0, lastDy = 0;
+    for (int s = 0; s <= last; s++) {
+        SDL_FPoint a = points[s], b = points[(s + 1) % count];
+        float dx = b.x - a.x, dy = b.y - a.y;
+        float length = sqrtf(dx * dx + dy * dy);
+        if (length <= 0) {
+            continue;
+        }
+        dx /= length;
+        dy /= length;
+
+        // a segment starts where the last one with any length ended, so the corner is at a
+        if (started) {
+            if (!batchJoin(batch, a, lastDx, lastDy, dx, dy, half, join, feather, colour)) return false;
+        } else {
+            start = a;
+            firstDx = dx;
+            firstDy = dy;
+        }
+        if (!batchStrokeSegment(batch, a, b, dx, dy, half, feather, !closed && !started, !closed && s == last, colour)) {
+            return false;
+        }
+        started = true;
+        lastDx = dx;
+        lastDy = dy;
+    }
+    return !closed || batchJoin(batch, start, lastDx, lastDy, firstDx, firstDy, half, join, feather, colour);
+}
+
+bool batchLine(GeometryBatch* batch, float x0, float y0, float x1, float y1, float width, float feather, SDL_Color colour) {
+    SDL_FPoint points[2] = {{x0, y0}, {x1, y1}};
+    return batchPolyline(batch, points, 2, false, width, LINE_JOIN_BEVEL, feather, colour);
+}
+
+void drawGeometryBatch(const GeometryBatch* batch, SDL_Renderer* renderer) {
+    if (batch->indexCount > 0) {
+        SDL_RenderGeometry(renderer, NULL, batch->vertices, batch->vertexCount, batch->indices, batch->indexCount);
+    }
+}
+
+void clearGeometryBatch(GeometryBatch* batch) {
+    batch->vertexCount = 0;
+    batch->indexCount = 0;
+}
+
+void flushGeometryBatch(GeometryBatch* batch, SDL_Renderer* renderer) {
+    drawGeometryBatch(batch, renderer);
+    clearGeometryBatch(batch);
+}
@@ -0,0 +1,70 @@
+#ifndef GEOMETRY_BATCH_H
+#define GEOMETRY_BATCH_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+#include "arcTessellator.h"
+
+// Collects filled shapes as coloured triangles in one vertex and index buffer, then draws
+// them all with a single SDL_RenderGeometry call. The buffers only grow, so once a frame's
+// worth of shapes fits, later frames draw without allocating.
+typedef struct {
+    SDL_Vertex* vertices;
+    int vertexCount;
+    int vertexCapacity;
+    int* indices;
+    int indexCount;
+    int indexCapacity;
+    ArcTessellator arcs; // largest gap between a circle and its polygon, and the unit circles the rims are scaled from
+} GeometryBatch;
+
+void initGeometryBatch(GeometryBatch* batch, float maxError);
+void freeGeometryBatch(GeometryBatch* batch);
+
+// Polygon sides needed for a circle of this radius to stay within the batch's maxError
+int circleSegments(const GeometryBatch* batch, float radius);
+
+// Adds a filled circle as a triangle fan around its centre. False when out of memory.
+bool batchFilledCircle(GeometryBatch* batch, float x, float y, float radius, SDL_Color colour);
+
+// Adds a ring thickness pixels wide whose outer edge has the given radius. False when out of memory.
+bool batchCircleOutline(GeometryBatch* batch, float x, float y, float radius, float thickness, SDL_Color colour);
+
+// Adds the shadow a circle casts from a light at (lightX, lightY), reaching length pixels past
+// the circle: the umbra between the two tangent rays from the light's centre, capped by the arc
+// of the circle that faces the light. A light radius above 0 adds penumbra fringes outside the
+// umbra edges, fading from the colour's alpha to 0, so the renderer needs SDL_BLENDMODE_BLEND.
+// Nothing is added when the light is inside the circle. False when out of memory.
+bool batchCircleShadow(GeometryBatch* batch, float lightX, float lightY, float lightRadius,
+                       float x, float y, float radius, float length, SDL_Color colour);
+
+// How a polyline's stroke turns its corners: out to the point where the two edges meet, cut
+// straight across, or rounded. A miter more than MITER_LIMIT half widths out is cut like a bevel.
+typedef enum {
+    LINE_JOIN_MITER,
+    LINE_JOIN_BEVEL,
+    LINE_JOIN_ROUND
+} LineJoin;
+
+#define MITER_LIMIT 4.0f
+
+// Adds a stroke width pixels wide along the count points, joined at every corner, with the last
+// point joined back to the first when closed; an open polyline's ends are cut square at its end
+// points. feather above 0 adds fringes that many pixels wide round the outside, fading from the
+// colour's alpha to 0, so the edges are smooth with SDL_BLENDMODE_BLEND. Points repeated one after
+// another are skipped. False when out of memory.
+bool batchPolyline(GeometryBatch* batch, const SDL_FPoint* points, int count, bool closed,
+                   float width, LineJoin join, float feather, SDL_Color colour);
+
+// A single straight stroke from (x0, y0) to (x1, y1), as batchPolyline
+bool batchLine(GeometryBatch* batch, float x0, float y0, float x1, float y1, float width, float feather, SDL_Color colour);
+
+// Draws everything added since the last flush in one call and empties the batch
+void flushGeometryBatch(GeometryBatch* batch, SDL_Renderer* renderer);
+
+// The two halves of a flush, for a batch that is built once and drawn again on later frames
+void drawGeometryBatch(const GeometryBatch* batch, SDL_Renderer* renderer);
+void clearGeometryBatch(GeometryBatch* batch);
+
+#endif
@@ -0,0 +1,228 @@
+#include "glyphAtlas.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+
+#define ATLAS_WIDTH 256 // wide enough for a row of a dozen or so glyphs at the sizes used for HUD text
+#define GLYPH_PADDING 1 // clear pixels round each glyph so a filtered edge never picks up its neighbour
+#define MAX_FORMATTED_TEXT 256
+
+void freeGlyphAtlas(GlyphAtlas* atlas) {
+    if (atlas->texture != NULL) {
+        SDL_DestroyTexture(atlas->texture);
+    }
+    free(atlas->vertices);
+    free(atlas->indices);
+    memset(atlas, 0, sizeof(*atlas));
+}
+
+// Places the rendered glyphs left to right in rows, returning the height the rows take up
+static int packGlyphs(GlyphAtlas* atlas, SDL_Surface** rendered) {
+    int x = GLYPH_PADDING, y = GLYPH_PADDING, rowHeight = 0;
+    for (int g = 0; g < GLYPH_COUNT; g++) {
+        if (rendered[g] == NULL) continue;
+        if (x + rendered[g]->w + GLYPH_PADDING > atlas->width) {
+            x = GLYPH_PADDING;
+            y += rowHeight + GLYPH_PADDING;
+            rowHeight = 0;
+        }
+        SDL_Rect source = {x, y, rendered[g]->w, rendered[g]->h};
+        atlas->glyphs[g].source = source;
+        x += rendered[g]->w + GLYPH_PADDING;
+        if (rendered[g]->h > rowHeight) rowHeight = rendered[g]->h;
+    }
+    return y + rowHeight + GLYPH_PADDING;
+}
+
+bool initGlyphAtlas(GlyphAtlas* atlas, SDL_Renderer* renderer, TTF_Font* font) {
+    memset(atlas, 0, sizeof(*atlas));
+    atlas->lineHeight = TTF_FontHeight(font);
+    atlas->lineSkip = TTF_FontLineSkip(font);
+
+    // glyphs are rendered white so a vertex colour can tint them any colour when drawn
+    SDL_Color white = {255, 255, 255, 255};
+    SDL_Surface* rendered[GLYPH_COUNT] = {NULL};
+    atlas->width = ATLAS_WIDTH;
+    for (int g = 0; g < GLYPH_COUNT; g++) {
+        Uint16 ch = FIRST_GLYPH + g;
+        AtlasGlyph* glyph = &atlas->glyphs[g];
+        int minX, maxX, minY, maxY;
+        if (!TTF_GlyphIsProvided(font, ch) || TTF_GlyphMetrics(font, ch, &minX, &maxX, &minY, &maxY, &glyph->advance) != 0) {
+            glyph->advance = 0;
+            continue;
+        }
+        for (int next = 0; next < GLYPH_COUNT; next++) {
+            int kerning = TTF_GetFontKerningSizeGlyphs(font, ch, FIRST_GLYPH + next);
+            atlas->kerning[g][next] = kerning < -128 ? -128 : kerning > 127 ? 127 : kerning;
+        }
+
+        // nothing to draw for the space, it only moves the pen
+        if (maxX <= minX || maxY <= minY) continue;
+        // rendered the way TTF_RenderText lays out a one-glyph string: the box is the font's
+        // height from the top of the line, and starts at the pen unless the glyph reaches behind it
+        rendered[g] = TTF_RenderGlyph_Blended(font, ch, white);
+        if (rendered[g] == NULL) continue;
+        glyph->offsetX = minX < 0 ? minX : 0;
+        if (rendered[g]->w + 2 * GLYPH_PADDING > atlas->width) {
+            atlas->width = rendered[g]->w + 2 * GLYPH_PADDING;
+        }
+    }
+    atlas->height = packGlyphs(atlas, rendered);
+
+    bool success = false;
+    SDL_Surface* sheet = SDL_CreateRGBSurfaceWithFormat(0, atlas->width, atlas->height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (sheet == NULL) {
+        printf("Unable to create glyph atlas surface! SDL Error: %s\n", SDL_GetError());
+    } else {
+        SDL_FillRect(sheet, NULL, SDL_MapRGBA(sheet->format, 255, 255, 255, 0));
+        for (int g = 0; g < GLYPH_COUNT; g++) {
+            if (rendered[g] == NULL) continue;
+            SDL_Rect destination = atlas->glyphs[g].source; // SDL_BlitSurface writes the clipped rectangle back
+            SDL_SetSurfaceBlendMode(rendered[g], SDL_BLENDMODE_NONE); // copy the coverage into alpha as it is
+            SDL_BlitSurface(rendered[g], NULL, sheet, &destination);
+        }
+
+        atlas->texture = SDL_CreateTextureFromSurface(renderer, sheet);
+        if (atlas->texture == NULL) {
+            printf("Unable to create glyph atlas texture! SDL Error: %s\n", SDL_GetError());
+        } else {
+            SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+            success = true;
+        }
+        SDL_FreeSurface(sheet);
+    }
+
+    for (int g = 0; g < GLYPH_COUNT; g++) {
+        if (rendered[g] != NULL) SDL_FreeSurface(rendered[g]);
+    }
+    if (!success) {
+        freeGlyphAtlas(atlas);
+    }
+    return success;
+}
+
+// Makes room for count more quads, doubling as needed. The indices of the new quads are
+// written here, since quad n always uses vertices 4n to 4n + 3 the same way.
+static bool reserveQuads(GlyphAtlas* atlas, int count) {
+    if (atlas->quadCount + count <= atlas->quadCapacity) return true;
+
+    int capacity = atlas->quadCapacity > 0 ? atlas->quadCapacity : 64;
+    while (capacity < atlas->quadCount + count) {
+        capacity *= 2;
+    }
+    SDL_Vertex* vertices = realloc(atlas->vertices, sizeof(SDL_Vertex) * 4 * capacity);
+    if (vertices == NULL) {
+        return false;
+    }
+    atlas->vertices = vertices;
+    int* indices = realloc(atlas->indices, sizeof(int) * 6 * capacity);
+    if (indices == NULL) {
+        return false;
+    }
+    atlas->indices = indices;
+
+    for (int q = atlas->quadCapacity; q < capacity; q++) {
+        int* out = &indices[6 * q];
+        out[0] = 4 * q;
+        out[1] = 4 * q + 1;
+        out[2] = 4 * q + 2;
+        out[3] = 4 * q;
+        out[4] = 4 * q + 2;
+        out[5] = 4 * q + 3;
+    }
+    atlas->quadCapacity = capacity;
+    return true;
+}
+
+int measureText(const GlyphAtlas* atlas, const char* text) {
+    int width = 0, penX = 0, previous = -1;
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '\n') {
+            penX = 0;
+            previous = -1;
+            continue;
+        }
+        int g = (unsigned char)*c - FIRST_GLYPH;
+        if (g < 0 || g >= GLYPH_COUNT) continue;
+        if (previous >= 0) penX += atlas->kerning[previous][g];
+        penX += atlas->glyphs[g].advance;
+        previous = g;
+        if (penX > width) width = penX;
+    }
+    return width;
+}
+
+bool batchText(GlyphAtlas* atlas, float x, float y, const char* text, SDL_Color colour) {
+    // at most one quad a character, so one reserve covers the whole string
+    if (!reserveQuads(atlas, (int)strlen(text))) {
+        return false;
+    }
+
+    // the pen stays on whole pixels so every glyph is copied 1:1 from the atlas and stays sharp
+    float lineX = roundf(x), penX = lineX, penY = roundf(y);
+    float texelWidth = 1.0f / atlas->width, texelHeight = 1.0f / atlas->height;
+    int previous = -1;
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '\n') {
+            penX = lineX;
+            penY += atlas->lineSkip;
+            previous = -1;
+            continue;
+        }
+        int g = (unsigned char)*c - FIRST_GLYPH;
+        if (g < 0 || g >= GLYPH_COUNT) continue;
+        if (previous >= 0) penX += atlas->kerning[previous][g];
+        previous = g;
+
+        const AtlasGlyph* glyph = &atlas->glyphs[g];
+        if (glyph->source.w > 0) {
+            float left = penX + glyph->offsetX, right = left + glyph->source.w;
+            float top = penY, bottom = top + glyph->source.h;
+            float u0 = glyph->source.x * texelWidth, u1 = (glyph->source.x + glyph->source.w) * texelWidth;
+            float v0 = glyph->source.y * texelHeight, v1 = (glyph->source.y + glyph->source.h) * texelHeight;
+
+            SDL_Vertex* out = &atlas->vertices[4 * atlas->quadCount++];
+            out[0].position.x = left;
+            out[0].position.y = top;
+            out[0].tex_coord.x = u0;
+            out[0].tex_coord.y = v0;
+            out[1].position.x = right;
+            out[1].position.y = top;
+            out[1].tex_coord.x = u1;
+            out[1].tex_coord.y = v0;
+            out[2].position.x = right;
+            out[2].position.y = bottom;
+            out[2].tex_coord.x = u1;
+            out[2].tex_coord.y = v1;
+            out[3].position.x = left;
+            out[3].position.y = bottom;
+            out[3].tex_coord.x = u0;
+            out[3].tex_coord.y = v1;
+            for (int k = 0; k < 4; k++) {
+                out[k].color = colour;
+            }
+        }
+        penX += glyph->advance;
+    }
+    return true;
+}
+
+bool batchTextFormat(GlyphAtlas* atlas, float x, float y, SDL_Color colour, const char* format, ...) {
+    char text[MAX_FORMATTED_TEXT];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args); // anything longer is cut short
+    va_end(args);
+    return batchText(atlas, x, y, text, colour);
+}
+
+void flushGlyphAtlas(GlyphAtlas* atlas, SDL_Renderer* renderer) {
+    if (atlas->quadCount > 0) {
+        SDL_RenderGeometry(renderer, atlas->texture, atlas->vertices, 4 * atlas->quadCount,
+                           atlas->indices, 6 * atlas->quadCount);
+    }
+    atlas->quadCount = 0;
+}
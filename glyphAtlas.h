@@ -0,0 +1,56 @@
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <stdbool.h>
+
+#define FIRST_GLYPH ' ' // printable ASCII, all the text these programs draw
+#define LAST_GLYPH '~'
+#define GLYPH_COUNT (LAST_GLYPH - FIRST_GLYPH + 1)
+
+// Where one glyph sits in the atlas and how far it moves the pen
+typedef struct {
+    SDL_Rect source; // empty for glyphs with nothing to draw, like the space
+    int offsetX;     // from the pen to the left of the box, only below zero for glyphs reaching behind the pen
+    int advance;
+} AtlasGlyph;
+
+// Every printable glyph of one font and size, rendered once in white and packed into a single
+// texture, with their advances and kerning looked up up front. Strings are laid out as textured
+// quads in one vertex buffer, tinted by vertex colour and drawn with a single SDL_RenderGeometry
+// call. The buffers only grow, so once a frame's worth of text fits, later frames draw without
+// allocating or rendering anything through SDL_ttf.
+typedef struct {
+    SDL_Texture* texture;
+    int width;
+    int height;
+    AtlasGlyph glyphs[GLYPH_COUNT];
+    signed char kerning[GLYPH_COUNT][GLYPH_COUNT]; // kerning[previous][next], added to the previous glyph's advance
+    int lineHeight; // font height, the height of every glyph's box
+    int lineSkip;   // distance between the tops of two lines
+    SDL_Vertex* vertices; // four per quad
+    int quadCount;
+    int quadCapacity;
+    int* indices; // six per quad, written when the buffer grows and the same every frame after
+} GlyphAtlas;
+
+// Renders and packs the glyphs of font, false when a texture or surface can't be made. The
+// font is only read here, so it can be closed afterwards.
+bool initGlyphAtlas(GlyphAtlas* atlas, SDL_Renderer* renderer, TTF_Font* font);
+void freeGlyphAtlas(GlyphAtlas* atlas);
+
+// Width in pixels of the widest line of text
+int measureText(const GlyphAtlas* atlas, const char* text);
+
+// Queues text with its top left at (x, y); '\n' starts a new line and characters outside
+// printable ASCII are skipped. False when out of memory.
+bool batchText(GlyphAtlas* atlas, float x, float y, const char* text, SDL_Color colour);
+
+// batchText of a printf-style format, through a fixed buffer so nothing is allocated
+bool batchTextFormat(GlyphAtlas* atlas, float x, float y, SDL_Color colour, const char* format, ...);
+
+// Draws the queued text in one call and empties the queue
+void flushGlyphAtlas(GlyphAtlas* atlas, SDL_Renderer* renderer);
+
+#endif
@@ -0,0 +1,376 @@
+// Barnes-Hut gravity on a Morton-ordered quadtree.
+// Build with -mavx2 to apply interaction lists 8 masses at a time, otherwise the scalar path is used.
+
+#include "gravityTree.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define LEAF_SIZE 16     // bodies summed directly instead of splitting further
+#define MORTON_BITS 16   // per axis, so a code fits 32 bits and the tree is at most 16 deep
+#define LEAF_BLOCK 16    // leaves per tree walk task
+#define LIST_SIZE 512    // interactions gathered before they are applied to a group
+
+void initGravityTree(GravityTree* tree, float G, float theta, float softening) {
+    memset(tree, 0, sizeof(*tree));
+    tree->G = G;
+    tree->theta = theta;
+    tree->softening = softening;
+}
+
+void freeGravityTree(GravityTree* tree) {
+    free(tree->nodes);
+    free(tree->leaves);
+    free(tree->codes);
+    free(tree->order);
+    free(tree->sx);
+    free(tree->sy);
+    free(tree->smass);
+    free(tree->sortCodes);
+    free(tree->sortOrder);
+    memset(tree, 0, sizeof(*tree));
+}
+
+static bool growBodyArrays(GravityTree* tree, int count) {
+    if (count <= tree->capacity) {
+        return true;
+    }
+    int capacity = tree->capacity > 0 ? tree->capacity : 1024;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    void** arrays[] = {
+        (void**)&tree->codes, (void**)&tree->order, (void**)&tree->sx, (void**)&tree->sy,
+        (void**)&tree->smass, (void**)&tree->sortCodes, (void**)&tree->sortOrder
+    };
+    size_t sizes[] = {sizeof(unsigned), sizeof(int), sizeof(float), sizeof(float), sizeof(float), sizeof(unsigned), sizeof(int)};
+    for (int i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        void* grown = realloc(*arrays[i], sizes[i] * capacity);
+        if (grown == NULL) {
+            return false;
+        }
+        *arrays[i] = grown;
+    }
+    tree->capacity = capacity;
+    return true;
+}
+
+// Spreads the low 16 bits of v to the even bits of the result
+static unsigned spreadBits(unsigned v) {
+    v &= 0xFFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+// LSD radix sort of (codes, order) by code, one byte per pass
+static void sortByCode(GravityTree* tree, int n) {
+    unsigned* codes = tree->codes;
+    int* order = tree->order;
+    unsigned* tmpCodes = tree->sortCodes;
+    int* tmpOrder = tree->sortOrder;
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        int count[257] = {0};
+        for (int i = 0; i < n; i++) {
+            count[((codes[i] >> shift) & 0xFF) + 1]++;
+        }
+        for (int b = 0; b < 256; b++) {
+            count[b + 1] += count[b];
+        }
+        for (int i = 0; i < n; i++) {
+            int slot = count[(codes[i] >> shift) & 0xFF]++;
+            tmpCodes[slot] = codes[i];
+            tmpOrder[slot] = order[i];
+        }
+
+        unsigned* swapCodes = codes;
+        codes = tmpCodes;
+        tmpCodes = swapCodes;
+        int* swapOrder = order;
+        order = tmpOrder;
+        tmpOrder = swapOrder;
+    }
+    // four passes, so the result is back in tree->codes and tree->order
+}
+
+// Builds the cell for sorted bodies [begin, end), all sharing their top 2 * level code bits.
+// Returns the node index or -1 when out of memory.
+static int buildNode(GravityTree* tree, int begin, int end, int level, float x0, float y0, float size) {
+    if (tree->nodeCount == tree->nodeCapacity) {
+        int capacity = tree->nodeCapacity > 0 ? tree->nodeCapacity * 2 : 1024;
+        GravityNode* grown = realloc(tree->nodes, sizeof(GravityNode) * capacity);
+        if (grown == NULL) {
+            return -1;
+        }
+        tree->nodes = grown;
+        tree->nodeCapacity = capacity;
+    }
+
+    int index = tree->nodeCount++;
+    GravityNode node = {x0, y0, size, 0, 0, 0, begin, end, {-1, -1, -1, -1}};
+
+    if (end - begin <= LEAF_SIZE || level == MORTON_BITS) {
+        int* leaves = tree->leafCount < tree->leafCapacity ? tree->leaves : NULL;
+        if (leaves == NULL) {
+            int capacity = tree->leafCapacity > 0 ? tree->leafCapacity * 2 : 1024;
+            leaves = realloc(tree->leaves, sizeof(int) * capacity);
+            if (leaves == NULL) {
+                return -1;
+            }
+            tree->leaves = leaves;
+            tree->leafCapacity = capacity;
+        }
+        leaves[tree->leafCount++] = index;
+
+        for (int i = begin; i < end; i++) {
+            node.mass += tree->smass[i];
+            node.cx += tree->sx[i] * tree->smass[i];
+            node.cy += tree->sy[i] * tree->smass[i];
+        }
+    } else {
+        // bodies are sorted, so each quadrant is one contiguous run
+        int shift = 2 * (MORTON_BITS - 1 - level);
+        float half = size * 0.5f;
+        int start = begin;
+        for (int q = 0; q < 4 && start < end; q++) {
+            int stop = start;
+            while (stop < end && (int)((tree->codes[stop] >> shift) & 3) == q) {
+                stop++;
+            }
+            if (stop == start) {
+                continue;
+            }
+
+            int child = buildNode(tree, start, stop, level + 1, x0 + (q & 1) * half, y0 + (q >> 1) * half, half);
+            if (child < 0) {
+                return -1;
+            }
+            node.child[q] = child;
+            GravityNode* c = &tree->nodes[child];
+            node.mass += c->mass;
+            node.cx += c->cx * c->mass;
+            node.cy += c->cy * c->mass;
+            start = stop;
+        }
+    }
+
+    if (node.mass > 0) {
+        node.cx /= node.mass;
+        node.cy /= node.mass;
+    }
+    tree->nodes[index] = node;
+    return index;
+}
+
+typedef struct {
+    GravityTree* tree;
+    CircleWorld* world;
+    float dt;
+} GravityJob;
+
+// Point masses gathered by one group walk
+typedef struct {
+    float x[LIST_SIZE + 8], y[LIST_SIZE + 8], m[LIST_SIZE + 8]; // room to pad to a multiple of 8
+    int count;
+} InteractionList;
+
+// Adds the pull of every listed mass to the group's accumulators. A body meets itself at
+// distance zero, which contributes no force at all.
+static void applyList(InteractionList* list, const GravityTree* tree, int begin, int end, float* ax, float* ay) {
+    float softSq = tree->softening * tree->softening;
+
+#ifdef __AVX2__
+    // pad to a multiple of 8 with massless entries
+    while (list->count % 8 != 0) {
+        list->x[list->count] = 0;
+        list->y[list->count] = 0;
+        list->m[list->count] = 0;
+        list->count++;
+    }
+#endif
+
+    for (int s = begin; s < end; s++) {
+        float x = tree->sx[s], y = tree->sy[s];
+        float sumX = 0, sumY = 0;
+        int k = 0;
+
+#ifdef __AVX2__
+        __m256 px = _mm256_set1_ps(x), py = _mm256_set1_ps(y), soft = _mm256_set1_ps(softSq);
+        __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+        __m256 accX = zero, accY = zero;
+        for (; k < list->count; k += 8) {
+            __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(list->x + k), px);
+            __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(list->y + k), py);
+            __m256 distSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), soft);
+            __m256 invDist = _mm256_div_ps(one, _mm256_sqrt_ps(distSq));
+            invDist = _mm256_and_ps(invDist, _mm256_cmp_ps(distSq, zero, _CMP_GT_OQ));
+            __m256 strength = _mm256_mul_ps(_mm256_loadu_ps(list->m + k), _mm256_mul_ps(invDist, _mm256_mul_ps(invDist, invDist)));
+            accX = _mm256_add_ps(accX, _mm256_mul_ps(dx, strength));
+            accY = _mm256_add_ps(accY, _mm256_mul_ps(dy, strength));
+        }
+        float lanes[8];
+        _mm256_storeu_ps(lanes, accX);
+        for (int l = 0; l < 8; l++) sumX += lanes[l];
+        _mm256_storeu_ps(lanes, accY);
+        for (int l = 0; l < 8; l++) sumY += lanes[l];
+#endif
+
+        // scalar path, also used without AVX2
+        for (; k < list->count; k++) {
+            float dx = list->x[k] - x;
+            float dy = list->y[k] - y;
+            float distSq = dx * dx + dy * dy + softSq;
+            float invDist = distSq > 0 ? 1.0f / sqrtf(distSq) : 0.0f;
+            float strength = list->m[k] * invDist * invDist * invDist;
+            sumX += dx * strength;
+            sumY += dy * strength;
+        }
+        ax[s - begin] += sumX;
+        ay[s - begin] += sumY;
+    }
+    list->count = 0;
+}
+
+static void pushInteraction(InteractionList* list, const GravityTree* tree, int begin, int end, float* ax, float* ay,
+                            float x, float y, float m) {
+    if (list->count == LIST_SIZE) {
+        applyList(list, tree, begin, end, ax, ay);
+    }
+    list->x[list->count] = x;
+    list->y[list->count] = y;
+    list->m[list->count] = m;
+    list->count++;
+}
+
+// Walks the tree once for a whole group of neighbouring bodies (Barnes' grouping): a cell is
+// accepted as one mass only if it is far enough from every body of the group, and the
+// accepted cells are then applied to all of them in one tight loop.
+static void walkGroup(const GravityTree* tree, CircleWorld* world, float dt, int begin, int end) {
+    const GravityNode* nodes = tree->nodes;
+    float thetaSq = tree->theta * tree->theta;
+
+    float minX = tree->sx[begin], maxX = minX, minY = tree->sy[begin], maxY = minY;
+    for (int s = begin + 1; s < end; s++) {
+        minX = fminf(minX, tree->sx[s]);
+        maxX = fmaxf(maxX, tree->sx[s]);
+        minY = fminf(minY, tree->sy[s]);
+        maxY = fmaxf(maxY, tree->sy[s]);
+    }
+
+    InteractionList list;
+    list.count = 0;
+    float ax[LEAF_SIZE] = {0}, ay[LEAF_SIZE] = {0};
+    int stack[4 * MORTON_BITS + 4];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const GravityNode* node = &nodes[stack[--top]];
+
+        // distance from the cell's centre of mass to the nearest point of the group's box
+        float dx = fmaxf(fmaxf(minX - node->cx, node->cx - maxX), 0.0f);
+        float dy = fmaxf(fmaxf(minY - node->cy, node->cy - maxY), 0.0f);
+        bool overlaps = node->x0 <= maxX && node->x0 + node->size >= minX && node->y0 <= maxY && node->y0 + node->size >= minY;
+        if (!overlaps && node->size * node->size < thetaSq * (dx * dx + dy * dy)) {
+            pushInteraction(&list, tree, begin, end, ax, ay, node->cx, node->cy, node->mass);
+            continue;
+        }
+
+        if (node->child[0] < 0 && node->child[1] < 0 && node->child[2] < 0 && node->child[3] < 0) {
+            for (int j = node->begin; j < node->end; j++) {
+                pushInteraction(&list, tree, begin, end, ax, ay, tree->sx[j], tree->sy[j], tree->smass[j]);
+            }
+            continue;
+        }
+
+        for (int q = 0; q < 4; q++) {
+            if (node->child[q] >= 0) {
+                stack[top++] = node->child[q];
+            }
+        }
+    }
+    applyList(&list, tree, begin, end, ax, ay);
+
+    // sleeping bodies feel no pull until something wakes them
+    float kick = tree->G * dt;
+    for (int s = begin; s < end; s++) {
+        int body = tree->order[s];
+        if (body < world->awakeCount) {
+            world->vx[body] += ax[s - begin] * kick;
+            world->vy[body] += ay[s - begin] * kick;
+        }
+    }
+}
+
+static void gravityTask(void* data, int task) {
+    GravityJob* job = data;
+    GravityTree* tree = job->tree;
+    int first = task * LEAF_BLOCK;
+    int last = first + LEAF_BLOCK < tree->leafCount ? first + LEAF_BLOCK : tree->leafCount;
+
+    for (int l = first; l < last; l++) {
+        const GravityNode* leaf = &tree->nodes[tree->leaves[l]];
+        // leaves at the depth limit can hold more than LEAF_SIZE bodies
+        for (int begin = leaf->begin; begin < leaf->end; begin += LEAF_SIZE) {
+            int end = begin + LEAF_SIZE < leaf->end ? begin + LEAF_SIZE : leaf->end;
+            walkGroup(tree, job->world, job->dt, begin, end);
+        }
+    }
+}
+
+bool applyGravity(GravityTree* tree, CircleWorld* world, float dt) {
+    int n = world->count;
+    tree->nodeCount = 0;
+    tree->leafCount = 0;
+    if (n == 0) {
+        return true;
+    }
+    if (!growBodyArrays(tree, n)) {
+        return false;
+    }
+
+    float minX = world->x[0], maxX = world->x[0];
+    float minY = world->y[0], maxY = world->y[0];
+    for (int i = 1; i < n; i++) {
+        if (world->x[i] < minX) minX = world->x[i];
+        if (world->x[i] > maxX) maxX = world->x[i];
+        if (world->y[i] < minY) minY = world->y[i];
+        if (world->y[i] > maxY) maxY = world->y[i];
+    }
+    // a square root cell, slightly oversized so the far edge still quantises below 2^16
+    float size = fmaxf(maxX - minX, maxY - minY) * 1.001f + 1.0f;
+    float scale = (float)(1 << MORTON_BITS) / size;
+
+    for (int i = 0; i < n; i++) {
+        unsigned qx = (unsigned)((world->x[i] - minX) * scale);
+        unsigned qy = (unsigned)((world->y[i] - minY) * scale);
+        tree->codes[i] = spreadBits(qx) | (spreadBits(qy) << 1);
+        tree->order[i] = i;
+    }
+    sortByCode(tree, n);
+
+    // bodies with invMass 0 are immovable and exert no pull
+    for (int s = 0; s < n; s++) {
+        int i = tree->order[s];
+        tree->sx[s] = world->x[i];
+        tree->sy[s] = world->y[i];
+        tree->smass[s] = world->invMass[i] > 0 ? 1.0f / world->invMass[i] : 0.0f;
+    }
+
+    if (buildNode(tree, 0, n, 0, minX, minY, size) < 0) {
+        return false;
+    }
+
+    GravityJob job = {tree, world, dt};
+    runTasks(world->pool, (tree->leafCount + LEAF_BLOCK - 1) / LEAF_BLOCK, gravityTask, &job);
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef GRAVITY_TREE_H
+#define GRAVITY_TREE_H
+
+#include <stdbool.h>
+
+#include "circleWorld.h"
+
+// One cell of the Barnes-Hut quadtree
+typedef struct {
+    float x0, y0, size; // square covered by the cell
+    float mass;         // total mass inside
+    float cx, cy;       // centre of mass
+    int begin, end;     // bodies of the cell in Morton order
+    int child[4];       // -1 where a quadrant is empty, all -1 for leaves
+} GravityNode;
+
+// Barnes-Hut N-body gravity between all bodies of a CircleWorld. The quadtree is rebuilt
+// every step from a Morton-order sort of the bodies, then walked in parallel once per leaf:
+// a cell whose size seen from the leaf is under the opening angle acts as one mass at its
+// centre of mass.
+typedef struct {
+    float G;         // gravitational constant, pixels^3 / (mass * second^2)
+    float theta;     // opening angle, 0 sums every pair exactly, 0.5 - 0.7 is the usual trade-off
+    float softening; // pixels added in quadrature to every distance so close passes stay finite
+
+    GravityNode* nodes;
+    int nodeCount;
+    int nodeCapacity;
+    int* leaves; // leaf node indices in Morton order, the unit of parallel work
+    int leafCount;
+    int leafCapacity;
+
+    // bodies in Morton order
+    unsigned* codes;
+    int* order;      // body index
+    float* sx;
+    float* sy;
+    float* smass;
+    unsigned* sortCodes; // radix sort scratch
+    int* sortOrder;
+    int capacity;
+} GravityTree;
+
+void initGravityTree(GravityTree* tree, float G, float theta, float softening);
+void freeGravityTree(GravityTree* tree);
+
+// Rebuilds the tree from the world's bodies and adds dt seconds of gravitational acceleration
+// to every awake body's velocity. Returns false when out of memory.
+bool applyGravity(GravityTree* tree, CircleWorld* world, float dt);
+
+#endif
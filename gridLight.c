@@ -0,0 +1,265 @@
+#include "gridLight.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define RAYS_PER_TASK 256
+#define ROWS_PER_TASK 8
+#define RAYS_PER_RANGE 8   // rays per cell of range: diamond angle is twice as coarse as true angle on the diagonals
+#define LIT_MARGIN 1.0f    // cells past where a ray stopped that still count as lit, so the blocking cell's face is
+
+bool initGridLighting(GridLighting* lighting, SDL_Renderer* renderer, int width, int height) {
+    memset(lighting, 0, sizeof(*lighting));
+    lighting->width = width;
+    lighting->height = height;
+    lighting->words = (width + 63) / 64;
+    lighting->solid = calloc(lighting->words * height, sizeof(uint64_t));
+    lighting->light = calloc(width * height * 3, sizeof(float));
+    lighting->pixels = malloc(sizeof(Uint32) * width * height);
+    lighting->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (lighting->solid == NULL || lighting->light == NULL || lighting->pixels == NULL || lighting->texture == NULL) {
+        freeGridLighting(lighting);
+        return false;
+    }
+    SDL_SetTextureBlendMode(lighting->texture, SDL_BLENDMODE_MOD);
+    return true;
+}
+
+void freeGridLighting(GridLighting* lighting) {
+    if (lighting->texture != NULL) SDL_DestroyTexture(lighting->texture);
+    free(lighting->solid);
+    free(lighting->lights);
+    free(lighting->rayStart);
+    free(lighting->rayLight);
+    free(lighting->rayReach);
+    free(lighting->light);
+    free(lighting->pixels);
+    memset(lighting, 0, sizeof(*lighting));
+}
+
+void clearSolidCells(GridLighting* lighting) {
+    memset(lighting->solid, 0, sizeof(uint64_t) * lighting->words * lighting->height);
+}
+
+void setSolidSpan(GridLighting* lighting, int y, int x0, int x1) {
+    if (y < 0 || y >= lighting->height) return;
+    if (x0 < 0) x0 = 0;
+    if (x1 > lighting->width - 1) x1 = lighting->width - 1;
+    uint64_t* row = &lighting->solid[y * lighting->words];
+    for (int w = x0 / 64; w <= x1 / 64 && x0 <= x1; w++) {
+        int b0 = w == x0 / 64 ? x0 % 64 : 0;
+        int b1 = w == x1 / 64 ? x1 % 64 : 63;
+        row[w] |= (~0ULL >> (63 - b1)) & (~0ULL << b0);
+    }
+}
+
+bool isSolidCell(const GridLighting* lighting, int x, int y) {
+    if (x < 0 || y < 0 || x >= lighting->width || y >= lighting->height) return false;
+    return (lighting->solid[y * lighting->words + x / 64] >> (x % 64)) & 1;
+}
+
+float castGridRay(const GridLighting* lighting, float ox, float oy, float dx, float dy, float tMax) {
+    int cx = (int)floorf(ox), cy = (int)floorf(oy);
+    if (cx < 0 || cy < 0 || cx >= lighting->width || cy >= lighting->height) {
+        return tMax;
+    }
+
+    int stepX = dx > 0 ? 1 : -1, stepY = dy > 0 ? 1 : -1;
+    float deltaX = dx != 0 ? 1.0f / fabsf(dx) : INFINITY;
+    float deltaY = dy != 0 ? 1.0f / fabsf(dy) : INFINITY;
+    float nextX = dx != 0 ? (cx + (dx > 0) - ox) / dx : INFINITY;
+    float nextY = dy != 0 ? (cy + (dy > 0) - oy) / dy : INFINITY;
+    const uint64_t* solid = lighting->solid;
+    int words = lighting->words;
+
+    float t = 0;
+    while (t < tMax) {
+        if ((solid[cy * words + (cx >> 6)] >> (cx & 63)) & 1) {
+            return t;
+        }
+        if (nextX < nextY) {
+            t = nextX;
+            nextX += deltaX;
+            cx += stepX;
+            if (cx < 0 || cx >= lighting->width) break;
+        } else {
+            t = nextY;
+            nextY += deltaY;
+            cy += stepY;
+            if (cy < 0 || cy >= lighting->height) break;
+        }
+    }
+    return tMax;
+}
+
+void clearGridLights(GridLighting* lighting) {
+    lighting->lightCount = 0;
+}
+
+bool addGridLight(GridLighting* lighting, float x, float y, float range, float r, float g, float b) {
+    if (lighting->lightCount == lighting->lightCapacity) {
+        int capacity = lighting->lightCapacity > 0 ? lighting->lightCapacity * 2 : 64;
+        GridLight* grown = realloc(lighting->lights, sizeof(GridLight) * capacity);
+        if (grown == NULL) {
+            return false;
+        }
+        lighting->lights = grown;
+        lighting->lightCapacity = capacity;
+    }
+    lighting->lights[lighting->lightCount++] = (GridLight){x, y, range, r, g, b};
+    return true;
+}
+
+// Diamond angle of (dx, dy): 0 to 4 round the circle like an angle, from ratios alone
+static float diamondAngle(float dx, float dy) {
+    if (dy >= 0) return dx >= 0 ? dy / (dx + dy) : 1 - dx / (dy - dx);
+    return dx < 0 ? 2 - dy / (-dx - dy) : 3 + dx / (dx - dy);
+}
+
+// Unit direction at diamond angle a
+static void diamondDirection(float a, float* dx, float* dy) {
+    int quarter = (int)a;
+    float f = a - quarter, x = 1 - f, y = f;
+    switch (quarter & 3) {
+    case 0: *dx = x; *dy = y; break;
+    case 1: *dx = -y; *dy = x; break;
+    case 2: *dx = -x; *dy = -y; break;
+    default: *dx = y; *dy = -x; break;
+    }
+    float length = sqrtf(*dx * *dx + *dy * *dy);
+    *dx /= length;
+    *dy /= length;
+}
+
+static int lightRays(const GridLight* light) {
+    int rays = (int)ceilf(light->range * RAYS_PER_RANGE);
+    return rays < 8 ? 8 : rays;
+}
+
+// Grows the per-ray arrays and lays out every light's rays one after another
+static bool layOutRays(GridLighting* lighting) {
+    if (lighting->lightCount + 1 > lighting->rayStartCapacity) {
+        int capacity = lighting->lightCapacity + 1;
+        int* grown = realloc(lighting->rayStart, sizeof(int) * capacity);
+        if (grown == NULL) {
+            return false;
+        }
+        lighting->rayStart = grown;
+        lighting->rayStartCapacity = capacity;
+    }
+
+    int total = 0;
+    for (int l = 0; l < lighting->lightCount; l++) {
+        lighting->rayStart[l] = total;
+        total += lightRays(&lighting->lights[l]);
+    }
+    lighting->rayStart[lighting->lightCount] = total;
+
+    if (total > lighting->rayCapacity) {
+        int capacity = lighting->rayCapacity > 0 ? lighting->rayCapacity : 4096;
+        while (capacity < total) {
+            capacity *= 2;
+        }
+        int* owner = realloc(lighting->rayLight, sizeof(int) * capacity);
+        if (owner != NULL) lighting->rayLight = owner;
+        float* reach = realloc(lighting->rayReach, sizeof(float) * capacity);
+        if (reach != NULL) lighting->rayReach = reach;
+        if (owner == NULL || reach == NULL) {
+            return false;
+        }
+        lighting->rayCapacity = capacity;
+    }
+    for (int l = 0; l < lighting->lightCount; l++) {
+        for (int k = lighting->rayStart[l]; k < lighting->rayStart[l + 1]; k++) {
+            lighting->rayLight[k] = l;
+        }
+    }
+    return true;
+}
+
+static void castRays(void* data, int task) {
+    GridLighting* lighting = data;
+    int first = task * RAYS_PER_TASK;
+    int last = first + RAYS_PER_TASK < lighting->rayStart[lighting->lightCount] ? first + RAYS_PER_TASK
+                                                                                 : lighting->rayStart[lighting->lightCount];
+    for (int k = first; k < last; k++) {
+        int l = lighting->rayLight[k];
+        const GridLight* light = &lighting->lights[l];
+        int rays = lighting->rayStart[l + 1] - lighting->rayStart[l];
+        float dx, dy;
+        diamondDirection(4.0f * (k - lighting->rayStart[l]) / rays, &dx, &dy);
+        lighting->rayReach[k] = castGridRay(lighting, light->x, light->y, dx, dy, light->range);
+    }
+}
+
+static void lightRows(void* data, int task) {
+    GridLighting* lighting = data;
+    int y0 = task * ROWS_PER_TASK;
+    int y1 = y0 + ROWS_PER_TASK < lighting->height ? y0 + ROWS_PER_TASK : lighting->height;
+    int width = lighting->width;
+    memset(&lighting->light[y0 * width * 3], 0, sizeof(float) * (y1 - y0) * width * 3);
+
+    for (int l = 0; l < lighting->lightCount; l++) {
+        const GridLight* light = &lighting->lights[l];
+        int ly0 = (int)floorf(light->y - light->range), ly1 = (int)ceilf(light->y + light->range);
+        if (ly1 < y0 || ly0 >= y1) continue;
+        int lx0 = (int)floorf(light->x - light->range), lx1 = (int)ceilf(light->x + light->range);
+        if (lx0 < 0) lx0 = 0;
+        if (lx1 > width - 1) lx1 = width - 1;
+
+        const float* reach = &lighting->rayReach[lighting->rayStart[l]];
+        int rays = lighting->rayStart[l + 1] - lighting->rayStart[l];
+        float raysPerUnit = rays / 4.0f, rangeSquared = light->range * light->range;
+        for (int y = ly0 > y0 ? ly0 : y0; y <= ly1 && y < y1; y++) {
+            float dy = y + 0.5f - light->y;
+            for (int x = lx0; x <= lx1; x++) {
+                float dx = x + 0.5f - light->x;
+                float distanceSquared = dx * dx + dy * dy;
+                if (distanceSquared >= rangeSquared) continue;
+
+                // the ray through this cell, and whether it got here
+                if (distanceSquared > 0) {
+                    int k = (int)(diamondAngle(dx, dy) * raysPerUnit + 0.5f);
+                    float lit = reach[k < rays ? k : 0] + LIT_MARGIN;
+                    if (distanceSquared > lit * lit) continue;
+                }
+
+                float fade = 1.0f - distanceSquared / rangeSquared;
+                fade *= fade;
+                float* out = &lighting->light[(y * width + x) * 3];
+                out[0] += light->r * fade;
+                out[1] += light->g * fade;
+                out[2] += light->b * fade;
+            }
+        }
+    }
+
+    for (int i = y0 * width; i < y1 * width; i++) {
+        Uint32 pixel = 0xFF000000u;
+        for (int c = 0; c < 3; c++) {
+            float value = lighting->light[i * 3 + c] + lighting->ambient;
+            pixel |= (Uint32)(value < 255 ? value : 255) << (16 - 8 * c);
+        }
+        lighting->pixels[i] = pixel;
+    }
+}
+
+bool computeGridLighting(GridLighting* lighting, ThreadPool* pool) {
+    if (lighting->texture == NULL || !layOutRays(lighting)) {
+        return false;
+    }
+    int rays = lighting->rayStart[lighting->lightCount];
+    runTasks(pool, (rays + RAYS_PER_TASK - 1) / RAYS_PER_TASK, castRays, lighting);
+    runTasks(pool, (lighting->height + ROWS_PER_TASK - 1) / ROWS_PER_TASK, lightRows, lighting);
+    SDL_UpdateTexture(lighting->texture, NULL, lighting->pixels, lighting->width * sizeof(Uint32));
+    return true;
+}
+
+void drawGridLighting(GridLighting* lighting, SDL_Renderer* renderer, int cellSize) {
+    if (lighting->texture == NULL) {
+        return;
+    }
+    SDL_Rect stretched = {0, 0, lighting->width * cellSize, lighting->height * cellSize};
+    SDL_RenderCopy(renderer, lighting->texture, NULL, &stretched);
+}
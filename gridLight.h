@@ -0,0 +1,67 @@
+#ifndef GRID_LIGHT_H
+#define GRID_LIGHT_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "threadPool.h"
+
+// A light in cell units, fading smoothly to nothing range cells from (x, y). Colours are 0 to 255.
+typedef struct {
+    float x, y;
+    float range;
+    float r, g, b;
+} GridLight;
+
+// Lighting for a grid of cells, one texel per cell. What blocks light is one bit per cell, so a
+// ray's Amanatides-Woo walk reads a few kilobytes however busy the grid is. Every light sends
+// rays evenly spaced in diamond angle, so a cell finds the ray through it without atan2f, and the
+// rays are cast in parallel. The cells are then lit in parallel bands of rows, each cell lit by
+// every light whose ray through it got that far.
+typedef struct {
+    int width, height;
+    int words;        // 64 bit words per row of the mask
+    uint64_t* solid;  // bit x % 64 of solid[y * words + x / 64] is set for a cell that blocks light
+
+    GridLight* lights;
+    int lightCount;
+    int lightCapacity;
+
+    int* rayStart;    // per light, its first ray; rayStart[lightCount] is the total
+    int rayStartCapacity;
+    int* rayLight;    // light each ray belongs to
+    float* rayReach;  // how far each ray got before a solid cell
+    int rayCapacity;
+
+    float ambient;    // added to every cell, 0 to 255
+    float* light;     // r, g, b per cell
+    Uint32* pixels;   // ARGB8888, what light was clamped to
+    SDL_Texture* texture;
+} GridLighting;
+
+// False when out of memory or the texture cannot be made
+bool initGridLighting(GridLighting* lighting, SDL_Renderer* renderer, int width, int height);
+void freeGridLighting(GridLighting* lighting);
+
+// The mask is the caller's to fill between frames: cleared, then solid runs set row by row
+void clearSolidCells(GridLighting* lighting);
+void setSolidSpan(GridLighting* lighting, int y, int x0, int x1); // cells x0..x1 of row y, clipped to the grid
+bool isSolidCell(const GridLighting* lighting, int x, int y);     // outside the grid is never solid
+
+// Walks (ox, oy) + t * (dx, dy) through the cells, with (dx, dy) of unit length, and returns the t
+// where it enters the first solid cell (0 when it starts in one), or tMax when it gets that far
+// or leaves the grid first
+float castGridRay(const GridLighting* lighting, float ox, float oy, float dx, float dy, float tMax);
+
+// Lights collected for the next computeGridLighting. False when out of memory.
+void clearGridLights(GridLighting* lighting);
+bool addGridLight(GridLighting* lighting, float x, float y, float range, float r, float g, float b);
+
+// Casts every light's rays and relights the cells, then uploads the texture. False when out of memory.
+bool computeGridLighting(GridLighting* lighting, ThreadPool* pool);
+
+// Multiplies what is already drawn by the lighting, each cell cellSize pixels across
+void drawGridLighting(GridLighting* lighting, SDL_Renderer* renderer, int cellSize);
+
+#endif
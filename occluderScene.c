@@ -0,0 +1,566 @@
+// Wall segments for the lights, indexed by a uniform grid walked with a DDA.
+
+#include "occluderScene.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MAX_GRID_SIDE 512 // cells per side, the cell size grows past it
+
+void initOccluderScene(OccluderScene* scene, float cellSize) {
+    memset(scene, 0, sizeof(*scene));
+    scene->cellSize = cellSize;
+}
+
+void freeOccluderScene(OccluderScene* scene) {
+    free(scene->x0);
+    free(scene->y0);
+    free(scene->x1);
+    free(scene->y1);
+    free(scene->group);
+    free(scene->seen);
+    free(scene->cellStart);
+    free(scene->cellX0);
+    free(scene->cellY0);
+    free(scene->cellX1);
+    free(scene->cellY1);
+    free(scene->cellSegment);
+    free(scene->pointX);
+    free(scene->pointY);
+    free(scene->pointStart);
+    free(scene->cellPoint);
+    memset(scene, 0, sizeof(*scene));
+}
+
+// Grows each array in arrays (elements of the matching size) from *capacity to at least count
+static bool growArrays(void** arrays[], const size_t sizes[], int arrayCount, int* capacity, int count) {
+    if (count <= *capacity) {
+        return true;
+    }
+    int grown = *capacity > 0 ? *capacity : 64;
+    while (grown < count) {
+        grown *= 2;
+    }
+    for (int i = 0; i < arrayCount; i++) {
+        void* array = realloc(*arrays[i], sizes[i] * grown);
+        if (array == NULL) {
+            return false;
+        }
+        *arrays[i] = array;
+    }
+    *capacity = grown;
+    return true;
+}
+
+static bool pushSegment(OccluderScene* scene, float x0, float y0, float x1, float y1, int group) {
+    void** arrays[] = {
+        (void**)&scene->x0, (void**)&scene->y0, (void**)&scene->x1, (void**)&scene->y1,
+        (void**)&scene->group, (void**)&scene->seen
+    };
+    size_t sizes[] = {sizeof(float), sizeof(float), sizeof(float), sizeof(float), sizeof(int), sizeof(unsigned)};
+    if (!growArrays(arrays, sizes, 6, &scene->capacity, scene->count + 1)) {
+        return false;
+    }
+    int i = scene->count++;
+    scene->x0[i] = x0;
+    scene->y0[i] = y0;
+    scene->x1[i] = x1;
+    scene->y1[i] = y1;
+    scene->group[i] = group;
+    scene->seen[i] = 0;
+    scene->dirty = true;
+    scene->version++;
+    return true;
+}
+
+int addSegment(OccluderScene* scene, float x0, float y0, float x1, float y1) {
+    if (!pushSegment(scene, x0, y0, x1, y1, scene->nextGroup)) {
+        return -1;
+    }
+    return scene->nextGroup++;
+}
+
+int addPolygon(OccluderScene* scene, const float* points, int pointCount, bool closed) {
+    int group = scene->nextGroup;
+    int edges = closed ? pointCount : pointCount - 1;
+    for (int k = 0; k < edges; k++) {
+        int next = (k + 1) % pointCount;
+        if (!pushSegment(scene, points[2 * k], points[2 * k + 1], points[2 * next], points[2 * next + 1], group)) {
+            removeOccluder(scene, group);
+            return -1;
+        }
+    }
+    return scene->nextGroup++;
+}
+
+bool removeOccluder(OccluderScene* scene, int group) {
+    int kept = 0;
+    for (int i = 0; i < scene->count; i++) {
+        if (scene->group[i] == group) {
+            continue;
+        }
+        scene->x0[kept] = scene->x0[i];
+        scene->y0[kept] = scene->y0[i];
+        scene->x1[kept] = scene->x1[i];
+        scene->y1[kept] = scene->y1[i];
+        scene->group[kept] = scene->group[i];
+        kept++;
+    }
+    bool found = kept < scene->count;
+    scene->count = kept;
+    scene->dirty |= found;
+    scene->version += found;
+    return found;
+}
+
+bool loadOccluderLevel(OccluderScene* scene, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+
+    bool ok = true;
+    char word[32];
+    float* points = NULL;
+    while (ok && fscanf(file, "%31s", word) == 1) {
+        if (word[0] == '#') {
+            int c;
+            while ((c = fgetc(file)) != '\n' && c != EOF) {}
+        } else if (strcmp(word, "segment") == 0) {
+            float x0, y0, x1, y1;
+            ok = fscanf(file, "%f %f %f %f", &x0, &y0, &x1, &y1) == 4 && addSegment(scene, x0, y0, x1, y1) >= 0;
+        } else if (strcmp(word, "polygon") == 0 || strcmp(word, "polyline") == 0) {
+            int n;
+            ok = fscanf(file, "%d", &n) == 1 && n >= 2;
+            float* grown = ok ? realloc(points, sizeof(float) * 2 * n) : NULL;
+            ok = grown != NULL;
+            if (ok) {
+                points = grown;
+                for (int k = 0; k < 2 * n && ok; k++) {
+                    ok = fscanf(file, "%f", &points[k]) == 1;
+                }
+                ok = ok && addPolygon(scene, points, n, word[4] == 'g') >= 0;
+            }
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok) {
+        printf("Bad occluder level %s near '%s'\n", path, word);
+    }
+    free(points);
+    fclose(file);
+    return ok;
+}
+
+// Clips [*t0, *t1] to where o + t * d lies in [lo, hi]
+static bool clipSlab(float o, float d, float lo, float hi, float* t0, float* t1) {
+    if (d == 0) {
+        return o >= lo && o <= hi;
+    }
+    float a = (lo - o) / d, b = (hi - o) / d;
+    if (a > b) {
+        float swap = a;
+        a = b;
+        b = swap;
+    }
+    *t0 = fmaxf(*t0, a);
+    *t1 = fminf(*t1, b);
+    return *t0 <= *t1;
+}
+
+// Where an Amanatides-Woo walk of one ray through the grid cells has got to
+typedef struct {
+    int cx, cy;         // the cell it is in
+    int stepX, stepY;
+    float nextX, nextY; // t where it crosses into the next column and row
+    float deltaX, deltaY;
+    float tEnd;         // t where it leaves the grid or reaches tMax
+} CellWalk;
+
+// Starts the walk of (ox, oy) + t * (dx, dy), 0 <= t <= tMax, false when the ray misses the grid
+static bool startCellWalk(const OccluderScene* scene, float ox, float oy, float dx, float dy, float tMax, CellWalk* walk) {
+    float size = scene->gridCell;
+    float t0 = 0, t1 = tMax;
+    if (!clipSlab(ox, dx, scene->originX, scene->originX + scene->columns * size, &t0, &t1) ||
+        !clipSlab(oy, dy, scene->originY, scene->originY + scene->rows * size, &t0, &t1)) {
+        return false;
+    }
+
+    int cx = (int)floorf((ox + dx * t0 - scene->originX) / size);
+    int cy = (int)floorf((oy + dy * t0 - scene->originY) / size);
+    walk->cx = cx < 0 ? 0 : (cx >= scene->columns ? scene->columns - 1 : cx);
+    walk->cy = cy < 0 ? 0 : (cy >= scene->rows ? scene->rows - 1 : cy);
+
+    walk->stepX = dx > 0 ? 1 : -1;
+    walk->stepY = dy > 0 ? 1 : -1;
+    walk->deltaX = dx != 0 ? size / fabsf(dx) : INFINITY;
+    walk->deltaY = dy != 0 ? size / fabsf(dy) : INFINITY;
+    walk->nextX = dx != 0 ? (scene->originX + (walk->cx + (dx > 0)) * size - ox) / dx : INFINITY;
+    walk->nextY = dy != 0 ? (scene->originY + (walk->cy + (dy > 0)) * size - oy) / dy : INFINITY;
+    walk->tEnd = t1;
+    return true;
+}
+
+// t where the walk leaves its cell
+static float cellExit(const CellWalk* walk) {
+    return fminf(fminf(walk->nextX, walk->nextY), walk->tEnd);
+}
+
+// Moves on to the next cell, false when the walk is over
+static bool stepCellWalk(const OccluderScene* scene, CellWalk* walk) {
+    if (cellExit(walk) >= walk->tEnd) {
+        return false;
+    }
+    if (walk->nextX < walk->nextY) {
+        walk->cx += walk->stepX;
+        walk->nextX += walk->deltaX;
+        return walk->cx >= 0 && walk->cx < scene->columns;
+    }
+    walk->cy += walk->stepY;
+    walk->nextY += walk->deltaY;
+    return walk->cy >= 0 && walk->cy < scene->rows;
+}
+
+// Called for every cell the walk enters with the t where the ray leaves it. Returns true to stop.
+typedef bool (*CellVisitor)(OccluderScene* scene, int cell, float tExit, void* data);
+
+// Walks (ox, oy) + t * (dx, dy), 0 <= t <= tMax, through the grid cells in order
+static void walkCells(OccluderScene* scene, float ox, float oy, float dx, float dy, float tMax,
+                      CellVisitor visit, void* data) {
+    CellWalk walk;
+    if (!startCellWalk(scene, ox, oy, dx, dy, tMax, &walk)) {
+        return;
+    }
+    do {
+        if (visit(scene, walk.cy * scene->columns + walk.cx, cellExit(&walk), data)) {
+            return;
+        }
+    } while (stepCellWalk(scene, &walk));
+}
+
+typedef struct {
+    int segment;
+    bool fill; // false counts entries per cell, true writes them
+} BuildWalk;
+
+static bool buildVisitor(OccluderScene* scene, int cell, float tExit, void* data) {
+    (void)tExit;
+    BuildWalk* walk = data;
+    if (!walk->fill) {
+        scene->cellStart[cell + 1]++;
+        return false;
+    }
+    int slot = scene->cellStart[cell]++;
+    int i = walk->segment;
+    scene->cellX0[slot] = scene->x0[i];
+    scene->cellY0[slot] = scene->y0[i];
+    scene->cellX1[slot] = scene->x1[i];
+    scene->cellY1[slot] = scene->y1[i];
+    scene->cellSegment[slot] = i;
+    return false;
+}
+
+static bool pushPoint(OccluderScene* scene, float x, float y) {
+    void** arrays[] = {(void**)&scene->pointX, (void**)&scene->pointY};
+    size_t sizes[] = {sizeof(float), sizeof(float)};
+    if (!growArrays(arrays, sizes, 2, &scene->pointCapacity, scene->pointCount + 1)) {
+        return false;
+    }
+    scene->pointX[scene->pointCount] = x;
+    scene->pointY[scene->pointCount] = y;
+    scene->pointCount++;
+    return true;
+}
+
+// Cell holding (x, y), clamped to the grid for points on its far edges
+static int pointCell(const OccluderScene* scene, float x, float y) {
+    int column = (int)floorf((x - scene->originX) / scene->gridCell);
+    int row = (int)floorf((y - scene->originY) / scene->gridCell);
+    column = column < 0 ? 0 : (column >= scene->columns ? scene->columns - 1 : column);
+    row = row < 0 ? 0 : (row >= scene->rows ? scene->rows - 1 : row);
+    return row * scene->columns + column;
+}
+
+bool buildOccluderScene(OccluderScene* scene) {
+    if (!scene->dirty) {
+        return true;
+    }
+    scene->pointCount = 0;
+    scene->cellEntries = 0;
+    if (scene->count == 0) {
+        scene->columns = scene->rows = 0;
+        scene->dirty = false;
+        return true;
+    }
+
+    float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+    for (int i = 0; i < scene->count; i++) {
+        minX = fminf(minX, fminf(scene->x0[i], scene->x1[i]));
+        minY = fminf(minY, fminf(scene->y0[i], scene->y1[i]));
+        maxX = fmaxf(maxX, fmaxf(scene->x0[i], scene->x1[i]));
+        maxY = fmaxf(maxY, fmaxf(scene->y0[i], scene->y1[i]));
+    }
+    // about one segment per cell, never coarser than asked
+    float size = fminf(scene->cellSize, sqrtf((maxX - minX) * (maxY - minY) / scene->count));
+    if (size < 1.0f) size = 1.0f;
+    if ((maxX - minX) / size >= MAX_GRID_SIDE) size = (maxX - minX) / (MAX_GRID_SIDE - 1);
+    if ((maxY - minY) / size >= MAX_GRID_SIDE) size = (maxY - minY) / (MAX_GRID_SIDE - 1);
+    scene->gridCell = size;
+    scene->originX = minX;
+    scene->originY = minY;
+    scene->columns = (int)((maxX - minX) / size) + 1; // + 1 keeps walls on the far edge inside
+    scene->rows = (int)((maxY - minY) / size) + 1;
+
+    int cells = scene->columns * scene->rows;
+    if (cells + 1 > scene->cellCapacity) {
+        int* grown = realloc(scene->cellStart, sizeof(int) * (cells + 1));
+        if (grown == NULL) {
+            return false;
+        }
+        scene->cellStart = grown;
+        grown = realloc(scene->pointStart, sizeof(int) * (cells + 1));
+        if (grown == NULL) {
+            return false;
+        }
+        scene->pointStart = grown;
+        scene->cellCapacity = cells + 1;
+    }
+
+    // counting sort of (cell, segment) pairs, each segment listed in every cell it passes through
+    memset(scene->cellStart, 0, sizeof(int) * (cells + 1));
+    BuildWalk walk = {0, false};
+    for (walk.segment = 0; walk.segment < scene->count; walk.segment++) {
+        int i = walk.segment;
+        walkCells(scene, scene->x0[i], scene->y0[i], scene->x1[i] - scene->x0[i], scene->y1[i] - scene->y0[i], 1.0f,
+                  buildVisitor, &walk);
+    }
+    for (int c = 0; c < cells; c++) {
+        scene->cellStart[c + 1] += scene->cellStart[c];
+    }
+    int entries = scene->cellStart[cells];
+    void** arrays[] = {
+        (void**)&scene->cellX0, (void**)&scene->cellY0, (void**)&scene->cellX1, (void**)&scene->cellY1,
+        (void**)&scene->cellSegment
+    };
+    size_t sizes[] = {sizeof(float), sizeof(float), sizeof(float), sizeof(float), sizeof(int)};
+    if (!growArrays(arrays, sizes, 5, &scene->cellEntryCapacity, entries)) {
+        return false;
+    }
+    walk.fill = true;
+    for (walk.segment = 0; walk.segment < scene->count; walk.segment++) {
+        int i = walk.segment;
+        walkCells(scene, scene->x0[i], scene->y0[i], scene->x1[i] - scene->x0[i], scene->y1[i] - scene->y0[i], 1.0f,
+                  buildVisitor, &walk);
+    }
+    // filling moved every start to the next cell's, shift them back
+    memmove(scene->cellStart + 1, scene->cellStart, sizeof(int) * cells);
+    scene->cellStart[0] = 0;
+    scene->cellEntries = entries;
+
+    // end points, once where one segment of a polyline carries on from the last
+    for (int i = 0; i < scene->count; i++) {
+        bool joined = i > 0 && scene->group[i - 1] == scene->group[i] &&
+                      scene->x1[i - 1] == scene->x0[i] && scene->y1[i - 1] == scene->y0[i];
+        bool ok = (joined || pushPoint(scene, scene->x0[i], scene->y0[i])) && pushPoint(scene, scene->x1[i], scene->y1[i]);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    // crossings, found between segments sharing a cell and kept by the cell they fall in
+    for (int c = 0; c < cells; c++) {
+        for (int a = scene->cellStart[c]; a < scene->cellStart[c + 1]; a++) {
+            for (int b = a + 1; b < scene->cellStart[c + 1]; b++) {
+                float rx = scene->cellX1[a] - scene->cellX0[a], ry = scene->cellY1[a] - scene->cellY0[a];
+                float sx = scene->cellX1[b] - scene->cellX0[b], sy = scene->cellY1[b] - scene->cellY0[b];
+                float denominator = rx * sy - ry * sx;
+                if (denominator == 0) {
+                    continue;
+                }
+                float qx = scene->cellX0[b] - scene->cellX0[a], qy = scene->cellY0[b] - scene->cellY0[a];
+                float t = (qx * sy - qy * sx) / denominator;
+                float u = (qx * ry - qy * rx) / denominator;
+                if (t <= 0 || t >= 1 || u <= 0 || u >= 1) {
+                    continue; // shared end points are already in
+                }
+                float x = scene->cellX0[a] + t * rx, y = scene->cellY0[a] + t * ry;
+                int column = (int)floorf((x - scene->originX) / size), row = (int)floorf((y - scene->originY) / size);
+                if (row * scene->columns + column == c && !pushPoint(scene, x, y)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    // the points by cell, counted and placed as the segments were, so a light finds the ones in its reach
+    void** pointArrays[] = {(void**)&scene->cellPoint};
+    size_t pointSizes[] = {sizeof(int)};
+    if (!growArrays(pointArrays, pointSizes, 1, &scene->cellPointCapacity, scene->pointCount)) {
+        return false;
+    }
+    memset(scene->pointStart, 0, sizeof(int) * (cells + 1));
+    for (int p = 0; p < scene->pointCount; p++) {
+        scene->pointStart[pointCell(scene, scene->pointX[p], scene->pointY[p]) + 1]++;
+    }
+    for (int c = 0; c < cells; c++) {
+        scene->pointStart[c + 1] += scene->pointStart[c];
+    }
+    for (int p = 0; p < scene->pointCount; p++) {
+        scene->cellPoint[scene->pointStart[pointCell(scene, scene->pointX[p], scene->pointY[p])]++] = p;
+    }
+    memmove(scene->pointStart + 1, scene->pointStart, sizeof(int) * cells);
+    scene->pointStart[0] = 0;
+
+    scene->dirty = false;
+    return true;
+}
+
+typedef struct {
+    float ox, oy, dx, dy;
+    float t;
+    int hit;
+} CastWalk;
+
+static bool castVisitor(OccluderScene* scene, int cell, float tExit, void* data) {
+    CastWalk* walk = data;
+    int first = scene->cellStart[cell], count = scene->cellStart[cell + 1] - first;
+    if (count > 0) { // most cells a ray crosses are empty
+        int hit = intersectSegmentsRay(walk->ox, walk->oy, walk->dx, walk->dy, scene->cellX0 + first, scene->cellY0 + first,
+                                       scene->cellX1 + first, scene->cellY1 + first, count, &walk->t);
+        if (hit >= 0) {
+            walk->hit = scene->cellSegment[first + hit];
+        }
+    }
+    // a hit is final once no later cell can hold anything nearer
+    return walk->hit >= 0 && walk->t <= tExit;
+}
+
+int castSegmentRay(OccluderScene* scene, float ox, float oy, float dx, float dy, float* t) {
+    if (!buildOccluderScene(scene) || scene->count == 0) {
+        return -1;
+    }
+    CastWalk walk = {ox, oy, dx, dy, *t, -1};
+    walkCells(scene, ox, oy, dx, dy, *t, castVisitor, &walk);
+    if (walk.hit >= 0) {
+        *t = walk.t;
+    }
+    return walk.hit;
+}
+
+int castSceneRay(OccluderScene* scene, const CircleBVH* circles, float ox, float oy, float dx, float dy, float* t) {
+    int hit = -1;
+    float tCircle;
+    if (circles != NULL && (hit = rayCastCircleBVH(circles, ox, oy, dx, dy, *t, &tCircle)) >= 0) {
+        *t = tCircle;
+    }
+    int segment = castSegmentRay(scene, ox, oy, dx, dy, t);
+    return segment >= 0 ? SEGMENT_HIT_ID(segment) : hit;
+}
+
+// Walks the eight lanes through the grid side by side, a cell at a time each. The segments of
+// the cells the lanes are in are tested against the whole packet at once, and since the rays of
+// a packet are neighbours, most steps find the lanes in one or two cells. A lane stops once its
+// hit is inside the cell it is in, as castSegmentRay's walk does.
+static void castSegmentPacket(OccluderScene* scene, RayPacket* packet) {
+    if (!buildOccluderScene(scene) || scene->count == 0) {
+        return;
+    }
+    CellWalk walks[RAY_PACKET_SIZE];
+    int walking = 0; // lanes still in the grid, as a bit mask
+    for (int k = 0; k < RAY_PACKET_SIZE; k++) {
+        if (startCellWalk(scene, packet->ox[k], packet->oy[k], packet->dx[k], packet->dy[k], packet->t[k], &walks[k])) {
+            walking |= 1 << k;
+        }
+    }
+
+    while (walking != 0) {
+        int cells[RAY_PACKET_SIZE], cellCount = 0;
+        for (int mask = walking; mask != 0; mask &= mask - 1) {
+            int k = __builtin_ctz(mask);
+            int cell = walks[k].cy * scene->columns + walks[k].cx, c = 0;
+            while (c < cellCount && cells[c] != cell) c++;
+            if (c == cellCount) cells[cellCount++] = cell;
+        }
+        for (int c = 0; c < cellCount; c++) {
+            for (int e = scene->cellStart[cells[c]]; e < scene->cellStart[cells[c] + 1]; e++) {
+                intersectSegmentPacket(packet, scene->cellX0[e], scene->cellY0[e], scene->cellX1[e], scene->cellY1[e],
+                                       SEGMENT_HIT_ID(scene->cellSegment[e]));
+            }
+        }
+        for (int mask = walking; mask != 0; mask &= mask - 1) {
+            int k = __builtin_ctz(mask);
+            if (packet->t[k] <= cellExit(&walks[k]) || !stepCellWalk(scene, &walks[k])) {
+                walking &= ~(1 << k);
+            }
+        }
+    }
+}
+
+void castScenePacket(OccluderScene* scene, const CircleBVH* circles, RayPacket* packet) {
+    if (circles != NULL) {
+        rayCastCircleBVHPacket(circles, packet);
+    }
+    castSegmentPacket(scene, packet);
+}
+
+int segmentsNearBox(OccluderScene* scene, float minX, float minY, float maxX, float maxY, int* out, int maxOut) {
+    if (!buildOccluderScene(scene) || scene->count == 0) {
+        return 0;
+    }
+    if (++scene->stamp == 0) {
+        memset(scene->seen, 0, sizeof(unsigned) * scene->count);
+        scene->stamp = 1;
+    }
+
+    float size = scene->gridCell;
+    int c0 = (int)floorf((minX - scene->originX) / size), c1 = (int)floorf((maxX - scene->originX) / size);
+    int r0 = (int)floorf((minY - scene->originY) / size), r1 = (int)floorf((maxY - scene->originY) / size);
+    if (c0 < 0) c0 = 0;
+    if (r0 < 0) r0 = 0;
+    if (c1 >= scene->columns) c1 = scene->columns - 1;
+    if (r1 >= scene->rows) r1 = scene->rows - 1;
+
+    int found = 0;
+    for (int row = r0; row <= r1; row++) {
+        for (int column = c0; column <= c1; column++) {
+            int cell = row * scene->columns + column;
+            for (int e = scene->cellStart[cell]; e < scene->cellStart[cell + 1] && found < maxOut; e++) {
+                int i = scene->cellSegment[e];
+                if (scene->seen[i] != scene->stamp) {
+                    scene->seen[i] = scene->stamp;
+                    out[found++] = i;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+int pointsNearBox(OccluderScene* scene, float minX, float minY, float maxX, float maxY, int* out, int maxOut) {
+    if (!buildOccluderScene(scene) || scene->count == 0) {
+        return 0;
+    }
+
+    float size = scene->gridCell;
+    int c0 = (int)floorf((minX - scene->originX) / size), c1 = (int)floorf((maxX - scene->originX) / size);
+    int r0 = (int)floorf((minY - scene->originY) / size), r1 = (int)floorf((maxY - scene->originY) / size);
+    if (c0 < 0) c0 = 0;
+    if (r0 < 0) r0 = 0;
+    if (c1 >= scene->columns) c1 = scene->columns - 1;
+    if (r1 >= scene->rows) r1 = scene->rows - 1;
+
+    // every point is in one cell, so nothing is found twice
+    int found = 0;
+    for (int row = r0; row <= r1; row++) {
+        for (int column = c0; column <= c1; column++) {
+            int cell = row * scene->columns + column;
+            for (int e = scene->pointStart[cell]; e < scene->pointStart[cell + 1] && found < maxOut; e++) {
+                out[found++] = scene->cellPoint[e];
+            }
+        }
+    }
+    return found;
+}
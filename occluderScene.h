@@ -0,0 +1,96 @@
+#ifndef OCCLUDER_SCENE_H
+#define OCCLUDER_SCENE_H
+
+#include <stdbool.h>
+
+#include "circleBVH.h"
+#include "rayPacket.h"
+
+// Ray hits are reported as one int: a circle index (>= 0), -1 for nothing, or this for segment i
+#define SEGMENT_HIT_ID(i) (-2 - (i))
+#define SEGMENT_OF_HIT(id) (-2 - (id))
+
+// Straight walls for the light to stop at: loose segments and polylines, added and removed by
+// the group id they were added under, or loaded from a level file. Queries go through a uniform
+// grid that is rebuilt only after the walls change, so static walls cost nothing per frame and
+// the moving circles stay in their own CircleBVH.
+typedef struct {
+    // segments as added
+    float* x0;
+    float* y0;
+    float* x1;
+    float* y1;
+    int* group;
+    int count;
+    int capacity;
+    int nextGroup;
+    unsigned version; // bumped by every change to the walls
+
+    // grid index: the segments crossing each cell, copied next to each other so a cell is tested 8 at a time
+    bool dirty; // walls changed since the grid was built
+    float cellSize;   // largest cell, smaller when there are many walls and larger past MAX_GRID_SIDE cells
+    float gridCell;   // used by the current grid
+    float originX, originY;
+    int columns, rows;
+    int* cellStart;   // columns * rows + 1 offsets into the cell arrays
+    float* cellX0;
+    float* cellY0;
+    float* cellX1;
+    float* cellY1;
+    int* cellSegment; // index of the segment each entry is a copy of
+    int cellEntries;
+    int cellEntryCapacity;
+    int cellCapacity;
+
+    // end points and crossings of the segments, where what a light sees can change
+    float* pointX;
+    float* pointY;
+    int pointCount;
+    int pointCapacity;
+    int* pointStart;  // columns * rows + 1 offsets into cellPoint
+    int* cellPoint;   // the points in each cell, by index
+    int cellPointCapacity;
+
+    unsigned* seen; // per segment, for reporting each one once from several cells
+    unsigned stamp;
+} OccluderScene;
+
+void initOccluderScene(OccluderScene* scene, float cellSize);
+void freeOccluderScene(OccluderScene* scene);
+
+// Both return the new group id, or -1 when out of memory. A closed polygon joins its last point to its first.
+int addSegment(OccluderScene* scene, float x0, float y0, float x1, float y1);
+int addPolygon(OccluderScene* scene, const float* points, int pointCount, bool closed);
+bool removeOccluder(OccluderScene* scene, int group);
+
+// Adds the walls in a text file, one per line:
+//     segment x0 y0 x1 y1
+//     polygon n x1 y1 ... xn yn      (closed)
+//     polyline n x1 y1 ... xn yn     (open)
+// Blank lines and lines starting with # are skipped. False when the file cannot be read or a line
+// is malformed; the walls before it are kept.
+bool loadOccluderLevel(OccluderScene* scene, const char* path);
+
+// Rebuilds the grid and crossing points if the walls changed. Queries call it, calling it
+// up front keeps the rebuild out of the frame that first casts. False when out of memory.
+bool buildOccluderScene(OccluderScene* scene);
+
+// Nearest segment along (ox, oy) + t * (dx, dy) with 0 <= t <= *t. Returns its index and lowers
+// *t, or returns -1 and leaves *t alone.
+int castSegmentRay(OccluderScene* scene, float ox, float oy, float dx, float dy, float* t);
+
+// Nearest wall or circle (circles may be NULL): the circle tree is walked first and its hit
+// bounds the grid walk. Returns a hit id as above and lowers *t.
+int castSceneRay(OccluderScene* scene, const CircleBVH* circles, float ox, float oy, float dx, float dy, float* t);
+
+// The same for eight rays, leaving hit ids in packet->hit. The lanes walk the grid side by side
+// and each cell's segments are tested against all eight at once.
+void castScenePacket(OccluderScene* scene, const CircleBVH* circles, RayPacket* packet);
+
+// Writes up to maxOut distinct segments with a cell touching the box, returns how many were written
+int segmentsNearBox(OccluderScene* scene, float minX, float minY, float maxX, float maxY, int* out, int maxOut);
+
+// Writes up to maxOut end points or crossings in a cell touching the box, returns how many were written
+int pointsNearBox(OccluderScene* scene, float minX, float minY, float maxX, float maxY, int* out, int maxOut);
+
+#endif
@@ -0,0 +1,250 @@
+// gcc -O3 -mavx2 -I src/include -L src/lib -o physicsBench physicsBench.c circleWorld.c threadPool.c poissonDisk.c gravityTree.c -lmingw32 -lSDL2main -lSDL2
+//
+// Headless benchmark for the circle physics. Every scenario starts from the same seed, runs a
+// fixed number of physics steps without a window and prints one CSV row, so a change to the
+// solver or broadphase can be compared run to run:
+//
+//     physicsBench [steps] [bodies] [threads] > results.csv
+//
+// threads: 1 runs on the calling thread only, 0 uses one worker per extra CPU core. The exit
+// status is 1 when a scenario that must settle (the pile) still has bodies awake at the end.
+// energy_drift compares kinetic plus potential energy (of the fall or of the bodies' mutual
+// gravity) at the end with the start, so a solver that adds energy shows up as a positive drift.
+// Restitution, damping and friction take energy out on purpose, and walls change momentum, so
+// the drift columns are for comparing builds on the same scenario, not judging one run alone.
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "circleWorld.h"
+#include "poissonDisk.h"
+#include "gravityTree.h"
+
+#define WORLD_WIDTH 1392 // same box as circlePhysics
+#define WORLD_HEIGHT 744
+#define DEFAULT_STEPS 600 // ten seconds of simulated time
+#define DEFAULT_BODIES 20000
+#define PHYSICS_HZ 60
+#define PHYSICS_SUBSTEPS 2
+#define BENCH_SEED 12345u
+#define GRAVITY_CONSTANT 200.0f // a tenth of circlePhysics, the well pulls bodies in without flinging them around
+#define GRAVITY_THETA 0.6f
+#define GRAVITY_SOFTENING 5.0f
+
+typedef struct {
+    const char* name;
+    float minRadius, maxRadius;
+    float top;              // fraction of the box height the bodies start in, from the top
+    float speed;            // initial velocity components are drawn from [-speed, speed]
+    float restitution;
+    float linearDamping;
+    float friction;
+    int sleepSteps;         // 0 keeps every body awake
+    float fallAcceleration; // pixels per second^2 toward the bottom edge, 0 for none
+    float wellMass;         // > 0 adds a body this heavy at the centre and switches on mutual gravity
+    int settleSteps;        // > 0 fails a run of at least this many steps that ends with any body awake
+} Scenario;
+
+static const Scenario scenarios[] = {
+    // elastic, undamped and never at rest: the broadphase and velocity solver at full load
+    {"gas",          2.0f,  3.0f, 1.0f, 120.0f, 1.0f, 0.0f,  0.0f, 0,  0.0f,   0.0f,     0},
+    // falls into a heap against the bottom edge, exercises the position solver and sleeping;
+    // the heap, dozens of bodies deep at the default count, has to be fully asleep after ten seconds
+    {"pile",         2.0f,  4.0f, 0.6f,  20.0f, 0.2f, 0.18f, 0.5f, 30, 400.0f, 0.0f,     DEFAULT_STEPS},
+    // bodies orbiting one heavy body under Barnes-Hut gravity, clumps into dense contact.
+    // Expect energy_drift well above +1: close to the well the pull changes a lot within one
+    // step but is applied once per step, and elastic bounces down there keep what it added.
+    // theta 0 drifts as much, and without contacts a quarter of the step brings it under 1%
+    {"gravity well", 1.5f,  3.0f, 1.0f,   0.0f, 1.0f, 0.0f,  0.0f, 0,  0.0f,   20000.0f, 0},
+    // radii from 1 to 20 pixels stretch the uniform grid cell size
+    {"mixed radii",  1.0f, 20.0f, 1.0f, 120.0f, 1.0f, 0.0f,  0.0f, 0,  0.0f,   0.0f,     0},
+};
+
+// xorshift32, independent of rand() so every run sees the same velocities
+static float randomRange(unsigned* state, float lo, float hi) {
+    unsigned x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return lo + (hi - lo) * ((x >> 8) * (1.0f / 16777216.0f));
+}
+
+typedef struct {
+    double kinetic;
+    double potential;    // of the fall and of mutual gravity, whichever the scenario has
+    double px, py;       // total momentum
+    double momentumSize; // sum of every body's |momentum|, scales the momentum drift
+} Totals;
+
+static Totals measure(const CircleWorld* world, const Scenario* sc) {
+    Totals t = {0, 0, 0, 0, 0};
+    for (int i = 0; i < world->count; i++) {
+        if (world->invMass[i] <= 0) {
+            continue;
+        }
+        double mass = 1.0 / world->invMass[i];
+        double vx = world->vx[i], vy = world->vy[i];
+        t.kinetic += 0.5 * mass * (vx * vx + vy * vy);
+        t.potential += mass * sc->fallAcceleration * (WORLD_HEIGHT - world->y[i]);
+        t.px += mass * vx;
+        t.py += mass * vy;
+        t.momentumSize += mass * sqrt(vx * vx + vy * vy);
+    }
+
+    // every pair, softened the way the gravity tree softens the force
+    if (sc->wellMass > 0) {
+        for (int i = 0; i < world->count; i++) {
+            double massI = 1.0 / world->invMass[i];
+            for (int j = i + 1; j < world->count; j++) {
+                double dx = world->x[j] - world->x[i], dy = world->y[j] - world->y[i];
+                double distance = sqrt(dx * dx + dy * dy + GRAVITY_SOFTENING * GRAVITY_SOFTENING);
+                t.potential -= GRAVITY_CONSTANT * massI / world->invMass[j] / distance;
+            }
+        }
+    }
+    return t;
+}
+
+// Places up to bodies circles for the scenario, returns how many fit
+static int spawnScenario(CircleWorld* world, const Scenario* sc, int bodies, unsigned seed) {
+    PoissonDiskParams params = {0, 0, WORLD_WIDTH, WORLD_HEIGHT * sc->top, sc->minRadius, sc->maxRadius, 0.5f, 0, seed};
+    int capacity = maxDiskCount(&params);
+    DiskSample* samples = malloc(sizeof(DiskSample) * capacity);
+    if (samples == NULL) {
+        return 0;
+    }
+    int placed = poissonDiskFill(&params, samples, capacity);
+    shuffleDiskSamples(samples, placed, seed);
+    unsigned state = seed * 2654435761u + 1;
+
+    float cx = WORLD_WIDTH * 0.5f, cy = WORLD_HEIGHT * 0.5f;
+    float wellRadius = 6.0f; // small, a large body would set the grid cell size for everyone
+    if (sc->wellMass > 0) {
+        addCircle(world, cx, cy, 0, 0, sc->wellMass, wellRadius);
+    }
+
+    int count = 0;
+    for (int k = 0; k < placed && count < bodies; k++) {
+        DiskSample d = samples[k];
+        float mass = d.r * 1.5f; // same mass rule as circlePhysics
+        float vx = randomRange(&state, -sc->speed, sc->speed);
+        float vy = randomRange(&state, -sc->speed, sc->speed);
+
+        if (sc->wellMass > 0) {
+            // skip what would start inside the well, put the rest on circular orbits around it
+            float dx = d.x - cx, dy = d.y - cy;
+            float dist = sqrtf(dx * dx + dy * dy);
+            if (dist < wellRadius + d.r + 2.0f) {
+                continue;
+            }
+            float orbit = sqrtf(GRAVITY_CONSTANT * sc->wellMass / dist);
+            vx = -dy / dist * orbit;
+            vy = dx / dist * orbit;
+        }
+
+        if (addCircle(world, d.x, d.y, vx, vy, mass, d.r).id < 0) {
+            break;
+        }
+        count++;
+    }
+    free(samples);
+    return count;
+}
+
+static bool runScenario(const Scenario* sc, int steps, int bodies, ThreadPool* pool, int threads) {
+    CircleWorld world;
+    GravityTree gravity;
+    if (!initCircleWorld(&world, bodies + 1)) {
+        fprintf(stderr, "%s: out of memory\n", sc->name);
+        return false;
+    }
+    world.pool = pool;
+    world.restitution = sc->restitution;
+    world.linearDamping = sc->linearDamping;
+    world.friction = sc->friction;
+    world.gravityY = sc->fallAcceleration;
+    world.sleepSteps = sc->sleepSteps;
+    initGravityTree(&gravity, GRAVITY_CONSTANT, GRAVITY_THETA, GRAVITY_SOFTENING);
+
+    float dt = 1.0f / PHYSICS_HZ;
+    int placed = spawnScenario(&world, sc, bodies, BENCH_SEED);
+    Totals start = measure(&world, sc);
+
+    double candidatePairs = 0, contacts = 0, positionIterations = 0;
+    int maxContacts = 0;
+    long long swept = 0;
+
+    Uint64 begin = SDL_GetPerformanceCounter();
+    for (int s = 0; s < steps; s++) {
+        if (sc->wellMass > 0) {
+            applyGravity(&gravity, &world, dt);
+        }
+        stepCircleWorld(&world, dt, PHYSICS_SUBSTEPS, WORLD_WIDTH, WORLD_HEIGHT);
+
+        candidatePairs += world.stats.candidatePairs;
+        contacts += world.stats.contacts;
+        positionIterations += world.stats.positionIterations;
+        swept += world.stats.sweptBodies;
+        if (world.stats.contacts > maxContacts) {
+            maxContacts = world.stats.contacts;
+        }
+    }
+    double seconds = (double)(SDL_GetPerformanceCounter() - begin) / SDL_GetPerformanceFrequency();
+
+    Totals end = measure(&world, sc);
+    double startEnergy = start.kinetic + start.potential, endEnergy = end.kinetic + end.potential;
+    double energyDrift = startEnergy != 0 ? (endEnergy - startEnergy) / fabs(startEnergy) : 0;
+    double momentumChange = sqrt((end.px - start.px) * (end.px - start.px) + (end.py - start.py) * (end.py - start.py));
+    double momentumScale = start.momentumSize > end.momentumSize ? start.momentumSize : end.momentumSize;
+    double momentumDrift = momentumScale > 0 ? momentumChange / momentumScale : 0;
+
+    printf("%s,%d,%d,%d,%.3f,%.1f,%.0f,%.0f,%d,%.2f,%lld,%.6g,%.6g,%.6g,%.6g,%d\n",
+           sc->name, placed, steps, threads, seconds, steps / seconds,
+           candidatePairs / steps, contacts / steps, maxContacts, positionIterations / steps, swept,
+           start.kinetic, end.kinetic, energyDrift, momentumDrift, world.awakeCount);
+    fflush(stdout);
+
+    bool settled = sc->settleSteps <= 0 || steps < sc->settleSteps || world.awakeCount == 0;
+    if (!settled) {
+        fprintf(stderr, "%s: %d bodies still awake after %d steps\n", sc->name, world.awakeCount, steps);
+    }
+    freeGravityTree(&gravity);
+    freeCircleWorld(&world);
+    return settled;
+}
+
+int main(int argc, char* args[]) {
+    int steps = argc > 1 ? atoi(args[1]) : DEFAULT_STEPS;
+    int bodies = argc > 2 ? atoi(args[2]) : DEFAULT_BODIES;
+    int threads = argc > 3 ? atoi(args[3]) : 0;
+    if (steps <= 0 || bodies <= 0) {
+        fprintf(stderr, "usage: %s [steps] [bodies] [threads]\n", args[0]);
+        return 1;
+    }
+
+    ThreadPool pool;
+    ThreadPool* workers = NULL;
+    if (threads != 1) {
+        if (!initThreadPool(&pool, threads > 1 ? threads - 1 : 0)) {
+            fprintf(stderr, "could not start the thread pool\n");
+            return 1;
+        }
+        workers = &pool;
+    }
+
+    printf("scenario,bodies,steps,threads,seconds,steps_per_s,candidate_pairs,contacts,max_contacts,"
+           "position_iterations,swept_bodies,ke_start,ke_end,energy_drift,momentum_drift,awake_end\n");
+    bool passed = true;
+    for (int i = 0; i < (int)(sizeof(scenarios) / sizeof(scenarios[0])); i++) {
+        passed = runScenario(&scenarios[i], steps, bodies, workers, threads) && passed;
+    }
+
+    if (workers != NULL) {
+        freeThreadPool(workers);
+    }
+    return passed ? 0 : 1;
+}
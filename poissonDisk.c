@@ -0,0 +1,158 @@
+// Bridson's Poisson-disk sampling with variable radii.
+
+#include "poissonDisk.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define PI 3.14159265358979323846f
+
+// xorshift32, kept local so sampling neither depends on nor disturbs rand()
+static float randomFloat(unsigned* state) {
+    unsigned x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (x >> 8) * (1.0f / 16777216.0f); // [0, 1)
+}
+
+static int cellOf(float v, float origin, float invCell, int cells) {
+    int c = (int)((v - origin) * invCell);
+    return c < cells ? c : cells - 1;
+}
+
+// True if no disk in the cells within reach of (gx, gy) comes closer than its radius plus pad
+static bool windowClear(const int* grid, int cols, int rows, const DiskSample* disks,
+                        float x, float y, float pad, int gx, int gy, int reach) {
+    int x0 = gx - reach > 0 ? gx - reach : 0, x1 = gx + reach < cols - 1 ? gx + reach : cols - 1;
+    int y0 = gy - reach > 0 ? gy - reach : 0, y1 = gy + reach < rows - 1 ? gy + reach : rows - 1;
+
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            int other = grid[cy * cols + cx];
+            if (other < 0) {
+                continue;
+            }
+            float dx = disks[other].x - x;
+            float dy = disks[other].y - y;
+            float minDistance = disks[other].r + pad;
+            if (dx * dx + dy * dy < minDistance * minDistance) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static unsigned seedState(unsigned seed) {
+    unsigned state = seed * 2654435761u + 1;
+    return state != 0 ? state : 1;
+}
+
+int maxDiskCount(const PoissonDiskParams* params) {
+    // disks of at least minRadius plus half the gap each, packed no tighter than hexagonally
+    float spacing = params->minRadius + params->gap * 0.5f;
+    float area = (params->maxX - params->minX) * (params->maxY - params->minY);
+    if (spacing <= 0 || area <= 0) {
+        return 0;
+    }
+    return (int)(area / (2.0f * sqrtf(3.0f) * spacing * spacing)) + 1;
+}
+
+int poissonDiskFill(const PoissonDiskParams* params, DiskSample* out, int maxCount) {
+    float minR = params->minRadius, maxR = params->maxRadius, gap = params->gap;
+    float width = params->maxX - params->minX, height = params->maxY - params->minY;
+    if (maxCount <= 0 || minR <= 0 || maxR < minR || width < 2 * minR || height < 2 * minR) {
+        return 0;
+    }
+
+    // centres are at least 2 * minR + gap apart, so a cell this size holds at most one
+    float cellSize = (2.0f * minR + gap) / sqrtf(2.0f);
+    float invCell = 1.0f / cellSize;
+    int cols = (int)ceilf(width * invCell);
+    int rows = (int)ceilf(height * invCell);
+
+    int* grid = malloc(sizeof(int) * cols * rows);
+    if (grid == NULL) {
+        return -1;
+    }
+    for (int c = 0; c < cols * rows; c++) {
+        grid[c] = -1;
+    }
+
+    unsigned state = seedState(params->seed);
+    int attempts = params->attempts > 0 ? params->attempts : 12;
+    int count = 0;
+
+    // the first disk goes anywhere it fits
+    float r = minR + (maxR - minR) * randomFloat(&state);
+    if (width < 2 * r || height < 2 * r) {
+        r = minR;
+    }
+    DiskSample first = {
+        params->minX + r + (width - 2 * r) * randomFloat(&state),
+        params->minY + r + (height - 2 * r) * randomFloat(&state),
+        r
+    };
+    out[count] = first;
+    grid[cellOf(first.y, params->minY, invCell, rows) * cols + cellOf(first.x, params->minX, invCell, cols)] = count++;
+
+    // candidates sweep the circle around their parent in equal steps from a random start angle,
+    // rotating one unit vector instead of calling cosf/sinf for every attempt
+    float stepCos = cosf(2.0f * PI / attempts), stepSin = sinf(2.0f * PI / attempts);
+
+    // each disk is expanded once, in the order it was placed, so the filled area grows as a
+    // front and the grid cells being tested stay warm in cache
+    for (int next = 0; next < count && count < maxCount; next++) {
+        DiskSample parent = out[next];
+
+        float angle = 2.0f * PI * randomFloat(&state);
+        float dirX = cosf(angle), dirY = sinf(angle);
+
+        for (int attempt = 0; attempt < attempts && count < maxCount; attempt++) {
+            float rotated = dirX * stepCos - dirY * stepSin;
+            dirY = dirX * stepSin + dirY * stepCos;
+            dirX = rotated;
+
+            // just past touching distance, which packs far tighter than the classic [R, 2R] annulus
+            float cr = minR + (maxR - minR) * randomFloat(&state);
+            float distance = (parent.r + cr + gap) * (1.0001f + 0.1f * randomFloat(&state));
+            float cx = parent.x + dirX * distance;
+            float cy = parent.y + dirY * distance;
+
+            if (cx - cr < params->minX || cx + cr > params->maxX || cy - cr < params->minY || cy + cr > params->maxY) {
+                continue;
+            }
+
+            // a neighbour can be as large as maxR, so every cell within that reach is scanned,
+            // nearest cells first since most rejected candidates hit a disk right next to them
+            int gx = cellOf(cx, params->minX, invCell, cols);
+            int gy = cellOf(cy, params->minY, invCell, rows);
+            int reach = (int)ceilf((cr + maxR + gap) * invCell);
+            bool clear = windowClear(grid, cols, rows, out, cx, cy, cr + gap, gx, gy, 1) &&
+                         windowClear(grid, cols, rows, out, cx, cy, cr + gap, gx, gy, reach);
+
+            // unlike classic Bridson every candidate that fits is kept, not just the first
+            if (clear) {
+                DiskSample sample = {cx, cy, cr};
+                out[count] = sample;
+                grid[gy * cols + gx] = count++;
+            }
+        }
+    }
+
+    free(grid);
+    return count;
+}
+
+void shuffleDiskSamples(DiskSample* samples, int count, unsigned seed) {
+    unsigned state = seedState(seed);
+    for (int i = count - 1; i > 0; i--) {
+        int j = (int)(randomFloat(&state) * (i + 1));
+        DiskSample t = samples[i];
+        samples[i] = samples[j];
+        samples[j] = t;
+    }
+}
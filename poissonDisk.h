@@ -0,0 +1,32 @@
+#ifndef POISSON_DISK_H
+#define POISSON_DISK_H
+
+// Bulk placement of non-overlapping circles with Bridson's Poisson-disk sampling.
+// A background grid sized from the smallest radius holds at most one disk per cell,
+// so every candidate is tested against a fixed window of cells instead of every
+// earlier circle.
+
+typedef struct {
+    float x, y, r;
+} DiskSample;
+
+typedef struct {
+    float minX, minY, maxX, maxY; // every disk lies fully inside this rectangle
+    float minRadius, maxRadius;   // radii are drawn uniformly from this range
+    float gap;                    // free space kept between neighbouring disks
+    int attempts;                 // candidates tried around each disk, 0 uses 12
+    unsigned seed;                // same seed and params give the same disks
+} PoissonDiskParams;
+
+// Upper bound on how many disks poissonDiskFill can place with these params
+int maxDiskCount(const PoissonDiskParams* params);
+
+// Fills the rectangle with up to maxCount disks and returns how many were written, -1 when
+// out of memory. Disks grow outward from a random first disk, so a fill cut short by maxCount
+// is a clump; fill the whole region and shuffle to scatter a few disks over all of it.
+int poissonDiskFill(const PoissonDiskParams* params, DiskSample* out, int maxCount);
+
+// Puts the samples in random order so any prefix is spread over the whole filled region
+void shuffleDiskSamples(DiskSample* samples, int count, unsigned seed);
+
+#endif
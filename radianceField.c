@@ -0,0 +1,234 @@
+#include "radianceField.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define PI 3.14159265358979323846f
+#define RADIANCE_TILE 16     // texels along each side of one task
+#define DEFAULT_BOUNCE 0.5f
+
+static void freeFieldBuffers(RadianceField* field) {
+    if (field->texture != NULL) SDL_DestroyTexture(field->texture);
+    free(field->light);
+    free(field->lastLight);
+    free(field->pixels);
+    free(field->rayX);
+    free(field->rayY);
+    field->texture = NULL;
+    field->light = field->lastLight = NULL;
+    field->pixels = NULL;
+    field->rayX = field->rayY = NULL;
+}
+
+bool setRadianceQuality(RadianceField* field, SDL_Renderer* renderer, int scale, int raysPerTexel) {
+    freeFieldBuffers(field);
+    field->scale = scale > 0 ? scale : 1;
+    field->raysPerTexel = raysPerTexel > 0 ? raysPerTexel : 1;
+    field->width = (field->screenWidth + field->scale - 1) / field->scale;
+    field->height = (field->screenHeight + field->scale - 1) / field->scale;
+
+    int texels = field->width * field->height;
+    field->light = calloc(texels * 3, sizeof(float));
+    field->lastLight = calloc(texels * 3, sizeof(float));
+    field->pixels = malloc(sizeof(Uint32) * texels);
+    field->rayX = malloc(sizeof(float) * field->raysPerTexel);
+    field->rayY = malloc(sizeof(float) * field->raysPerTexel);
+    if (field->light == NULL || field->lastLight == NULL || field->pixels == NULL || field->rayX == NULL || field->rayY == NULL) {
+        freeFieldBuffers(field);
+        return false;
+    }
+
+    for (int k = 0; k < field->raysPerTexel; k++) {
+        float angle = 2.0f * PI * k / field->raysPerTexel;
+        field->rayX[k] = cosf(angle);
+        field->rayY[k] = sinf(angle);
+    }
+
+    field->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, field->width, field->height);
+    if (field->texture == NULL) {
+        freeFieldBuffers(field);
+        return false;
+    }
+    SDL_SetTextureScaleMode(field->texture, SDL_ScaleModeLinear);
+    SDL_SetTextureBlendMode(field->texture, SDL_BLENDMODE_MOD);
+    return true;
+}
+
+bool initRadianceField(RadianceField* field, SDL_Renderer* renderer, int screenWidth, int screenHeight,
+                       int scale, int raysPerTexel) {
+    memset(field, 0, sizeof(*field));
+    field->screenWidth = screenWidth;
+    field->screenHeight = screenHeight;
+    field->bounce = DEFAULT_BOUNCE;
+    return setRadianceQuality(field, renderer, scale, raysPerTexel);
+}
+
+void freeRadianceField(RadianceField* field) {
+    freeFieldBuffers(field);
+    free(field->emitterX);
+    free(field->emitterY);
+    free(field->emitterRadius);
+    memset(field, 0, sizeof(*field));
+}
+
+// Copies the emitters into arrays, doubling them as needed
+static bool reserveEmitters(RadianceField* field, const RadianceEmitter* emitters, int count) {
+    if (count > field->emitterCapacity) {
+        int capacity = field->emitterCapacity > 0 ? field->emitterCapacity : 16;
+        while (capacity < count) {
+            capacity *= 2;
+        }
+        float* x = realloc(field->emitterX, sizeof(float) * capacity);
+        if (x != NULL) field->emitterX = x;
+        float* y = realloc(field->emitterY, sizeof(float) * capacity);
+        if (y != NULL) field->emitterY = y;
+        float* r = realloc(field->emitterRadius, sizeof(float) * capacity);
+        if (r != NULL) field->emitterRadius = r;
+        if (x == NULL || y == NULL || r == NULL) {
+            return false;
+        }
+        field->emitterCapacity = capacity;
+    }
+    for (int e = 0; e < count; e++) {
+        field->emitterX[e] = emitters[e].x;
+        field->emitterY[e] = emitters[e].y;
+        field->emitterRadius[e] = emitters[e].radius;
+    }
+    field->emitters = emitters;
+    field->emitterCount = count;
+    return true;
+}
+
+// Turn of a texel's rays as a share of the gap between two of them. Interleaved gradient noise
+// keeps neighbouring texels far apart, so the bilinear stretch blends their rays together.
+static float texelJitter(int x, int y) {
+    float n = 52.9829189f * fmodf(0.06711056f * x + 0.00583715f * y, 1.0f);
+    return n - floorf(n);
+}
+
+// What one ray brings back to its texel: the emitter it reaches, or the bounce off the occluder it stops on
+static void traceRay(const RadianceField* field, float ox, float oy, float dx, float dy, float t, int hit,
+                     float reach, float* sum) {
+    float tEmitter = t;
+    int e = intersectCirclesRay(ox, oy, dx, dy, field->emitterX, field->emitterY, field->emitterRadius,
+                                field->emitterCount, &tEmitter);
+    if (e >= 0) {
+        const RadianceEmitter* emitter = &field->emitters[e];
+        float fade = 1.0f - tEmitter / emitter->range;
+        if (fade > 0) {
+            sum[0] += emitter->r * fade;
+            sum[1] += emitter->g * fade;
+            sum[2] += emitter->b * fade;
+        }
+        return;
+    }
+    if (hit == -1 || t >= reach || field->bounce <= 0) {
+        return;
+    }
+
+    // last frame's light one texel short of the hit, on the side the ray arrived from
+    float back = t - field->scale > 0 ? t - field->scale : 0;
+    int bx = (int)((ox + dx * back) / field->scale);
+    int by = (int)((oy + dy * back) / field->scale);
+    if (bx < 0 || by < 0 || bx >= field->width || by >= field->height) {
+        return;
+    }
+    const float* bounced = &field->lastLight[(by * field->width + bx) * 3];
+    sum[0] += bounced[0] * field->bounce;
+    sum[1] += bounced[1] * field->bounce;
+    sum[2] += bounced[2] * field->bounce;
+}
+
+typedef struct {
+    RadianceField* field;
+    int tilesX;
+} FieldTask;
+
+// How far a texel's rays have to go: no further than the emitters they could still reach
+static float texelReach(const RadianceField* field, float x, float y) {
+    float reach = 0;
+    for (int e = 0; e < field->emitterCount; e++) {
+        const RadianceEmitter* emitter = &field->emitters[e];
+        float dx = emitter->x - x, dy = emitter->y - y;
+        float far = fminf(sqrtf(dx * dx + dy * dy), emitter->range) + emitter->radius;
+        if (far > reach) reach = far;
+    }
+    return reach;
+}
+
+static void computeTile(void* data, int task) {
+    FieldTask* job = data;
+    RadianceField* field = job->field;
+    int x0 = (task % job->tilesX) * RADIANCE_TILE, y0 = (task / job->tilesX) * RADIANCE_TILE;
+    int x1 = x0 + RADIANCE_TILE < field->width ? x0 + RADIANCE_TILE : field->width;
+    int y1 = y0 + RADIANCE_TILE < field->height ? y0 + RADIANCE_TILE : field->height;
+    int rays = field->raysPerTexel;
+    RayPacket packet;
+
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            float ox = (x + 0.5f) * field->scale, oy = (y + 0.5f) * field->scale;
+            float turn = texelJitter(x, y) * 2.0f * PI / rays;
+            float turnCos = cosf(turn), turnSin = sinf(turn);
+            float sum[3] = {0, 0, 0};
+            float reach = texelReach(field, ox, oy);
+
+            for (int first = 0; first < rays; first += RAY_PACKET_SIZE) {
+                int lanes = rays - first < RAY_PACKET_SIZE ? rays - first : RAY_PACKET_SIZE;
+                for (int k = 0; k < RAY_PACKET_SIZE; k++) {
+                    int ray = first + (k < lanes ? k : 0);
+                    packet.ox[k] = ox;
+                    packet.oy[k] = oy;
+                    packet.dx[k] = field->rayX[ray] * turnCos - field->rayY[ray] * turnSin;
+                    packet.dy[k] = field->rayX[ray] * turnSin + field->rayY[ray] * turnCos;
+                    packet.t[k] = k < lanes ? reach : 0;
+                    packet.hit[k] = -1;
+                }
+                castScenePacket(field->walls, field->circles, &packet);
+                for (int k = 0; k < lanes; k++) {
+                    traceRay(field, ox, oy, packet.dx[k], packet.dy[k], packet.t[k], packet.hit[k], reach, sum);
+                }
+            }
+
+            float* out = &field->light[(y * field->width + x) * 3];
+            Uint32 pixel = 0xFF000000u;
+            for (int c = 0; c < 3; c++) {
+                out[c] = sum[c] / rays;
+                float value = out[c] + field->ambient;
+                pixel |= (Uint32)(value < 255 ? value : 255) << (16 - 8 * c);
+            }
+            field->pixels[y * field->width + x] = pixel;
+        }
+    }
+}
+
+bool computeRadianceField(RadianceField* field, ThreadPool* pool, OccluderScene* walls, const CircleBVH* circles,
+                          const RadianceEmitter* emitters, int emitterCount) {
+    if (field->texture == NULL || !reserveEmitters(field, emitters, emitterCount) || !buildOccluderScene(walls)) {
+        return false;
+    }
+    rayKernelsUseAVX2(); // settles the kernel dispatch on this thread before the workers cast
+    field->walls = walls;
+    field->circles = circles;
+
+    float* swap = field->lastLight;
+    field->lastLight = field->light;
+    field->light = swap;
+
+    FieldTask job = {field, (field->width + RADIANCE_TILE - 1) / RADIANCE_TILE};
+    int tilesY = (field->height + RADIANCE_TILE - 1) / RADIANCE_TILE;
+    runTasks(pool, job.tilesX * tilesY, computeTile, &job);
+
+    SDL_UpdateTexture(field->texture, NULL, field->pixels, field->width * sizeof(Uint32));
+    return true;
+}
+
+void drawRadianceField(RadianceField* field, SDL_Renderer* renderer) {
+    if (field->texture == NULL) {
+        return;
+    }
+    // the last texel may hang past the screen's edge, so the texels stay centred where they were computed
+    SDL_Rect stretched = {0, 0, field->width * field->scale, field->height * field->scale};
+    SDL_RenderCopy(renderer, field->texture, NULL, &stretched);
+}
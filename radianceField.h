@@ -0,0 +1,67 @@
+#ifndef RADIANCE_FIELD_H
+#define RADIANCE_FIELD_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+#include "threadPool.h"
+#include "circleBVH.h"
+#include "occluderScene.h"
+
+// A glowing disc the field's rays can reach. Colours are 0 to 255 and may add up past it.
+typedef struct {
+    float x, y, radius;
+    float r, g, b;
+    float range; // pixels from the centre where it has faded out
+} RadianceEmitter;
+
+// Soft lighting computed on the CPU at a fraction of the screen's resolution. Every texel sends
+// raysPerTexel rays, evenly spaced but turned by a different amount per texel, through the walls
+// and circles and adds up the emitters they reach. Rays that stop on an occluder instead pick up
+// bounce times what last frame's map had just in front of it, so light spreads round corners
+// over a few frames. Tiles of texels are the thread pool's tasks, the result goes up with
+// SDL_UpdateTexture and is stretched over the screen with bilinear filtering.
+typedef struct {
+    int screenWidth, screenHeight;
+    int scale;        // screen pixels per texel along each side, 4 or 8 are good
+    int raysPerTexel;
+    float ambient;    // added to every texel, 0 to 255
+    float bounce;     // share of the light reaching an occluder sent back out, 0 for none
+
+    int width, height;  // texels
+    float* light;       // r, g, b per texel: this frame's...
+    float* lastLight;   // ...and last frame's, read for the bounce
+    Uint32* pixels;     // light clamped to bytes, ARGB8888
+    SDL_Texture* texture;
+
+    float* rayX;        // raysPerTexel unit directions before each texel's turn
+    float* rayY;
+    float* emitterX;    // the emitters of the frame being computed, as arrays for intersectCirclesRay
+    float* emitterY;
+    float* emitterRadius;
+    const RadianceEmitter* emitters;
+    int emitterCount;
+    int emitterCapacity;
+
+    OccluderScene* walls;
+    const CircleBVH* circles;
+} RadianceField;
+
+// Sizes the field for the screen and makes its streaming texture. False when out of memory or
+// the texture cannot be made.
+bool initRadianceField(RadianceField* field, SDL_Renderer* renderer, int screenWidth, int screenHeight,
+                       int scale, int raysPerTexel);
+void freeRadianceField(RadianceField* field);
+
+// Changes the resolution and ray count, keeping the rest. False when out of memory.
+bool setRadianceQuality(RadianceField* field, SDL_Renderer* renderer, int scale, int raysPerTexel);
+
+// Recomputes the light map against the walls and circles (which may be NULL) and uploads it.
+// The walls' grid is brought up to date first so the workers only read the scene.
+bool computeRadianceField(RadianceField* field, ThreadPool* pool, OccluderScene* walls, const CircleBVH* circles,
+                          const RadianceEmitter* emitters, int emitterCount);
+
+// Multiplies what is already drawn by the light map, stretched over the screen
+void drawRadianceField(RadianceField* field, SDL_Renderer* renderer);
+
+#endif
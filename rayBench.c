@@ -0,0 +1,326 @@
+// gcc -O3 -mavx2 -I src/include -L src/lib -o rayBench rayBench.c rayPacket.c circleBVH.c occluderScene.c arcTessellator.c visibilityPolygon.c -lmingw32 -lSDL2main -lSDL2
+//
+// Headless benchmark for the ray kernels behind the lighting. Every scene is built from the same
+// seed and every kernel casts the same rays through it, without a window, printing one CSV row
+// per kernel, method, instruction set, scene size and ray count:
+//
+//     rayBench [max occluders] [lights] > results.csv
+//
+// kernel: circle and segment are one kind of occluder on its own, scene is half circles and half
+// walls as RayCaster has them, visibility builds whole visibility polygons for lights placed in
+// the scene. method: brute runs rayPacket's array kernels over every occluder, the scalar row
+// being the one-ray-at-a-time baseline, bvh, grid and scene are the accelerated queries one ray
+// at a time and packet eight at a time. simd says which rayPacket path ran. Brute is slow past a
+// few thousand occluders, so it casts fewer rays there. hit_rate should agree across the methods
+// of a kernel, up to rays grazing an occluder. outline_per_ray is only filled in for visibility:
+// the outline points per ray cast, above one where arcs are filled in between rays.
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "rayPacket.h"
+#include "circleBVH.h"
+#include "occluderScene.h"
+#include "arcTessellator.h"
+#include "visibilityPolygon.h"
+
+#define PI 3.14159265358979323846f
+#define WORLD_WIDTH 1392 // same box as RayCaster
+#define WORLD_HEIGHT 744
+#define DEFAULT_MAX_OCCLUDERS 100000
+#define DEFAULT_LIGHTS 4
+#define BENCH_SEED 12345u
+#define RAY_LENGTH 5000.0f // rays go from t = 0 to 1 along this much, as the light's do
+#define RAYS_PER_ORIGIN 64 // rays leave in fans around shared origins, as from a light or a light map texel
+#define BRUTE_TESTS 50000000.0 // ray-occluder pairs a brute method may test per row
+#define OCCLUDER_FILL 0.15f // share of the box the occluders would cover if none overlapped
+#define WALL_CELL_SIZE 64
+#define BVH_REBUILD_RATIO 1.5f
+#define CIRCLE_MAX_ERROR 0.35f
+#define LIGHT_RADIUS 12 // as the lights RayCaster adds on a right click
+#define LIGHT_RANGE 450
+#define LIGHT_RANGE_RAYS 128
+
+static const int occluderCounts[] = {10, 100, 1000, 10000, 100000};
+static const int rayCounts[] = {1024, 65536}; // a burst from one frame, and a batch long enough to warm the caches
+static bool haveAVX2; // asked before anything forces the scalar path, which rayKernelsUseAVX2 then reports
+
+// xorshift32, independent of rand() so every run sees the same scene
+static float randomRange(unsigned* state, float lo, float hi) {
+    unsigned x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return lo + (hi - lo) * ((x >> 8) * (1.0f / 16777216.0f));
+}
+
+// The same rays for every method: (ox, oy) + t * (dx, dy) for t from 0 to 1
+typedef struct {
+    float* ox;
+    float* oy;
+    float* dx;
+    float* dy;
+    int count;
+} Rays;
+
+static bool makeRays(Rays* rays, int count, unsigned seed) {
+    rays->ox = malloc(sizeof(float) * count);
+    rays->oy = malloc(sizeof(float) * count);
+    rays->dx = malloc(sizeof(float) * count);
+    rays->dy = malloc(sizeof(float) * count);
+    rays->count = count;
+    if (rays->ox == NULL || rays->oy == NULL || rays->dx == NULL || rays->dy == NULL) {
+        return false;
+    }
+
+    unsigned state = seed;
+    float ox = 0, oy = 0, turn = 0;
+    for (int k = 0; k < count; k++) {
+        if (k % RAYS_PER_ORIGIN == 0) {
+            ox = randomRange(&state, 0, WORLD_WIDTH);
+            oy = randomRange(&state, 0, WORLD_HEIGHT);
+            turn = randomRange(&state, 0, 2 * PI / RAYS_PER_ORIGIN);
+        }
+        float angle = turn + 2 * PI * (k % RAYS_PER_ORIGIN) / RAYS_PER_ORIGIN;
+        rays->ox[k] = ox;
+        rays->oy[k] = oy;
+        rays->dx[k] = cosf(angle) * RAY_LENGTH;
+        rays->dy[k] = sinf(angle) * RAY_LENGTH;
+    }
+    return true;
+}
+
+static void freeRays(Rays* rays) {
+    free(rays->ox);
+    free(rays->oy);
+    free(rays->dx);
+    free(rays->dy);
+}
+
+// Size that makes count occluders cover OCCLUDER_FILL of the box: circle radius, or half a wall's length
+static float occluderSize(int count) {
+    return sqrtf(OCCLUDER_FILL * WORLD_WIDTH * WORLD_HEIGHT / (PI * count));
+}
+
+static bool makeCircles(CircleBVH* bvh, int count, unsigned seed) {
+    if (!resizeCircleBVH(bvh, count)) {
+        return false;
+    }
+    unsigned state = seed;
+    float size = occluderSize(count);
+    for (int i = 0; i < count; i++) {
+        bvh->x[i] = randomRange(&state, 0, WORLD_WIDTH);
+        bvh->y[i] = randomRange(&state, 0, WORLD_HEIGHT);
+        bvh->r[i] = randomRange(&state, 0.5f * size, 1.5f * size);
+    }
+    return updateCircleBVH(bvh);
+}
+
+static bool makeWalls(OccluderScene* walls, int count, unsigned seed) {
+    unsigned state = seed;
+    float size = occluderSize(count);
+    for (int i = 0; i < count; i++) {
+        float x = randomRange(&state, 0, WORLD_WIDTH), y = randomRange(&state, 0, WORLD_HEIGHT);
+        float angle = randomRange(&state, 0, PI), half = randomRange(&state, 0.5f * size, 1.5f * size);
+        if (addSegment(walls, x - cosf(angle) * half, y - sinf(angle) * half,
+                       x + cosf(angle) * half, y + sinf(angle) * half) < 0) {
+            return false;
+        }
+    }
+    return buildOccluderScene(walls);
+}
+
+typedef enum { KERNEL_CIRCLE, KERNEL_SEGMENT, KERNEL_SCENE } Kernel;
+typedef enum { METHOD_BRUTE, METHOD_ACCELERATED, METHOD_PACKET } Method;
+
+static const char* kernelNames[] = {"circle", "segment", "scene"};
+static const char* acceleratedNames[] = {"bvh", "grid", "scene"};
+
+// Casts the first count rays with one method, returns how many hit something
+static int castRays(Kernel kernel, Method method, const CircleBVH* circles, OccluderScene* walls,
+                    const Rays* rays, int count) {
+    const CircleBVH* sceneCircles = kernel == KERNEL_SEGMENT ? NULL : circles;
+    int hits = 0;
+
+    if (method == METHOD_PACKET) {
+        RayPacket packet;
+        for (int first = 0; first < count; first += RAY_PACKET_SIZE) {
+            for (int k = 0; k < RAY_PACKET_SIZE; k++) {
+                int ray = first + k < count ? first + k : count - 1; // pad with the last ray
+                packet.ox[k] = rays->ox[ray];
+                packet.oy[k] = rays->oy[ray];
+                packet.dx[k] = rays->dx[ray];
+                packet.dy[k] = rays->dy[ray];
+                packet.t[k] = 1.0f;
+                packet.hit[k] = -1;
+            }
+            if (kernel == KERNEL_CIRCLE) {
+                rayCastCircleBVHPacket(circles, &packet);
+            } else {
+                castScenePacket(walls, sceneCircles, &packet); // without circles it is the grid's packet walk
+            }
+            for (int k = 0; k < RAY_PACKET_SIZE && first + k < count; k++) {
+                hits += packet.hit[k] != -1;
+            }
+        }
+        return hits;
+    }
+
+    for (int k = 0; k < count; k++) {
+        float ox = rays->ox[k], oy = rays->oy[k], dx = rays->dx[k], dy = rays->dy[k];
+        float t = 1.0f;
+        bool hit = false;
+        if (method == METHOD_BRUTE) {
+            if (kernel != KERNEL_SEGMENT) {
+                hit |= intersectCirclesRay(ox, oy, dx, dy, circles->x, circles->y, circles->r, circles->count, &t) >= 0;
+            }
+            if (kernel != KERNEL_CIRCLE) {
+                hit |= intersectSegmentsRay(ox, oy, dx, dy, walls->x0, walls->y0, walls->x1, walls->y1, walls->count, &t) >= 0;
+            }
+        } else if (kernel == KERNEL_CIRCLE) {
+            hit = rayCastCircleBVH(circles, ox, oy, dx, dy, 1.0f, &t) >= 0;
+        } else if (kernel == KERNEL_SEGMENT) {
+            hit = castSegmentRay(walls, ox, oy, dx, dy, &t) >= 0;
+        } else {
+            hit = castSceneRay(walls, circles, ox, oy, dx, dy, &t) != -1;
+        }
+        hits += hit;
+    }
+    return hits;
+}
+
+// hitRate or outlinePerRay below zero leaves that column empty
+static void printRow(const char* kernel, const char* method, bool avx2, int occluders, int rays,
+                     double seconds, double hitRate, double outlinePerRay) {
+    printf("%s,%s,%s,%d,%d,%.6f,%.0f,%.1f,", kernel, method, avx2 ? "avx2" : "scalar", occluders, rays,
+           seconds, rays / seconds, seconds * 1e9 / rays);
+    if (hitRate >= 0) {
+        printf("%.4f", hitRate);
+    }
+    printf(",");
+    if (outlinePerRay >= 0) {
+        printf("%.4f", outlinePerRay);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static void runKernel(Kernel kernel, int occluders, const CircleBVH* circles, OccluderScene* walls,
+                      const Rays* rays, int rayCount) {
+    static const char* methodNames[] = {"brute", NULL, "packet"};
+    for (int method = METHOD_BRUTE; method <= METHOD_PACKET; method++) {
+        int count = rayCount;
+        if (method == METHOD_BRUTE && (double)count * occluders > BRUTE_TESTS) {
+            count = (int)(BRUTE_TESTS / occluders);
+            count = count > RAY_PACKET_SIZE ? count : RAY_PACKET_SIZE;
+        }
+
+        for (int avx2 = 0; avx2 <= 1; avx2++) {
+            if (avx2 && !haveAVX2) {
+                continue;
+            }
+            forceScalarRayKernels(!avx2);
+            castRays(kernel, method, circles, walls, rays, count < 64 ? count : 64); // warm up
+
+            Uint64 begin = SDL_GetPerformanceCounter();
+            int hits = castRays(kernel, method, circles, walls, rays, count);
+            double seconds = (double)(SDL_GetPerformanceCounter() - begin) / SDL_GetPerformanceFrequency();
+            const char* name = method == METHOD_ACCELERATED ? acceleratedNames[kernel] : methodNames[method];
+            printRow(kernelNames[kernel], name, avx2, occluders, count, seconds, (double)hits / count, -1);
+        }
+    }
+    forceScalarRayKernels(false);
+}
+
+// Whole visibility polygons for lights spread over the scene, counted by the rays each one cast
+static void runVisibility(int occluders, const CircleBVH* circles, OccluderScene* walls, int lights) {
+    RayDirections rangeRays;
+    ArcTessellator arcs;
+    VisibilityPolygon vis = {0};
+    if (!initRayDirections(&rangeRays, LIGHT_RANGE_RAYS)) {
+        return;
+    }
+    initArcTessellator(&arcs, CIRCLE_MAX_ERROR);
+
+    for (int avx2 = 0; avx2 <= 1; avx2++) {
+        if (avx2 && !haveAVX2) {
+            continue;
+        }
+        forceScalarRayKernels(!avx2);
+        unsigned state = BENCH_SEED ^ 0x5bd1e995u;
+        long long rays = 0, outline = 0;
+        Uint64 begin = SDL_GetPerformanceCounter();
+        for (int l = 0; l < lights; l++) {
+            float x = randomRange(&state, 0, WORLD_WIDTH), y = randomRange(&state, 0, WORLD_HEIGHT);
+            computeVisibility(&vis, walls, circles, &rangeRays, &arcs, x, y, LIGHT_RADIUS, LIGHT_RANGE);
+            rays += vis.angleCount;
+            outline += vis.count;
+        }
+        double seconds = (double)(SDL_GetPerformanceCounter() - begin) / SDL_GetPerformanceFrequency();
+        printRow("visibility", "packet", avx2, occluders, (int)rays, seconds, -1, rays > 0 ? (double)outline / rays : 0);
+    }
+    forceScalarRayKernels(false);
+
+    freeVisibilityPolygon(&vis);
+    freeArcTessellator(&arcs);
+    freeRayDirections(&rangeRays);
+}
+
+int main(int argc, char* args[]) {
+    int maxOccluders = argc > 1 ? atoi(args[1]) : DEFAULT_MAX_OCCLUDERS;
+    int lights = argc > 2 ? atoi(args[2]) : DEFAULT_LIGHTS;
+    if (maxOccluders <= 0 || lights < 0) {
+        fprintf(stderr, "usage: %s [max occluders] [lights]\n", args[0]);
+        return 1;
+    }
+
+    haveAVX2 = rayKernelsUseAVX2();
+    int maxRays = rayCounts[sizeof(rayCounts) / sizeof(rayCounts[0]) - 1];
+    Rays rays;
+    if (!makeRays(&rays, maxRays, BENCH_SEED)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    printf("kernel,method,simd,occluders,rays,seconds,rays_per_s,ns_per_ray,hit_rate,outline_per_ray\n");
+    for (int s = 0; s < (int)(sizeof(occluderCounts) / sizeof(occluderCounts[0])); s++) {
+        int occluders = occluderCounts[s];
+        if (occluders > maxOccluders) {
+            break;
+        }
+
+        // one kind of occluder on its own, then half and half for the scene
+        CircleBVH circles, halfCircles;
+        OccluderScene walls, halfWalls;
+        initCircleBVH(&circles, BVH_REBUILD_RATIO);
+        initCircleBVH(&halfCircles, BVH_REBUILD_RATIO);
+        initOccluderScene(&walls, WALL_CELL_SIZE);
+        initOccluderScene(&halfWalls, WALL_CELL_SIZE);
+        if (makeCircles(&circles, occluders, BENCH_SEED + s) && makeWalls(&walls, occluders, BENCH_SEED + s) &&
+            makeCircles(&halfCircles, occluders / 2, BENCH_SEED + s) &&
+            makeWalls(&halfWalls, occluders - occluders / 2, ~(BENCH_SEED + s))) {
+            for (int r = 0; r < (int)(sizeof(rayCounts) / sizeof(rayCounts[0])); r++) {
+                runKernel(KERNEL_CIRCLE, occluders, &circles, &walls, &rays, rayCounts[r]);
+                runKernel(KERNEL_SEGMENT, occluders, &circles, &walls, &rays, rayCounts[r]);
+                runKernel(KERNEL_SCENE, occluders, &halfCircles, &halfWalls, &rays, rayCounts[r]);
+            }
+            if (lights > 0) {
+                runVisibility(occluders, &halfCircles, &halfWalls, lights);
+            }
+        } else {
+            fprintf(stderr, "%d occluders: out of memory\n", occluders);
+        }
+
+        freeCircleBVH(&circles);
+        freeCircleBVH(&halfCircles);
+        freeOccluderScene(&walls);
+        freeOccluderScene(&halfWalls);
+    }
+
+    freeRays(&rays);
+    return 0;
+}
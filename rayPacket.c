@@ -0,0 +1,320 @@
+// Ray kernels eight at a time. The AVX2 versions are compiled for AVX2 whatever the build flags
+// and only picked when the CPU reports it, so one binary runs everywhere.
+
+#include "rayPacket.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RAY_AVX2 1
+#include <immintrin.h>
+#define AVX2_KERNEL __attribute__((target("avx2")))
+#endif
+
+#define PI 3.14159265358979323846 // double, the ray directions are worked out in double
+#define PARALLEL_EPSILON 1e-6f // rays this close to parallel with a segment miss it, as in rayIntersectsLine
+
+static int useAVX2 = -1; // -1 until the CPU has been asked, written once and only read after
+static bool scalarForced = false;
+
+// Asks the CPU the first time. Nothing guards the write, so the first call must come before
+// any worker thread casts: initRayDirections and computeRadianceField make it up front.
+static void detectAVX2(void) {
+#ifdef RAY_AVX2
+    if (useAVX2 < 0) {
+        __builtin_cpu_init();
+        useAVX2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+#endif
+}
+
+bool rayKernelsUseAVX2(void) {
+#ifdef RAY_AVX2
+    detectAVX2();
+    return useAVX2 && !scalarForced;
+#else
+    return false;
+#endif
+}
+
+void forceScalarRayKernels(bool scalar) {
+    scalarForced = scalar;
+}
+
+bool initRayDirections(RayDirections* dirs, int count) {
+    detectAVX2();
+    dirs->dx = malloc(sizeof(float) * count);
+    dirs->dy = malloc(sizeof(float) * count);
+    dirs->count = count;
+    if (dirs->dx == NULL || dirs->dy == NULL) {
+        freeRayDirections(dirs);
+        return false;
+    }
+    for (int k = 0; k < count; k++) {
+        double angle = 2.0 * PI * k / count; // in double so the last rays are as exact as the first
+        dirs->dx[k] = (float)cos(angle);
+        dirs->dy[k] = (float)sin(angle);
+    }
+    return true;
+}
+
+void freeRayDirections(RayDirections* dirs) {
+    free(dirs->dx);
+    free(dirs->dy);
+    dirs->dx = NULL;
+    dirs->dy = NULL;
+    dirs->count = 0;
+}
+
+// Scalar kernels, the reference the AVX2 ones must match
+
+static float circleHit(float ox, float oy, float dx, float dy, float cx, float cy, float r) {
+    float fx = ox - cx, fy = oy - cy;
+    float A = dx * dx + dy * dy;
+    float B = 2 * (dx * fx + dy * fy);
+    float C = fx * fx + fy * fy - r * r;
+    float discriminant = B * B - 4 * A * C;
+    if (discriminant < 0) {
+        return -1;
+    }
+    float root = sqrtf(discriminant);
+    float t = (-B - root) / (2 * A);
+    return t >= 0 ? t : (-B + root) / (2 * A);
+}
+
+static float segmentHit(float ox, float oy, float dx, float dy, float x0, float y0, float x1, float y1) {
+    float sx = x1 - x0, sy = y1 - y0;
+    float denominator = dx * sy - dy * sx;
+    if (fabsf(denominator) < PARALLEL_EPSILON) {
+        return -1;
+    }
+    float t = ((x0 - ox) * sy - (y0 - oy) * sx) / denominator;
+    float u = ((x0 - ox) * dy - (y0 - oy) * dx) / denominator;
+    return u >= 0 && u <= 1 ? t : -1;
+}
+
+#ifdef RAY_AVX2
+
+// t of 8 rays against one circle each, negative for a miss
+AVX2_KERNEL static __m256 circleHit8(__m256 ox, __m256 oy, __m256 dx, __m256 dy, __m256 cx, __m256 cy, __m256 r) {
+    __m256 fx = _mm256_sub_ps(ox, cx), fy = _mm256_sub_ps(oy, cy);
+    __m256 A = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+    __m256 B = _mm256_mul_ps(_mm256_set1_ps(2), _mm256_add_ps(_mm256_mul_ps(dx, fx), _mm256_mul_ps(dy, fy)));
+    __m256 C = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(fx, fx), _mm256_mul_ps(fy, fy)), _mm256_mul_ps(r, r));
+    __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(B, B), _mm256_mul_ps(_mm256_set1_ps(4), _mm256_mul_ps(A, C)));
+    __m256 miss = _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_LT_OQ);
+
+    __m256 root = _mm256_sqrt_ps(_mm256_max_ps(discriminant, _mm256_setzero_ps()));
+    __m256 twoA = _mm256_add_ps(A, A);
+    __m256 negB = _mm256_sub_ps(_mm256_setzero_ps(), B);
+    __m256 near = _mm256_div_ps(_mm256_sub_ps(negB, root), twoA);
+    __m256 far = _mm256_div_ps(_mm256_add_ps(negB, root), twoA);
+    __m256 t = _mm256_blendv_ps(far, near, _mm256_cmp_ps(near, _mm256_setzero_ps(), _CMP_GE_OQ));
+    return _mm256_blendv_ps(t, _mm256_set1_ps(-1), miss);
+}
+
+AVX2_KERNEL static __m256 segmentHit8(__m256 ox, __m256 oy, __m256 dx, __m256 dy,
+                                      __m256 x0, __m256 y0, __m256 x1, __m256 y1) {
+    __m256 sx = _mm256_sub_ps(x1, x0), sy = _mm256_sub_ps(y1, y0);
+    __m256 denominator = _mm256_sub_ps(_mm256_mul_ps(dx, sy), _mm256_mul_ps(dy, sx));
+    __m256 qx = _mm256_sub_ps(x0, ox), qy = _mm256_sub_ps(y0, oy);
+    __m256 t = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(qx, sy), _mm256_mul_ps(qy, sx)), denominator);
+    __m256 u = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(qx, dy), _mm256_mul_ps(qy, dx)), denominator);
+
+    __m256 absDenominator = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), denominator);
+    __m256 valid = _mm256_and_ps(_mm256_cmp_ps(absDenominator, _mm256_set1_ps(PARALLEL_EPSILON), _CMP_GE_OQ),
+                                 _mm256_and_ps(_mm256_cmp_ps(u, _mm256_setzero_ps(), _CMP_GE_OQ),
+                                               _mm256_cmp_ps(u, _mm256_set1_ps(1), _CMP_LE_OQ)));
+    return _mm256_blendv_ps(_mm256_set1_ps(-1), t, valid);
+}
+
+// Keeps the lanes of t that are a hit in [0, best], and their id
+AVX2_KERNEL static void keepNearer8(RayPacket* packet, __m256 t, __m256i id) {
+    __m256 best = _mm256_load_ps(packet->t);
+    __m256 nearer = _mm256_and_ps(_mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(t, best, _CMP_LE_OQ));
+    _mm256_store_ps(packet->t, _mm256_blendv_ps(best, t, nearer));
+    __m256i hit = _mm256_load_si256((const __m256i*)packet->hit);
+    _mm256_store_si256((__m256i*)packet->hit, _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(hit), _mm256_castsi256_ps(id), nearer)));
+}
+
+AVX2_KERNEL static void intersectCirclePacketAVX2(RayPacket* p, float cx, float cy, float r, int id) {
+    __m256 t = circleHit8(_mm256_load_ps(p->ox), _mm256_load_ps(p->oy), _mm256_load_ps(p->dx), _mm256_load_ps(p->dy),
+                          _mm256_set1_ps(cx), _mm256_set1_ps(cy), _mm256_set1_ps(r));
+    keepNearer8(p, t, _mm256_set1_epi32(id));
+}
+
+AVX2_KERNEL static void intersectSegmentPacketAVX2(RayPacket* p, float x0, float y0, float x1, float y1, int id) {
+    __m256 t = segmentHit8(_mm256_load_ps(p->ox), _mm256_load_ps(p->oy), _mm256_load_ps(p->dx), _mm256_load_ps(p->dy),
+                           _mm256_set1_ps(x0), _mm256_set1_ps(y0), _mm256_set1_ps(x1), _mm256_set1_ps(y1));
+    keepNearer8(p, t, _mm256_set1_epi32(id));
+}
+
+AVX2_KERNEL static int boxPacketMaskAVX2(const RayPacket* p, float minX, float minY, float maxX, float maxY) {
+    __m256 ox = _mm256_load_ps(p->ox), oy = _mm256_load_ps(p->oy);
+    __m256 invX = _mm256_div_ps(_mm256_set1_ps(1), _mm256_load_ps(p->dx));
+    __m256 invY = _mm256_div_ps(_mm256_set1_ps(1), _mm256_load_ps(p->dy));
+    __m256 tx0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(minX), ox), invX);
+    __m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(maxX), ox), invX);
+    __m256 ty0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(minY), oy), invY);
+    __m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(maxY), oy), invY);
+    __m256 tNear = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx0, tx1), _mm256_min_ps(ty0, ty1)), _mm256_setzero_ps());
+    __m256 tFar = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(tx0, tx1), _mm256_max_ps(ty0, ty1)), _mm256_load_ps(p->t));
+    return _mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ));
+}
+
+// Nearest of the lanes with t in [0, *best]: lowers *best and returns the lane, or -1
+AVX2_KERNEL static int nearestLane8(__m256 t, float* best) {
+    __m256 valid = _mm256_and_ps(_mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GE_OQ),
+                                 _mm256_cmp_ps(t, _mm256_set1_ps(*best), _CMP_LE_OQ));
+    int mask = _mm256_movemask_ps(valid);
+    if (mask == 0) {
+        return -1;
+    }
+    _Alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, t);
+    int lane = -1;
+    for (; mask; mask &= mask - 1) {
+        int k = __builtin_ctz(mask);
+        if (lanes[k] <= *best) {
+            *best = lanes[k];
+            lane = k;
+        }
+    }
+    return lane;
+}
+
+AVX2_KERNEL static int intersectCirclesRayAVX2(float ox, float oy, float dx, float dy,
+                                               const float* cx, const float* cy, const float* r, int count, float* t) {
+    __m256 ox8 = _mm256_set1_ps(ox), oy8 = _mm256_set1_ps(oy), dx8 = _mm256_set1_ps(dx), dy8 = _mm256_set1_ps(dy);
+    int hit = -1;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 tHit = circleHit8(ox8, oy8, dx8, dy8, _mm256_loadu_ps(cx + i), _mm256_loadu_ps(cy + i), _mm256_loadu_ps(r + i));
+        int lane = nearestLane8(tHit, t);
+        if (lane >= 0) {
+            hit = i + lane;
+        }
+    }
+    for (; i < count; i++) {
+        float tHit = circleHit(ox, oy, dx, dy, cx[i], cy[i], r[i]);
+        if (tHit >= 0 && tHit <= *t) {
+            *t = tHit;
+            hit = i;
+        }
+    }
+    return hit;
+}
+
+AVX2_KERNEL static int intersectSegmentsRayAVX2(float ox, float oy, float dx, float dy, const float* x0, const float* y0,
+                                                const float* x1, const float* y1, int count, float* t) {
+    __m256 ox8 = _mm256_set1_ps(ox), oy8 = _mm256_set1_ps(oy), dx8 = _mm256_set1_ps(dx), dy8 = _mm256_set1_ps(dy);
+    int hit = -1;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 tHit = segmentHit8(ox8, oy8, dx8, dy8, _mm256_loadu_ps(x0 + i), _mm256_loadu_ps(y0 + i),
+                                  _mm256_loadu_ps(x1 + i), _mm256_loadu_ps(y1 + i));
+        int lane = nearestLane8(tHit, t);
+        if (lane >= 0) {
+            hit = i + lane;
+        }
+    }
+    for (; i < count; i++) {
+        float tHit = segmentHit(ox, oy, dx, dy, x0[i], y0[i], x1[i], y1[i]);
+        if (tHit >= 0 && tHit <= *t) {
+            *t = tHit;
+            hit = i;
+        }
+    }
+    return hit;
+}
+
+#endif
+
+void intersectCirclePacket(RayPacket* packet, float cx, float cy, float r, int id) {
+#ifdef RAY_AVX2
+    if (rayKernelsUseAVX2()) {
+        intersectCirclePacketAVX2(packet, cx, cy, r, id);
+        return;
+    }
+#endif
+    for (int k = 0; k < RAY_PACKET_SIZE; k++) {
+        float t = circleHit(packet->ox[k], packet->oy[k], packet->dx[k], packet->dy[k], cx, cy, r);
+        if (t >= 0 && t <= packet->t[k]) {
+            packet->t[k] = t;
+            packet->hit[k] = id;
+        }
+    }
+}
+
+void intersectSegmentPacket(RayPacket* packet, float x0, float y0, float x1, float y1, int id) {
+#ifdef RAY_AVX2
+    if (rayKernelsUseAVX2()) {
+        intersectSegmentPacketAVX2(packet, x0, y0, x1, y1, id);
+        return;
+    }
+#endif
+    for (int k = 0; k < RAY_PACKET_SIZE; k++) {
+        float t = segmentHit(packet->ox[k], packet->oy[k], packet->dx[k], packet->dy[k], x0, y0, x1, y1);
+        if (t >= 0 && t <= packet->t[k]) {
+            packet->t[k] = t;
+            packet->hit[k] = id;
+        }
+    }
+}
+
+int boxPacketMask(const RayPacket* packet, float minX, float minY, float maxX, float maxY) {
+#ifdef RAY_AVX2
+    if (rayKernelsUseAVX2()) {
+        return boxPacketMaskAVX2(packet, minX, minY, maxX, maxY);
+    }
+#endif
+    int mask = 0;
+    for (int k = 0; k < RAY_PACKET_SIZE; k++) {
+        float invX = 1.0f / packet->dx[k], invY = 1.0f / packet->dy[k];
+        float tx0 = (minX - packet->ox[k]) * invX, tx1 = (maxX - packet->ox[k]) * invX;
+        float ty0 = (minY - packet->oy[k]) * invY, ty1 = (maxY - packet->oy[k]) * invY;
+        float tNear = fmaxf(fmaxf(fminf(tx0, tx1), fminf(ty0, ty1)), 0.0f);
+        float tFar = fminf(fminf(fmaxf(tx0, tx1), fmaxf(ty0, ty1)), packet->t[k]);
+        if (tNear <= tFar) {
+            mask |= 1 << k;
+        }
+    }
+    return mask;
+}
+
+int intersectCirclesRay(float ox, float oy, float dx, float dy,
+                        const float* cx, const float* cy, const float* r, int count, float* t) {
+#ifdef RAY_AVX2
+    if (rayKernelsUseAVX2()) {
+        return intersectCirclesRayAVX2(ox, oy, dx, dy, cx, cy, r, count, t);
+    }
+#endif
+    int hit = -1;
+    for (int i = 0; i < count; i++) {
+        float tHit = circleHit(ox, oy, dx, dy, cx[i], cy[i], r[i]);
+        if (tHit >= 0 && tHit <= *t) {
+            *t = tHit;
+            hit = i;
+        }
+    }
+    return hit;
+}
+
+int intersectSegmentsRay(float ox, float oy, float dx, float dy,
+                         const float* x0, const float* y0, const float* x1, const float* y1, int count, float* t) {
+#ifdef RAY_AVX2
+    if (rayKernelsUseAVX2()) {
+        return intersectSegmentsRayAVX2(ox, oy, dx, dy, x0, y0, x1, y1, count, t);
+    }
+#endif
+    int hit = -1;
+    for (int i = 0; i < count; i++) {
+        float tHit = segmentHit(ox, oy, dx, dy, x0[i], y0[i], x1[i], y1[i]);
+        if (tHit >= 0 && tHit <= *t) {
+            *t = tHit;
+            hit = i;
+        }
+    }
+    return hit;
+}
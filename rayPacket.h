@@ -0,0 +1,54 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include <stdbool.h>
+
+#define RAY_PACKET_SIZE 8 // one AVX2 register of floats
+
+// Eight rays (ox, oy) + t * (dx, dy) traced together. t starts as the furthest each ray may go
+// and every kernel lowers it, and sets hit, where that ray meets something nearer.
+typedef struct {
+    _Alignas(32) float ox[RAY_PACKET_SIZE];
+    _Alignas(32) float oy[RAY_PACKET_SIZE];
+    _Alignas(32) float dx[RAY_PACKET_SIZE];
+    _Alignas(32) float dy[RAY_PACKET_SIZE];
+    _Alignas(32) float t[RAY_PACKET_SIZE];
+    _Alignas(32) int hit[RAY_PACKET_SIZE]; // id passed to the kernel that hit last, -1 for none
+} RayPacket;
+
+// Unit directions of count rays evenly spaced around a circle, ray k at angle 2 * pi * k / count
+typedef struct {
+    float* dx;
+    float* dy;
+    int count;
+} RayDirections;
+
+bool initRayDirections(RayDirections* dirs, int count);
+void freeRayDirections(RayDirections* dirs);
+
+// The kernels use AVX2 when the CPU has it, whatever the build flags, and plain C otherwise.
+// The CPU is asked once, by initRayDirections or the first of these calls, which has to happen
+// on one thread before kernels run on several. Forcing the scalar path is for comparing the two.
+bool rayKernelsUseAVX2(void);
+void forceScalarRayKernels(bool scalar);
+
+// Eight rays against one circle. A ray starting inside the circle hits it where it leaves,
+// as with RayIntersectsCircle.
+void intersectCirclePacket(RayPacket* packet, float cx, float cy, float r, int id);
+
+// Eight rays against the segment (x0, y0) - (x1, y1), counting the end points, as with rayIntersectsLine
+void intersectSegmentPacket(RayPacket* packet, float x0, float y0, float x1, float y1, int id);
+
+// Lanes of the packet that enter the box before their current t, as a bit mask
+int boxPacketMask(const RayPacket* packet, float minX, float minY, float maxX, float maxY);
+
+// One ray against count circles, eight at a time. Returns the nearest one hit with t in
+// [0, *t] and lowers *t to it, or returns -1 and leaves *t alone.
+int intersectCirclesRay(float ox, float oy, float dx, float dy,
+                        const float* cx, const float* cy, const float* r, int count, float* t);
+
+// One ray against count segments (x0[i], y0[i]) - (x1[i], y1[i]), same contract as intersectCirclesRay
+int intersectSegmentsRay(float ox, float oy, float dx, float dy,
+                         const float* x0, const float* y0, const float* x1, const float* y1, int count, float* t);
+
+#endif
@@ -0,0 +1,120 @@
+// Minimal task pool on top of SDL threads.
+
+#include "threadPool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int workerMain(void* arg) {
+    ThreadPool* pool = arg;
+
+    SDL_LockMutex(pool->lock);
+    while (true) {
+        while (!pool->quit && pool->nextTask >= pool->taskCount) {
+            SDL_CondWait(pool->wake, pool->lock);
+        }
+        if (pool->quit) {
+            break;
+        }
+
+        int task = pool->nextTask++;
+        TaskFunction fn = pool->fn;
+        void* data = pool->data;
+
+        SDL_UnlockMutex(pool->lock);
+        fn(data, task);
+        SDL_LockMutex(pool->lock);
+
+        if (++pool->finished == pool->taskCount) {
+            SDL_CondSignal(pool->done);
+        }
+    }
+    SDL_UnlockMutex(pool->lock);
+    return 0;
+}
+
+bool initThreadPool(ThreadPool* pool, int threadCount) {
+    memset(pool, 0, sizeof(*pool));
+
+    if (threadCount <= 0) {
+        threadCount = SDL_GetCPUCount() - 1;
+    }
+    if (threadCount <= 0) {
+        return true; // single core, everything runs on the caller
+    }
+
+    pool->lock = SDL_CreateMutex();
+    pool->wake = SDL_CreateCond();
+    pool->done = SDL_CreateCond();
+    pool->threads = calloc(threadCount, sizeof(SDL_Thread*));
+    if (!pool->lock || !pool->wake || !pool->done || !pool->threads) {
+        printf("Thread pool could not be created! SDL Error: %s\n", SDL_GetError());
+        freeThreadPool(pool);
+        return false;
+    }
+
+    for (int i = 0; i < threadCount; i++) {
+        pool->threads[i] = SDL_CreateThread(workerMain, "worker", pool);
+        if (pool->threads[i] == NULL) {
+            printf("Worker thread could not be created! SDL Error: %s\n", SDL_GetError());
+            break;
+        }
+        pool->threadCount++;
+    }
+    return true;
+}
+
+void freeThreadPool(ThreadPool* pool) {
+    if (pool->lock) {
+        SDL_LockMutex(pool->lock);
+        pool->quit = true;
+        SDL_CondBroadcast(pool->wake);
+        SDL_UnlockMutex(pool->lock);
+    }
+
+    for (int i = 0; i < pool->threadCount; i++) {
+        SDL_WaitThread(pool->threads[i], NULL);
+    }
+
+    if (pool->done) SDL_DestroyCond(pool->done);
+    if (pool->wake) SDL_DestroyCond(pool->wake);
+    if (pool->lock) SDL_DestroyMutex(pool->lock);
+    free(pool->threads);
+    memset(pool, 0, sizeof(*pool));
+}
+
+void runTasks(ThreadPool* pool, int taskCount, TaskFunction fn, void* data) {
+    if (pool == NULL || pool->threadCount == 0 || taskCount <= 1) {
+        for (int task = 0; task < taskCount; task++) {
+            fn(data, task);
+        }
+        return;
+    }
+
+    SDL_LockMutex(pool->lock);
+    pool->fn = fn;
+    pool->data = data;
+    pool->taskCount = taskCount;
+    pool->nextTask = 0;
+    pool->finished = 0;
+    SDL_CondBroadcast(pool->wake);
+
+    // the caller works too instead of just waiting
+    while (pool->nextTask < pool->taskCount) {
+        int task = pool->nextTask++;
+        SDL_UnlockMutex(pool->lock);
+        fn(data, task);
+        SDL_LockMutex(pool->lock);
+        pool->finished++;
+    }
+
+    while (pool->finished < pool->taskCount) {
+        SDL_CondWait(pool->done, pool->lock);
+    }
+
+    // park the workers until the next batch
+    pool->taskCount = 0;
+    pool->nextTask = 0;
+    SDL_UnlockMutex(pool->lock);
+}
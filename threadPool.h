@@ -0,0 +1,36 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+// Runs one task index at a time: fn(data, task) for task in [0, taskCount)
+typedef void (*TaskFunction)(void* data, int task);
+
+// A fixed set of worker threads that cooperatively run batches of tasks.
+// Tasks write their results to slots owned by their index, so the outcome of a
+// batch never depends on which thread picked up which task.
+typedef struct {
+    SDL_Thread** threads;
+    int threadCount; // worker threads, the caller of runTasks also works
+
+    SDL_mutex* lock;
+    SDL_cond* wake; // signalled when a new batch is posted or on shutdown
+    SDL_cond* done; // signalled when the last task of a batch finishes
+
+    TaskFunction fn;
+    void* data;
+    int taskCount;
+    int nextTask;
+    int finished;
+    bool quit;
+} ThreadPool;
+
+// Starts threadCount workers, 0 or less means one per extra CPU core
+bool initThreadPool(ThreadPool* pool, int threadCount);
+void freeThreadPool(ThreadPool* pool);
+
+// Runs every task and returns once all have finished. A NULL pool runs them inline.
+void runTasks(ThreadPool* pool, int taskCount, TaskFunction fn, void* data);
+
+#endif
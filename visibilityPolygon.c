@@ -0,0 +1,243 @@
+#include "visibilityPolygon.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define PI 3.14159265358979323846f
+#define LIGHT_EPSILON 1e-4f // radians either side of a critical angle that a ray is also cast at
+#define LIGHT_RAY_LENGTH 5000 // longer than the screen diagonal
+#define MAX_NEARBY 1024 // circles or walls near one circle that are looked at for crossings
+#define MAX_ARC_POINTS 257 // the arc between two rays is at most half a circle of at most 256 segments
+
+void freeVisibilityPolygon(VisibilityPolygon* vis) {
+    free(vis->rays);
+    free(vis->hits);
+    free(vis->hitCircle);
+    free(vis->starts);
+    free(vis->ends);
+    free(vis->vertices);
+    free(vis->indices);
+    free(vis->inRange);
+    memset(vis, 0, sizeof(*vis));
+}
+
+// Grows the per-angle arrays to hold extra more angles, false when out of memory
+static bool reserveAngles(VisibilityPolygon* vis, int extra) {
+    if (vis->angleCount + extra <= vis->angleCapacity) return true;
+
+    int capacity = vis->angleCapacity > 0 ? vis->angleCapacity : 64;
+    while (capacity < vis->angleCount + extra) capacity *= 2;
+    LightRay* rays = realloc(vis->rays, sizeof(LightRay) * capacity);
+    if (rays != NULL) vis->rays = rays;
+    SDL_FPoint* hits = realloc(vis->hits, sizeof(SDL_FPoint) * capacity);
+    if (hits != NULL) vis->hits = hits;
+    int* hitCircle = realloc(vis->hitCircle, sizeof(int) * capacity);
+    if (hitCircle != NULL) vis->hitCircle = hitCircle;
+    if (rays == NULL || hits == NULL || hitCircle == NULL) return false;
+
+    vis->angleCapacity = capacity;
+    return true;
+}
+
+// Grows inRange to hold count entries. When out of memory the smaller buffer is kept, and the
+// queries filling it stop when it is full.
+static void reserveInRange(VisibilityPolygon* vis, int count) {
+    if (count <= vis->inRangeCapacity) return;
+    int capacity = vis->inRangeCapacity > 0 ? vis->inRangeCapacity : 256;
+    while (capacity < count) capacity *= 2;
+    int* grown = realloc(vis->inRange, sizeof(int) * capacity);
+    if (grown == NULL) return;
+    vis->inRange = grown;
+    vis->inRangeCapacity = capacity;
+}
+
+static bool pushOutlinePoint(VisibilityPolygon* vis, float x, float y) {
+    if (vis->count == vis->capacity) {
+        int capacity = vis->capacity > 0 ? vis->capacity * 2 : 256;
+        SDL_FPoint* starts = realloc(vis->starts, sizeof(SDL_FPoint) * capacity);
+        if (starts != NULL) vis->starts = starts;
+        SDL_FPoint* ends = realloc(vis->ends, sizeof(SDL_FPoint) * capacity);
+        if (ends != NULL) vis->ends = ends;
+        if (starts == NULL || ends == NULL) return false;
+        vis->capacity = capacity;
+    }
+
+    // the ray toward (x, y) leaves the light where it crosses the rim
+    float dx = x - vis->lightX, dy = y - vis->lightY;
+    float length = sqrtf(dx * dx + dy * dy);
+    float scale = length > 0 ? vis->lightRadius / length : 0;
+    vis->starts[vis->count].x = vis->lightX + dx * scale;
+    vis->starts[vis->count].y = vis->lightY + dy * scale;
+    float reach = length > vis->range ? vis->range / length : 1; // past the range nothing is lit anyway
+    vis->ends[vis->count].x = vis->lightX + dx * reach;
+    vis->ends[vis->count].y = vis->lightY + dy * reach;
+    vis->count++;
+    return true;
+}
+
+// Queues rays just before, at and just after the direction of (x, y) seen from the light. The
+// directions either side are the middle one turned by a fixed rotation, so there is no sin or cos.
+// A point past the range changes nothing the light reaches and is left out.
+static void addCriticalAngle(VisibilityPolygon* vis, float x, float y) {
+    float dx = x - vis->lightX, dy = y - vis->lightY;
+    float length = sqrtf(dx * dx + dy * dy);
+    if (length <= 0 || length > vis->range || !reserveAngles(vis, 3)) return;
+    dx /= length;
+    dy /= length;
+
+    const float turnCos = cosf(LIGHT_EPSILON), turnSin = sinf(LIGHT_EPSILON); // folded by the compiler
+    float angle = atan2f(dy, dx);
+    for (int side = -1; side <= 1; side++) {
+        LightRay* ray = &vis->rays[vis->angleCount++];
+        ray->angle = angle + side * LIGHT_EPSILON; // kept in [-pi, pi] so sorting gives the order around the light
+        if (ray->angle > PI) ray->angle -= 2 * PI;
+        if (ray->angle < -PI) ray->angle += 2 * PI;
+        ray->dx = dx * turnCos - dy * turnSin * side;
+        ray->dy = dy * turnCos + dx * turnSin * side;
+    }
+}
+
+static int compareAngles(const void* a, const void* b) {
+    float x = ((const LightRay*)a)->angle, y = ((const LightRay*)b)->angle;
+    return (x > y) - (x < y);
+}
+
+// Casts the sorted rays from the light's centre 8 at a time against the walls and the circle
+// tree. Neighbouring rays point almost the same way, so a packet mostly walks the same boxes.
+static void castLightRays(VisibilityPolygon* vis, OccluderScene* walls, const CircleBVH* circles) {
+    RayPacket packet;
+    for (int first = 0; first < vis->angleCount; first += RAY_PACKET_SIZE) {
+        for (int k = 0; k < RAY_PACKET_SIZE; k++) {
+            int ray = first + k < vis->angleCount ? first + k : vis->angleCount - 1; // pad with the last ray
+            packet.ox[k] = vis->lightX;
+            packet.oy[k] = vis->lightY;
+            packet.dx[k] = vis->rays[ray].dx * LIGHT_RAY_LENGTH;
+            packet.dy[k] = vis->rays[ray].dy * LIGHT_RAY_LENGTH;
+            packet.t[k] = 1.0f;
+            packet.hit[k] = -1;
+        }
+
+        castScenePacket(walls, circles, &packet);
+
+        for (int k = 0; k < RAY_PACKET_SIZE && first + k < vis->angleCount; k++) {
+            vis->hits[first + k].x = packet.ox[k] + packet.t[k] * packet.dx[k];
+            vis->hits[first + k].y = packet.oy[k] + packet.t[k] * packet.dy[k];
+            vis->hitCircle[first + k] = packet.hit[k] >= 0 ? packet.hit[k] : -1;
+        }
+    }
+}
+
+void computeVisibility(VisibilityPolygon* vis, OccluderScene* walls, const CircleBVH* circles,
+                       const RayDirections* rangeRays, const ArcTessellator* arcs,
+                       float x, float y, float radius, float range) {
+    vis->angleCount = 0;
+    vis->count = 0;
+    vis->range = range;
+    vis->lightX = x;
+    vis->lightY = y;
+    vis->lightRadius = radius;
+
+    // where nothing is in the way the outline is the edge of the range, so rays go out all round
+    if (range < LIGHT_RAY_LENGTH && reserveAngles(vis, rangeRays->count)) {
+        for (int k = 0; k < rangeRays->count; k++) {
+            LightRay* ray = &vis->rays[vis->angleCount++];
+            ray->angle = 2 * PI * k / rangeRays->count;
+            if (ray->angle > PI) ray->angle -= 2 * PI;
+            ray->dx = rangeRays->dx[k];
+            ray->dy = rangeRays->dy[k];
+        }
+    }
+
+    // wall ends and crossings, where one wall turns into the next, from the grid cells in reach
+    float minX = x - range, minY = y - range, maxX = x + range, maxY = y + range;
+    buildOccluderScene(walls);
+    reserveInRange(vis, walls->pointCount);
+    int pointCount = pointsNearBox(walls, minX, minY, maxX, maxY, vis->inRange, vis->inRangeCapacity);
+    for (int k = 0; k < pointCount; k++) {
+        int p = vis->inRange[k];
+        addCriticalAngle(vis, walls->pointX[p], walls->pointY[p]);
+    }
+
+    int circleCount = 0;
+    if (circles != NULL) {
+        reserveInRange(vis, circles->count);
+        circleCount = overlapCircleBVH(circles, minX, minY, maxX, maxY, vis->inRange, vis->inRangeCapacity);
+    }
+    for (int n = 0; n < circleCount; n++) {
+        int i = vis->inRange[n];
+        float cx = circles->x[i], cy = circles->y[i], cr = circles->r[i];
+        float dx = cx - x, dy = cy - y;
+        float dist = sqrtf(dx * dx + dy * dy);
+        if (dist - cr > range) continue; // in the corners of the box, past the range
+
+        // both tangents from the light, as in tangentsOfCircle
+        if (dist > cr) {
+            float phi = atan2f(dy, dx);
+            float theta = asinf(cr / dist);
+            addCriticalAngle(vis, x + cosf(phi - theta), y + sinf(phi - theta));
+            addCriticalAngle(vis, x + cosf(phi + theta), y + sinf(phi + theta));
+        }
+
+        // where two circles cross, the nearer of the two changes without a tangent in between
+        int nearby[MAX_NEARBY];
+        int nearbyCount = overlapCircleBVH(circles, cx - cr, cy - cr, cx + cr, cy + cr, nearby, MAX_NEARBY);
+        for (int k = 0; k < nearbyCount; k++) {
+            int j = nearby[k];
+            if (j <= i) continue;
+            float ox = circles->x[j] - cx, oy = circles->y[j] - cy, oRadius = circles->r[j];
+            float d = sqrtf(ox * ox + oy * oy);
+            if (d >= cr + oRadius || d <= fabsf(cr - oRadius)) continue;
+
+            float a = (cr * cr - oRadius * oRadius + d * d) / (2 * d);
+            float h = sqrtf(fmaxf(cr * cr - a * a, 0));
+            float mx = cx + ox * a / d, my = cy + oy * a / d;
+            addCriticalAngle(vis, mx - oy * h / d, my + ox * h / d);
+            addCriticalAngle(vis, mx + oy * h / d, my - ox * h / d);
+        }
+
+        // and where a wall goes into a circle
+        int nearWalls[MAX_NEARBY];
+        int nearWallCount = segmentsNearBox(walls, cx - cr, cy - cr, cx + cr, cy + cr, nearWalls, MAX_NEARBY);
+        for (int k = 0; k < nearWallCount; k++) {
+            int w = nearWalls[k];
+            float sx = walls->x1[w] - walls->x0[w], sy = walls->y1[w] - walls->y0[w];
+            float fx = walls->x0[w] - cx, fy = walls->y0[w] - cy;
+            float A = sx * sx + sy * sy, B = 2 * (sx * fx + sy * fy), C = fx * fx + fy * fy - cr * cr;
+            float discriminant = B * B - 4 * A * C;
+            if (A <= 0 || discriminant < 0) continue;
+
+            for (int side = -1; side <= 1; side += 2) {
+                float t = (-B + side * sqrtf(discriminant)) / (2 * A);
+                if (t >= 0 && t <= 1) addCriticalAngle(vis, walls->x0[w] + t * sx, walls->y0[w] + t * sy);
+            }
+        }
+    }
+
+    qsort(vis->rays, vis->angleCount, sizeof(LightRay), compareAngles);
+    castLightRays(vis, walls, circles);
+
+    // neighbouring rays on the same circle see the arc between them, which is filled in with
+    // the segment length the circles are drawn with; everything else between two rays is straight
+    for (int k = 0; k < vis->angleCount; k++) {
+        int next = (k + 1) % vis->angleCount;
+        pushOutlinePoint(vis, vis->hits[k].x, vis->hits[k].y);
+
+        int i = vis->hitCircle[k];
+        if (i < 0 || vis->hitCircle[next] != i) continue;
+
+        float cx = circles->x[i], cy = circles->y[i], cr = circles->r[i];
+        float fromX = vis->hits[k].x - cx, fromY = vis->hits[k].y - cy;
+        float toX = vis->hits[next].x - cx, toY = vis->hits[next].y - cy;
+        float sweep = atan2f(fromX * toY - fromY * toX, fromX * toX + fromY * toY);
+        float length = sqrtf(fromX * fromX + fromY * fromY);
+        int steps = arcSegmentCount(arcs, cr, sweep);
+        if (steps < 2 || steps >= MAX_ARC_POINTS || length <= 0) continue;
+
+        SDL_FPoint arc[MAX_ARC_POINTS];
+        tessellateArc(cx, cy, cr, fromX / length, fromY / length, sweep, steps, arc);
+        for (int s = 1; s < steps; s++) {
+            pushOutlinePoint(vis, arc[s].x, arc[s].y);
+        }
+    }
+}
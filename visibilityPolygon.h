@@ -0,0 +1,58 @@
+#ifndef VISIBILITY_POLYGON_H
+#define VISIBILITY_POLYGON_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+#include "circleBVH.h"
+#include "occluderScene.h"
+#include "rayPacket.h"
+#include "arcTessellator.h"
+
+// A ray of the light: its angle, only used to sort, and its unit direction
+typedef struct {
+    float angle;
+    float dx, dy;
+} LightRay;
+
+// What a light at the centre of a circle can see. Rays are only cast at the critical angles, where
+// the nearest thing in view can change: either side of each circle's tangents, of the points where
+// two circles cross and of the wall ends. Between two neighbouring angles the outline is then
+// a straight wall or one circle's arc, so the result is exact with a few rays per occluder.
+// Only occluders within the light's range are looked at, so a light costs what is in its reach.
+typedef struct {
+    LightRay* rays;        // cast at the critical angles, sorted before casting
+    SDL_FPoint* hits;      // nearest hit of the ray at each angle
+    int* hitCircle;        // circle the ray stopped on, -1 for the screen edge
+    int angleCount;
+    int angleCapacity;
+
+    SDL_FPoint* starts;    // outline: where each ray leaves the light's rim...
+    SDL_FPoint* ends;      // ...and where it stops, with arcs filled in along the circles hit
+    int count;
+    int capacity;
+    float range;           // no end is further than this from the light's centre
+    float lightX, lightY, lightRadius; // the light the outline was computed for
+
+    int* inRange;          // wall points, then circles, near enough to the light to matter
+    int inRangeCapacity;
+
+    SDL_Vertex* vertices;  // mesh the caller builds from the outline
+    int* indices;
+    int vertexCount;
+    int indexCount;
+    int vertexCapacity;
+    int indexCapacity;
+} VisibilityPolygon;
+
+void freeVisibilityPolygon(VisibilityPolygon* vis);
+
+// Builds the outline of what a light at (x, y) with the given radius sees out to range, in
+// increasing angle order, among the walls and the circles in the tree (which may be NULL).
+// rangeRays keep the outline round where nothing is in the way, and arcs along a circle are
+// split as finely as the circles are drawn.
+void computeVisibility(VisibilityPolygon* vis, OccluderScene* walls, const CircleBVH* circles,
+                       const RayDirections* rangeRays, const ArcTessellator* arcs,
+                       float x, float y, float radius, float range);
+
+#endif